@@ -0,0 +1,228 @@
+// Semantic analysis and code generation benchmark. Parses every input
+// a number of times and reports the time sema and code generation into
+// a fresh module take on the tree, with the nodes visited per second.
+// Without files it compiles a generated input of structs and functions
+// with nested statements and expressions. It keeps to what code
+// generation gets right: locals are only declared at the top of the
+// functions, nested ones get their allocas after the branches of the
+// entry block; chars are promoted by hand before they are passed as
+// arguments and there is no && or ||, the phi of a nested one takes
+// the wrong blocks. Only the two passes are measured, not the parse.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "ast.h"
+#include "ast_context.h"
+#include "ast_visitor.h"
+#include "compile.h"
+#include "diagnostic.h"
+#include "input.h"
+#include "lexer.h"
+#include "parser.h"
+#include "sema_visitor.h"
+#include "util.h"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct source {
+  std::string name;
+  const char* begin;
+  const char* end;
+};
+
+double seconds_since(clock_type::time_point start)
+{
+  std::chrono::duration<double> d = clock_type::now() - start;
+  return d.count();
+}
+
+// counts the nodes sema and code generation walk over
+struct node_counter : c4::ast_visitor<node_counter> {
+  std::size_t nodes = 0;
+
+  template<typename T>
+  bool handle(T*) { ++nodes; return true; }
+};
+
+void bench(const char* input, const std::vector<source>& sources, int iterations)
+{
+  double sema = 0;
+  double codegen = 0;
+  std::size_t nodes = 0;
+  for(int i = 0; i < iterations; ++i) {
+    for(auto& src : sources) {
+      c4::lexer l{src.begin, src.end, src.name.c_str()};
+      l.buffer_tokens();
+      c4::ast_context ctx;
+      c4::parser p{&l, &ctx};
+      auto tu = p.get_ast_node();
+      if(hasErrors())
+        return;
+      node_counter count;
+      count.visit(tu);
+      nodes += count.nodes;
+
+      auto start = clock_type::now();
+      c4::sema_visitor sv;
+      sv.visit(tu);
+      sema += seconds_since(start);
+      if(hasErrors())
+        return;
+
+      start = clock_type::now();
+      llvm::LLVMContext llvm_ctx;
+      llvm::Module m{src.name, llvm_ctx};
+      if(!c4::compile(tu, m, llvm_ctx)) {
+        errorf("code generation failed for %s", src.name.c_str());
+        return;
+      }
+      codegen += seconds_since(start);
+    }
+  }
+  printf("%-12s %12zu %10.3f %14.0f %10.3f %14.0f\n", input, nodes / iterations,
+         sema, nodes / sema, codegen, nodes / codegen);
+}
+
+// a fixed linear congruential generator, so every run compiles the same
+struct random {
+  unsigned long state = 12345;
+  unsigned next(unsigned n)
+  {
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    return static_cast<unsigned>(state >> 33) % n;
+  }
+};
+
+void expression(random& r, std::string& s, int depth)
+{
+  static const char* const operators[] = {" + ", " - ", " * ", " < ", " == "};
+  switch(depth > 3 ? r.next(2) : r.next(7)) {
+  case 0: s += "a"; break;
+  case 1: s += std::to_string(r.next(100)); break;
+  case 2: s += "(p[x] + 1)"; break;
+  case 3:
+    s += "g(";
+    expression(r, s, depth + 1);
+    s += ", b)";
+    break;
+  case 4:
+    s += "(";
+    expression(r, s, depth + 1);
+    s += ")";
+    break;
+  default:
+    expression(r, s, depth + 1);
+    s += operators[r.next(5)];
+    expression(r, s, depth + 1);
+  }
+}
+
+void statement(random& r, std::string& s, int depth)
+{
+  switch(depth > 2 ? r.next(2) : r.next(5)) {
+  case 0:
+  case 1:
+    s += "x = ";
+    expression(r, s, 0);
+    s += ";\n";
+    break;
+  case 2:
+    s += "if (";
+    expression(r, s, 1);
+    s += ") ";
+    statement(r, s, depth + 1);
+    s += "else ";
+    statement(r, s, depth + 1);
+    break;
+  case 3:
+    s += "while (x < ";
+    expression(r, s, 2);
+    s += ") ";
+    statement(r, s, depth + 1);
+    break;
+  default:
+    s += "{\n";
+    for(unsigned i = 0, n = 1 + r.next(4); i < n; ++i)
+      statement(r, s, depth + 1);
+    s += "}\n";
+  }
+}
+
+std::string generate(std::size_t size)
+{
+  random r;
+  std::string s;
+  s.reserve(size + 4096);
+  s += "int g(int a, int b);\n";
+  for(unsigned f = 0; s.size() < size; ++f) {
+    std::string n = std::to_string(f);
+    s += "struct s" + n + " { int a; char *b; struct s" + n + " *next; };\n";
+    s += "int f" + n + "(int a, int b, char *p) {\nint x;\nint y;\n";
+    for(unsigned i = 0, k = 4 + r.next(8); i < k; ++i)
+      statement(r, s, 0);
+    s += "return x;\n}\n";
+  }
+  return s;
+}
+
+// bytes, with an optional k or m suffix
+std::size_t parse_size(const char* s)
+{
+  char* end;
+  std::size_t n = std::strtoul(s, &end, 10);
+  if(*end == 'k' || *end == 'K')
+    n *= 1024;
+  else if(*end == 'm' || *end == 'M')
+    n *= 1024 * 1024;
+  return n;
+}
+
+}
+
+int main(int, char** argv)
+{
+  int iterations = 5;
+  std::size_t size = 4 * 1024 * 1024;
+  char** i = argv + 1;
+  for(; *i && (*i)[0] == '-' && i[1]; i += 2) {
+    if(strEq(*i, "-n")) {
+      iterations = std::atoi(i[1]);
+    } else if(strEq(*i, "-s")) {
+      size = parse_size(i[1]);
+    } else {
+      break;
+    }
+  }
+  if(*i && (*i)[0] == '-') {
+    fprintf(stderr, "usage: %s [-n iterations] [-s bytes[k|m]] [file...]\n"
+            "without files, compiles a generated input\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-12s %12s %10s %14s %10s %14s\n", "input", "nodes", "sema s",
+         "sema nodes/s", "codegen s", "codegen nodes/s");
+  if(*i) {
+    std::vector<c4::input> inputs;
+    std::vector<source> sources;
+    for(; *i; ++i)
+      inputs.emplace_back(*i);
+    for(auto& in : inputs)
+      sources.push_back(source{in.name(), in.begin(), in.end()});
+    bench("files", sources, iterations);
+  } else {
+    auto text = generate(size);
+    std::vector<source> sources{source{"generated", text.data(), text.data() + text.size()}};
+    bench("generated", sources, iterations);
+  }
+
+  return printDiagnosticSummary();
+}
@@ -0,0 +1,123 @@
+// Keyword lookup benchmark. Collects every identifier and keyword of
+// the inputs and looks them all up a number of times, once with the
+// compile time perfect hash and once with the unordered_map the
+// identifier muncher used before.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ADT/Hashing.h"
+
+#include "diagnostic.h"
+#include "input.h"
+#include "lexer.h"
+#include "munchers.h"
+#include "util.h"
+
+namespace {
+
+using c4::token_type;
+
+token_type map_lookup(const llvm::StringRef& s)
+{
+  static auto shash = [](const llvm::StringRef& r) -> std::size_t { return llvm::hash_value(r); };
+  static std::unordered_map<llvm::StringRef, token_type, decltype(shash)>
+    kwd_map = {
+    {{"auto", token_type::KWD_AUTO}, {"break", token_type::KWD_BREAK}, {"case", token_type::KWD_CASE},
+     {"char", token_type::KWD_CHAR}, {"const", token_type::KWD_CONST}, {"continue", token_type::KWD_CONTINUE},
+     {"default", token_type::KWD_DEFAULT}, {"do", token_type::KWD_DO}, {"double", token_type::KWD_DOUBLE},
+     {"else", token_type::KWD_ELSE}, {"enum", token_type::KWD_ENUM}, {"extern", token_type::KWD_EXTERN},
+     {"float", token_type::KWD_FLOAT}, {"for", token_type::KWD_FOR}, {"goto", token_type::KWD_GOTO},
+     {"if", token_type::KWD_IF}, {"inline", token_type::KWD_INLINE}, {"int", token_type::KWD_INT},
+     {"long", token_type::KWD_LONG}, {"register", token_type::KWD_REGISTER},
+     {"restrict", token_type::KWD_RESTRICT}, {"return", token_type::KWD_RETURN}, {"short", token_type::KWD_SHORT},
+     {"signed", token_type::KWD_SIGNED}, {"sizeof", token_type::KWD_SIZEOF}, {"static", token_type::KWD_STATIC},
+     {"struct", token_type::KWD_STRUCT}, {"switch", token_type::KWD_SWITCH}, {"typedef", token_type::KWD_TYPEDEF},
+     {"union", token_type::KWD_UNION}, {"unsigned", token_type::KWD_UNSIGNED}, {"void", token_type::KWD_VOID},
+     {"volatile", token_type::KWD_VOLATILE}, {"while", token_type::KWD_WHILE}, {"_Alignas", token_type::KWD__ALIGNAS},
+     {"_Alignof", token_type::KWD__ALIGNOF}, { "_Atomic", token_type::KWD__ATOMIC}, {"_Bool", token_type::KWD__BOOL},
+     {"_Complex", token_type::KWD__COMPLEX}, {"_Generic", token_type::KWD__GENERIC},
+     {"_Imaginary", token_type::KWD__IMAGINARY}, {"_Noreturn", token_type::KWD__NORETURN},
+     {"_Static_assert", token_type::KWD__STATIC_ASSERT}, {"_Thread_local", token_type::KWD__THREAD_LOCAL}},
+    static_cast<int>(token_type::KWD__THREAD_LOCAL) - static_cast<int>(token_type::KWD_AUTO), shash
+  };
+
+  auto it = kwd_map.find(s);
+  return it != kwd_map.end() ? it->second : token_type::IDENTIFIER;
+}
+
+struct result {
+  const char* name;
+  std::size_t lookups;
+  std::size_t keywords;
+  double seconds;
+};
+
+template<typename Lookup>
+result run(const char* name, const std::vector<llvm::StringRef>& words,
+           Lookup lookup, int iterations)
+{
+  std::size_t keywords = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; ++i)
+    for(auto& w : words)
+      keywords += lookup(w) != token_type::IDENTIFIER;
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return result{name, words.size() * iterations, keywords, d.count()};
+}
+
+void print(const result& r)
+{
+  printf("%-14s %12zu %10zu %10.3f %14.0f\n", r.name, r.lookups, r.keywords,
+         r.seconds, r.lookups / r.seconds);
+}
+
+}
+
+int main(int, char** argv)
+{
+  int iterations = 20;
+  char** i = argv + 1;
+  if(*i && strEq(*i, "-n") && i[1]) {
+    iterations = std::atoi(i[1]);
+    i += 2;
+  }
+  if(!*i) {
+    fprintf(stderr, "usage: %s [-n iterations] file...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<c4::input> inputs;
+  std::vector<llvm::StringRef> words;
+  for(; *i; ++i) {
+    inputs.emplace_back(*i);
+    auto& in = inputs.back();
+    c4::lexer l{in.begin(), in.end(), in.name()};
+    for(auto t = l.get_token().first; t.type != token_type::T_EOF; t = l.advance_token().first) {
+      if(t.type == token_type::IDENTIFIER || (t.type >= token_type::KWD_AUTO
+                                              && t.type <= token_type::KWD__THREAD_LOCAL))
+        words.push_back(t.data());
+    }
+  }
+
+  std::size_t mismatches = 0;
+  for(auto& w : words)
+    if(map_lookup(w) != c4::keyword_or_identifier(w))
+      ++mismatches;
+  if(mismatches != 0) {
+    fprintf(stderr, "%zu words classified differently\n", mismatches);
+    return 1;
+  }
+
+  printf("%-14s %12s %10s %10s %14s\n", "lookup", "lookups", "keywords", "seconds", "lookups/s");
+  auto map = run("unordered_map", words, map_lookup, iterations);
+  print(map);
+  auto hash = run("perfect hash", words, c4::keyword_or_identifier, iterations);
+  print(hash);
+  printf("speedup: %.2fx\n", map.seconds / hash.seconds);
+
+  return printDiagnosticSummary();
+}
@@ -0,0 +1,254 @@
+// Lexer throughput benchmark. Lexes every input a number of times with
+// each lexer strategy, and once more into the token buffer, and reports
+// MB/s, tokens/s and heap allocations per token. Without files it
+// generates C inputs with a given token mix; identifier, comment,
+// string and punctuator heavy ones.
+// Every lexer registers its input with the source manager, so keep
+// iterations * input size well below 4 GiB.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "diagnostic.h"
+#include "input.h"
+#include "lexer.h"
+#include "util.h"
+
+namespace {
+
+std::size_t allocations = 0;
+
+}
+
+// count every allocation of the program, the lexer's included
+void* operator new(std::size_t n)
+{
+  ++allocations;
+  if(void* p = std::malloc(n != 0 ? n : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{ std::free(p); }
+
+namespace {
+
+struct source {
+  std::string name;
+  const char* begin;
+  const char* end;
+};
+
+struct result {
+  const char* name;
+  std::size_t bytes;
+  std::size_t tokens;
+  std::size_t allocations;
+  double seconds;
+};
+
+result run(const char* name, const std::vector<source>& sources,
+           c4::lexer::strategy s, bool buffered, int iterations)
+{
+  std::size_t tokens = 0;
+  std::size_t bytes = 0;
+  std::size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; ++i) {
+    for(auto& src : sources) {
+      c4::lexer l{src.begin, src.end, src.name.c_str(), s};
+      if(buffered)
+        l.buffer_tokens();
+      while(l.get_token().first.type != c4::token_type::T_EOF) {
+        ++tokens;
+        l.advance_token();
+      }
+      bytes += static_cast<std::size_t>(src.end - src.begin);
+    }
+  }
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return result{name, bytes, tokens, allocations - before, d.count()};
+}
+
+void print(const char* input, const result& r)
+{
+  printf("%-12s %-14s %12zu %10.3f %10.1f %14.0f %12.4f\n", input, r.name,
+         r.tokens, r.seconds, r.bytes / r.seconds / (1024 * 1024),
+         r.tokens / r.seconds,
+         r.tokens != 0 ? static_cast<double>(r.allocations) / r.tokens : 0.0);
+}
+
+void bench(const char* input, const std::vector<source>& sources, int iterations)
+{
+  auto longest = run("longest-match", sources, c4::lexer::LONGEST_MATCH, false, iterations);
+  print(input, longest);
+  auto dispatch = run("dispatch", sources, c4::lexer::DISPATCH, false, iterations);
+  print(input, dispatch);
+  print(input, run("buffered", sources, c4::lexer::DISPATCH, true, iterations));
+}
+
+////////// SYNTHETIC INPUTS //////////
+
+// a fixed linear congruential generator, so every run lexes the same
+struct random {
+  unsigned long state = 12345;
+  unsigned next(unsigned n)
+  {
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    return static_cast<unsigned>(state >> 33) % n;
+  }
+  template<std::size_t N>
+  const char* pick(const char* const (&words)[N]) { return words[next(N)]; }
+};
+
+const char* const identifiers[] = {
+  "i", "n", "count", "buffer_size", "next_token", "parse_declaration",
+  "very_long_identifier_name_for_testing", "x1", "tmp", "result_value"
+};
+const char* const keywords[] = {
+  "int", "char", "struct", "return", "if", "while", "sizeof", "unsigned"
+};
+const char* const operators[] = {
+  "+", "-", "*", "/", "%", "<<", ">>", "&&", "||", "==", "!=", "<=",
+  ">=", "&", "|", "^", "->", ".", "+=", "-=", "*=", "<<=", "?", ":"
+};
+
+void identifier_line(random& r, std::string& s)
+{
+  s += r.pick(keywords);
+  s += ' ';
+  s += r.pick(identifiers);
+  s += " = ";
+  for(unsigned i = 0, n = 2 + r.next(6); i < n; ++i) {
+    if(i != 0)
+      s += " + ";
+    s += r.pick(identifiers);
+  }
+  s += ";\n";
+}
+
+void comment_line(random& r, std::string& s)
+{
+  if(r.next(2) == 0) {
+    s += "/* ";
+    for(unsigned i = 0, n = 1 + r.next(4); i < n; ++i)
+      s += "a block comment that goes on\n   over a few lines, with * and / ";
+    s += "*/\n";
+  } else {
+    s += "// a line comment with some ";
+    s += r.pick(identifiers);
+    s += " words in it\n";
+  }
+  if(r.next(4) == 0) {
+    s += r.pick(identifiers);
+    s += ";\n";
+  }
+}
+
+void string_line(random& r, std::string& s)
+{
+  s += r.pick(identifiers);
+  s += " = \"a string with \\\"escapes\\\"\\t and ";
+  s += r.pick(identifiers);
+  s += "\\n\"; ";
+  s += r.pick(identifiers);
+  s += r.next(2) == 0 ? " = 'c';\n" : " = '\\n';\n";
+}
+
+void punctuator_line(random& r, std::string& s)
+{
+  for(unsigned i = 0, n = 4 + r.next(8); i < n; ++i) {
+    s += "a";
+    s += r.pick(operators);
+    s += "(b)[c]";
+  }
+  s += "{};\n";
+}
+
+struct mix {
+  const char* name;
+  void (*line)(random&, std::string&);
+};
+
+const mix mixes[] = {
+  {"identifiers", identifier_line},
+  {"comments", comment_line},
+  {"strings", string_line},
+  {"punctuators", punctuator_line}
+};
+
+std::string generate(const mix& m, std::size_t size)
+{
+  random r;
+  std::string s;
+  s.reserve(size + 256);
+  while(s.size() < size)
+    m.line(r, s);
+  return s;
+}
+
+// bytes, with an optional k or m suffix
+std::size_t parse_size(const char* s)
+{
+  char* end;
+  std::size_t n = std::strtoul(s, &end, 10);
+  if(*end == 'k' || *end == 'K')
+    n *= 1024;
+  else if(*end == 'm' || *end == 'M')
+    n *= 1024 * 1024;
+  return n;
+}
+
+}
+
+int main(int, char** argv)
+{
+  int iterations = 20;
+  std::size_t size = 1024 * 1024;
+  std::string only;
+  char** i = argv + 1;
+  for(; *i && (*i)[0] == '-' && i[1]; i += 2) {
+    if(strEq(*i, "-n")) {
+      iterations = std::atoi(i[1]);
+    } else if(strEq(*i, "-s")) {
+      size = parse_size(i[1]);
+    } else if(strEq(*i, "-m")) {
+      only = i[1];
+    } else {
+      break;
+    }
+  }
+  if(*i && (*i)[0] == '-') {
+    fprintf(stderr, "usage: %s [-n iterations] [-s bytes[k|m]] [-m mix] [file...]\n"
+            "without files, lexes generated inputs of every mix: identifiers,\n"
+            "comments, strings and punctuators\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-12s %-14s %12s %10s %10s %14s %12s\n", "input", "strategy", "tokens",
+         "seconds", "MB/s", "tokens/s", "allocs/token");
+  if(*i) {
+    std::vector<c4::input> inputs;
+    std::vector<source> sources;
+    for(; *i; ++i)
+      inputs.emplace_back(*i);
+    for(auto& in : inputs)
+      sources.push_back(source{in.name(), in.begin(), in.end()});
+    bench("files", sources, iterations);
+  } else {
+    for(auto& m : mixes) {
+      if(!only.empty() && only != "all" && only != m.name)
+        continue;
+      auto text = generate(m, size);
+      std::vector<source> sources{source{m.name, text.data(), text.data() + text.size()}};
+      bench(m.name, sources, iterations);
+    }
+  }
+
+  return printDiagnosticSummary();
+}
@@ -0,0 +1,243 @@
+// Parser benchmark. Parses every input a number of times into a fresh
+// ast_context and reports the parse time, the time to tear the tree
+// down again, the heap allocations and node bytes per parse and the
+// peak RSS of the run. Without files it parses a generated input of
+// structs and functions with nested statements and expressions.
+// Every input is parsed eagerly and once more with lazy bodies, which
+// only brace matches the function bodies and never parses them; with
+// -t, also with the bodies parsed after the declarations on threads.
+// Tokens are buffered before the clock starts, so only the parser is
+// measured.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "ast.h"
+#include "ast_context.h"
+#include "diagnostic.h"
+#include "input.h"
+#include "lexer.h"
+#include "parser.h"
+#include "util.h"
+
+namespace {
+
+std::size_t allocations = 0;
+
+}
+
+// count every allocation of the program, the parser's included
+void* operator new(std::size_t n)
+{
+  ++allocations;
+  if(void* p = std::malloc(n != 0 ? n : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{ std::free(p); }
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct source {
+  std::string name;
+  const char* begin;
+  const char* end;
+};
+
+double seconds_since(clock_type::time_point start)
+{
+  std::chrono::duration<double> d = clock_type::now() - start;
+  return d.count();
+}
+
+// threads == 0 parses the bodies eagerly, threads < 0 skips them
+void bench(const char* input, const std::vector<source>& sources, int iterations,
+           int threads)
+{
+  double parse = 0;
+  double teardown = 0;
+  std::size_t bytes = 0;
+  std::size_t nodes = 0;
+  std::size_t allocs = 0;
+  for(int i = 0; i < iterations; ++i) {
+    for(auto& src : sources) {
+      c4::lexer l{src.begin, src.end, src.name.c_str()};
+      l.buffer_tokens();
+      std::size_t before = allocations;
+      auto start = clock_type::now();
+      auto ctx = make_unique<c4::ast_context>();
+      c4::parser p{&l, ctx.get(), threads != 0};
+      auto tu = p.get_ast_node();
+      if(threads > 0)
+        c4::parse_bodies(*static_cast<c4::translation_unit*>(tu),
+                         static_cast<unsigned>(threads));
+      parse += seconds_since(start);
+      allocs += allocations - before;
+      nodes += ctx->allocated() + ctx->table_bytes();
+      start = clock_type::now();
+      ctx.reset();
+      teardown += seconds_since(start);
+      bytes += static_cast<std::size_t>(src.end - src.begin);
+    }
+  }
+  printf("%-12s %10.3f %10.1f %12.3f %14.0f %14.0f\n", input, parse,
+         bytes / parse / (1024 * 1024), teardown * 1000, double(allocs) / iterations,
+         double(nodes) / iterations);
+}
+
+// a fixed linear congruential generator, so every run parses the same
+struct random {
+  unsigned long state = 12345;
+  unsigned next(unsigned n)
+  {
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    return static_cast<unsigned>(state >> 33) % n;
+  }
+};
+
+void expression(random& r, std::string& s, int depth)
+{
+  static const char* const operators[] = {" + ", " - ", " * ", " < ", " == ", " && "};
+  switch(depth > 3 ? r.next(2) : r.next(7)) {
+  case 0: s += "a"; break;
+  case 1: s += std::to_string(r.next(100)); break;
+  case 2: s += "p[x]"; break;
+  case 3:
+    s += "g(";
+    expression(r, s, depth + 1);
+    s += ", b)";
+    break;
+  case 4:
+    s += "(";
+    expression(r, s, depth + 1);
+    s += ")";
+    break;
+  default:
+    expression(r, s, depth + 1);
+    s += operators[r.next(6)];
+    expression(r, s, depth + 1);
+  }
+}
+
+void statement(random& r, std::string& s, int depth)
+{
+  switch(depth > 2 ? r.next(2) : r.next(5)) {
+  case 0:
+  case 1:
+    s += "x = ";
+    expression(r, s, 0);
+    s += ";\n";
+    break;
+  case 2:
+    s += "if (";
+    expression(r, s, 1);
+    s += ") ";
+    statement(r, s, depth + 1);
+    s += "else ";
+    statement(r, s, depth + 1);
+    break;
+  case 3:
+    s += "while (x < ";
+    expression(r, s, 2);
+    s += ") ";
+    statement(r, s, depth + 1);
+    break;
+  default:
+    s += "{\nint y;\n";
+    for(unsigned i = 0, n = 1 + r.next(4); i < n; ++i)
+      statement(r, s, depth + 1);
+    s += "}\n";
+  }
+}
+
+std::string generate(std::size_t size)
+{
+  random r;
+  std::string s;
+  s.reserve(size + 4096);
+  s += "int g(int a, int b);\n";
+  for(unsigned f = 0; s.size() < size; ++f) {
+    std::string n = std::to_string(f);
+    s += "struct s" + n + " { int a; char *b; struct s" + n + " *next; };\n";
+    s += "int f" + n + "(int a, int b, char *p) {\nint x;\n";
+    for(unsigned i = 0, k = 4 + r.next(8); i < k; ++i)
+      statement(r, s, 0);
+    s += "return x;\n}\n";
+  }
+  return s;
+}
+
+// bytes, with an optional k or m suffix
+std::size_t parse_size(const char* s)
+{
+  char* end;
+  std::size_t n = std::strtoul(s, &end, 10);
+  if(*end == 'k' || *end == 'K')
+    n *= 1024;
+  else if(*end == 'm' || *end == 'M')
+    n *= 1024 * 1024;
+  return n;
+}
+
+}
+
+int main(int, char** argv)
+{
+  int iterations = 10;
+  int threads = 0;
+  std::size_t size = 8 * 1024 * 1024;
+  char** i = argv + 1;
+  for(; *i && (*i)[0] == '-' && i[1]; i += 2) {
+    if(strEq(*i, "-n")) {
+      iterations = std::atoi(i[1]);
+    } else if(strEq(*i, "-s")) {
+      size = parse_size(i[1]);
+    } else if(strEq(*i, "-t")) {
+      threads = std::atoi(i[1]);
+    } else {
+      break;
+    }
+  }
+  if(*i && (*i)[0] == '-') {
+    fprintf(stderr, "usage: %s [-n iterations] [-s bytes[k|m]] [-t threads] [file...]\n"
+            "without files, parses a generated input\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-12s %10s %10s %12s %14s %14s\n", "input", "seconds", "MB/s",
+         "teardown ms", "allocs/parse", "node bytes");
+  if(*i) {
+    std::vector<c4::input> inputs;
+    std::vector<source> sources;
+    for(; *i; ++i)
+      inputs.emplace_back(*i);
+    for(auto& in : inputs)
+      sources.push_back(source{in.name(), in.begin(), in.end()});
+    bench("files", sources, iterations, 0);
+    bench("files-decls", sources, iterations, -1);
+    if(threads > 0)
+      bench("files-bodies", sources, iterations, threads);
+  } else {
+    auto text = generate(size);
+    std::vector<source> sources{source{"generated", text.data(), text.data() + text.size()}};
+    bench("generated", sources, iterations, 0);
+    bench("decls", sources, iterations, -1);
+    if(threads > 0)
+      bench("bodies", sources, iterations, threads);
+  }
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("peak RSS %ld KiB\n", usage.ru_maxrss);
+  return printDiagnosticSummary();
+}
@@ -1,18 +1,29 @@
 #include "ast.h"
 #include "type.h"
 #include "compile.h"
+#include "parser.h"
 
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Analysis/Verifier.h"
 
+#include <type_traits>
+#include <vector>
+
+// the ast_context frees these without destroying them
+static_assert(std::is_trivially_destructible<c4::decl>::value
+              && std::is_trivially_destructible<c4::declarator>::value
+              && std::is_trivially_destructible<c4::comp_stmt>::value
+              && std::is_trivially_destructible<c4::if_else_stmt>::value,
+              "a node without a type got a destructor");
+
 namespace {
 llvm::BasicBlock* create_block(llvm::IRBuilder<>&);
 void gen_cond_branch(llvm::Module& m, llvm::IRBuilder<>& builder, 
 		     llvm::IRBuilder<>& alloca_builder, 
 		     c4::named_values_map& named_values,
-		     const std::unique_ptr<c4::expression>& cond,
-		     std::unique_ptr<c4::stmt>& body,
+		     const c4::ast_ptr<c4::expression>& cond,
+		     c4::ast_ptr<c4::stmt>& body,
 		     llvm::BasicBlock* false_blk,
 		     llvm::BasicBlock* end_blk);
 llvm::Value* type_size(const std::shared_ptr<c4::type> type, 
@@ -21,19 +32,19 @@ llvm::Value*
 ptr_addition(llvm::Module& m, 
 	     llvm::IRBuilder<>& builder,
 	     c4::named_values_map& named_values, 
-	     const std::unique_ptr<c4::expression>& left,
-	     const std::unique_ptr<c4::expression>& right,
+	     const c4::ast_ptr<c4::expression>& left,
+	     const c4::ast_ptr<c4::expression>& right,
 	     bool sub=0);
-llvm::Value* rvalue_as_int(const std::unique_ptr<c4::expression>&,
+llvm::Value* rvalue_as_int(const c4::ast_ptr<c4::expression>&,
 			   llvm::Module&,  
 			   llvm::IRBuilder<>&,
 			   c4::named_values_map&);
-llvm::Value* rvalue_as_char(const std::unique_ptr<c4::expression>&,
+llvm::Value* rvalue_as_char(const c4::ast_ptr<c4::expression>&,
 			    llvm::Module&,  
 			    llvm::IRBuilder<>&, 
 			    c4::named_values_map&);
 llvm::Value* as_int(llvm::Value*, llvm::IRBuilder<>&);
-llvm::Value* cast_val(const std::unique_ptr<c4::expression>&, 
+llvm::Value* cast_val(const c4::ast_ptr<c4::expression>&, 
 		      const std::shared_ptr<c4::type>&,
 		      llvm::Type*, 
 		      llvm::Module&,  
@@ -43,7 +54,7 @@ std::vector<std::pair<llvm::BasicBlock*, llvm::BasicBlock*>> loops;
 bool jumped = false;
 }
 
-const std::string& c4::base_decl::get_name() const {
+c4::symbol c4::base_decl::get_name() const {
   // We use name_.empty() to designate "not yet retrieved". This sucks
   // in the case of abstract decls, but hey, we are not supposed to
   // call it that often.
@@ -59,7 +70,7 @@ const std::string& c4::base_decl::get_name() const {
   return name_;
 }
 
-const std::vector<std::unique_ptr<c4::parameter_decl>>&
+const c4::ast_list<c4::ast_ptr<c4::parameter_decl>>&
 c4::base_decl::parameter_decls() const {
   // search through the declarators to find our parameters
   auto dl = get_declarator();
@@ -83,19 +94,19 @@ c4::base_decl::gen_func_code(llvm::Module& m, llvm::IRBuilder<>& builder,
   if((ltype->isIntegerTy() || ltype->isPointerTy() || ltype->isStructTy())
      && !get_name().empty()) {
     if(get_linkage() != c4::linkage::EXTERNAL) { // file local
-      auto var = alloca_builder.CreateAlloca(ltype, 0, get_name());
+      auto var = alloca_builder.CreateAlloca(ltype, 0, get_name().str());
       (*named_values)[get_name()] = var;
     } else {
       new GlobalVariable(
 	m, ltype, false, GlobalValue::CommonLinkage, // todo right linkage??
-        Constant::getNullValue(ltype), get_name());
+        Constant::getNullValue(ltype), get_name().str());
     }
   } else if(ltype->isFunctionTy()) {
     auto func = Function::Create(cast<FunctionType>(ltype), 
-				 GlobalValue::ExternalLinkage, get_name(), &m);
+				 GlobalValue::ExternalLinkage, get_name().str(), &m);
     auto it = func->arg_begin();
     for(auto& p : parameter_decls()) {
-      it->setName(p->get_name());
+      it->setName(p->get_name().str());
       ++it;
     }
     return func;
@@ -103,15 +114,23 @@ c4::base_decl::gen_func_code(llvm::Module& m, llvm::IRBuilder<>& builder,
   return nullptr;
 }
 
+c4::comp_stmt* c4::decl::get_body() const {
+  if(lazy_ != nullptr) {
+    s_ = parse_body(*lazy_, *lazy_->c);
+    lazy_ = nullptr;
+  }
+  return s_.get();
+}
+
 void
 c4::decl::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder, 
 		   llvm::IRBuilder<>& alloca_builder,
 		   named_values_map* old_named_values) const {
   using namespace llvm;
   auto fun = gen_func_code(m, builder, alloca_builder, old_named_values);
-  if(fun && fun->getName() != get_name()) {
+  if(fun && fun->getName() != get_name().str()) {
     fun->eraseFromParent();
-    fun = m.getFunction(get_name());
+    fun = m.getFunction(get_name().str());
   }
   
   if(fun && has_body()) {
@@ -120,17 +139,19 @@ c4::decl::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder,
     builder.SetInsertPoint(block);
     alloca_builder.SetInsertPoint(block);
 
-    std::map<std::string, llvm::AllocaInst*> new_named_values;
+    named_values_map new_named_values;
 
-    // generate stack space for the function arguments
-    for(auto it = fun->arg_begin(); it != fun->arg_end(); ++it) {
+    // generate stack space for the function arguments; take the names
+    // from this definition, fun may come from an earlier prototype
+    auto p = parameter_decls().begin();
+    for(auto it = fun->arg_begin(); it != fun->arg_end(); ++it, ++p) {
       auto arg = alloca_builder.CreateAlloca(it->getType(), 0);
-      new_named_values[it->getName()] = arg; // no checks, we know this is safe.
+      new_named_values[(*p)->get_name()] = arg; // no checks, we know this is safe.
       builder.CreateStore(it, arg);
     }
     
     // generate code for the function body (comp_stmt)
-    s_->gen_code(m, builder, alloca_builder, new_named_values);
+    get_body()->gen_code(m, builder, alloca_builder, new_named_values);
   
     // make sure function has a terminator
     if(!builder.GetInsertBlock()->getTerminator()) {
@@ -151,12 +172,9 @@ void c4::comp_stmt::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder,
   for(auto& ss : stmts_) {
     if(jumped) break;
     if(ss->is_stmt()) {
-      auto stmt = dynamic_cast<c4::stmt*>(ss.get());
-      assert(stmt);
-      stmt->gen_code(m, builder, alloca_builder, named_values);
-    } else if(ss->is_decl()) {
-      auto dd = dynamic_cast<c4::decl*>(ss.get());
-      assert(dd);
+      static_cast<c4::stmt*>(ss.get())->gen_code(m, builder, alloca_builder,
+                                                  named_values);
+    } else if(auto dd = c4::ast_cast<c4::decl>(ss.get())) {
       dd->gen_code(m, builder, alloca_builder, &named_values);
     }
   }
@@ -216,8 +234,8 @@ namespace {
 void gen_cond_branch(llvm::Module& m, llvm::IRBuilder<>& builder, 
 		     llvm::IRBuilder<>& alloca_builder, 
 		     c4::named_values_map& named_values,
-		     const std::unique_ptr<c4::expression>& cond,
-		     std::unique_ptr<c4::stmt>& body,
+		     const c4::ast_ptr<c4::expression>& cond,
+		     c4::ast_ptr<c4::stmt>& body,
 		     llvm::BasicBlock* false_blk,
 		     llvm::BasicBlock* end_blk) {
   using namespace llvm;
@@ -260,15 +278,25 @@ void c4::if_else_stmt::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder,
 				llvm::IRBuilder<>& alloca_builder, 
 				named_values_map& named_values) {
   using namespace llvm;
-  BasicBlock* else_body = create_block(builder);
-  BasicBlock* end = create_block(builder);
-  gen_cond_branch(m, builder, alloca_builder, 
-		  named_values, cond_, if_body_, else_body, end);
-  else_body_->gen_code(m, builder, alloca_builder, named_values);
-  if(!jumped)
-    builder.CreateBr(end);
-  jumped = false;
-  builder.SetInsertPoint(end);
+  // else if chains can be long, they go down in a loop and their ends
+  // are closed on the way back
+  std::vector<BasicBlock*> ends;
+  stmt* s = this;
+  while(auto ies = ast_cast<if_else_stmt>(s)) {
+    BasicBlock* else_body = create_block(builder);
+    BasicBlock* end = create_block(builder);
+    ends.push_back(end);
+    gen_cond_branch(m, builder, alloca_builder, 
+		    named_values, ies->cond_, ies->if_body_, else_body, end);
+    s = ies->else_body();
+  }
+  s->gen_code(m, builder, alloca_builder, named_values);
+  for(auto it = ends.rbegin(); it != ends.rend(); ++it) {
+    if(!jumped)
+      builder.CreateBr(*it);
+    jumped = false;
+    builder.SetInsertPoint(*it);
+  }
 }
 
 void c4::expr_stmt::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder, 
@@ -278,17 +306,16 @@ void c4::expr_stmt::gen_code(llvm::Module& m, llvm::IRBuilder<>& builder,
     expr_->rvalue(m, builder, named_values);
 }
 
-
 llvm::Value* 
 c4::primary_expression::lvalue(llvm::Module& m, 
 			       llvm::IRBuilder<>&, 
 			       named_values_map& named_values) const {
   assert(val_.type == c4::token_type::IDENTIFIER);
-  auto it = named_values.find(val_.data);
+  auto it = named_values.find(val_.name);
   if(it != named_values.end())
     return it->second;
   else // function cannot be an lvalue
-    return m.getGlobalVariable(val_.data);
+    return m.getGlobalVariable(val_.data());
 }
 
 llvm::Value* 
@@ -297,13 +324,13 @@ c4::primary_expression::rvalue(llvm::Module& m,
 			       named_values_map& named_values) const { 
   switch(val_.type) {
   case token_type::INTEGER_CONSTANT:
-    return builder.getInt32(std::stoi(val_.data));
+    return builder.getInt32(std::stoi(val_.data()));
   case token_type::CHARACTER_CONSTANT:
     return builder.getInt32(purify_str().c_str()[0]);
   case token_type::STRING_LITERAL:
     return builder.CreateGlobalStringPtr(purify_str());
   default: {  // identifier
-    if(auto func = m.getFunction(val_.data))
+    if(auto func = m.getFunction(val_.data()))
       return func;
     return builder.CreateLoad(lvalue(m, builder, named_values));
   }
@@ -311,15 +338,15 @@ c4::primary_expression::rvalue(llvm::Module& m,
 }
 
 std::string c4::primary_expression::purify_str() const {
-  assert(val_.data.size() >= 2);
+  assert(val_.data().size() >= 2);
   std::string s;
-  s.reserve(val_.data.size());
-  for(unsigned int i = 1; i < val_.data.size() - 1; ++i) {
-    if(val_.data[i] != '\\') {
-      s += val_.data[i];
+  s.reserve(val_.data().size());
+  for(unsigned int i = 1; i < val_.data().size() - 1; ++i) {
+    if(val_.data()[i] != '\\') {
+      s += val_.data()[i];
     } else {
       ++i;
-      switch(val_.data[i]) {
+      switch(val_.data()[i]) {
       case '\'': s += '\''; break;
       case '\"': s += '\"'; break;
       case '?': s += '\?'; break;
@@ -340,11 +367,11 @@ std::string c4::primary_expression::purify_str() const {
 llvm::Value* 
 c4::sizeof_expr::rvalue(llvm::Module&, llvm::IRBuilder<>& builder, 
 			named_values_map&) const {
-  if(auto pe = dynamic_cast<const primary_expression*> (expr_.get())) {
+  if(auto pe = ast_cast<primary_expression>(expr())) {
     if(pe->value().type == token_type::STRING_LITERAL)
       return builder.getInt32(pe->purify_str().size() + 1);
   }
-  return type_size(expr_->e_type(), builder);
+  return type_size(expr()->e_type(), builder);
 }
 
 llvm::Value* 
@@ -357,25 +384,25 @@ llvm::Value*
 c4::unary_operator::lvalue(llvm::Module& m, 
 			    llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  assert(operator_ == token_type::PCTR_STAR);
-  return operand_->rvalue(m, builder, named_values);
+  assert(op() == token_type::PCTR_STAR);
+  return operand()->rvalue(m, builder, named_values);
 }
 
 llvm::Value* 
 c4::unary_operator::rvalue(llvm::Module& m, 
 			    llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  switch(operator_) {
+  switch(op()) {
   case token_type::PCTR_STAR:
-    return builder.CreateLoad(operand_->rvalue(m, builder, named_values));
+    return builder.CreateLoad(operand()->rvalue(m, builder, named_values));
   case token_type::PCTR_BANG:
     return as_int(cfvalue(m, builder, named_values), builder);
   case token_type::PCTR_MINUS: {
-    auto operand = rvalue_as_int(operand_, m, builder, named_values);
-    return builder.CreateSub(builder.getInt32(0), operand);
+    auto value = rvalue_as_int(operand(), m, builder, named_values);
+    return builder.CreateSub(builder.getInt32(0), value);
   }
   default: // PCTR_BIT_AND
-    return operand_->lvalue(m, builder, named_values);
+    return operand()->lvalue(m, builder, named_values);
   }
 }
 
@@ -383,8 +410,8 @@ llvm::Value*
 c4::unary_operator::cfvalue(llvm::Module& m, 
 			    llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  if(operator_ == token_type::PCTR_BANG) {
-    auto val = operand_->rvalue(m, builder, named_values);
+  if(op() == token_type::PCTR_BANG) {
+    auto val = operand()->rvalue(m, builder, named_values);
     auto zero = llvm::Constant::getNullValue(val->getType());
     return builder.CreateICmpEQ(val, zero);
   } else 
@@ -396,40 +423,54 @@ c4::binary_operator::rvalue(llvm::Module& m,
 			    llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
   using namespace llvm;
-  if(op_ == token_type::PCTR_ASSIGN) {
-    auto left = left_->lvalue(m, builder, named_values);
-    llvm::Value* right;
-    if(type_->is_char())
-      right = rvalue_as_char(right_, m, builder, named_values);
-    else if(type_->is_int())
-      right = rvalue_as_int(right_, m, builder, named_values);
-    else if(right_->e_type()->is_zero())
-      right = Constant::getNullValue(left->getType());
+  if(op() == token_type::PCTR_ASSIGN) {
+    auto lhs = left()->lvalue(m, builder, named_values);
+    llvm::Value* rhs;
+    if(e_type()->is_char())
+      rhs = rvalue_as_char(right(), m, builder, named_values);
+    else if(e_type()->is_int())
+      rhs = rvalue_as_int(right(), m, builder, named_values);
+    else if(right()->e_type()->is_zero())
+      rhs = Constant::getNullValue(lhs->getType());
     else
-      right = cast_val(right_, left_->e_type(), left->getType(), 
+      rhs = cast_val(right(), left()->e_type(), lhs->getType(), 
 		       m, builder, named_values);
-    builder.CreateStore(right, left);
-    return right;
+    builder.CreateStore(rhs, lhs);
+    return rhs;
   } else if(!is_arithmetic()) {
     return as_int(cfvalue(m, builder, named_values), builder);
   } // op_ is +, -, or *
 
-  if(type_->is_pointer()) // pointer +/- int 
-    return ptr_addition(m, builder, named_values, left_, right_, 
-			op_ == token_type::PCTR_MINUS);
+  if(e_type()->is_pointer()) // pointer +/- int 
+    return ptr_addition(m, builder, named_values, left(), right(), 
+			op() == token_type::PCTR_MINUS);
 
 
-  auto left = rvalue_as_int(left_, m, builder, named_values);
-  auto right = rvalue_as_int(right_, m, builder, named_values);
+  // a chain like a + b + c nests to the left as deep as it is long, so
+  // that side is generated in a loop
+  std::vector<const binary_operator*> chain{this};
+  while(auto left = ast_cast<binary_operator>(chain.back()->left())) {
+    if(left->op() == token_type::PCTR_ASSIGN || !left->is_arithmetic()
+       || left->e_type()->is_pointer())
+      break;
+    chain.push_back(left);
+  }
 
-  switch(op_) {
-  case token_type::PCTR_PLUS:
-    return builder.CreateAdd(left, right);
-  case token_type::PCTR_STAR:
-    return builder.CreateMul(left, right);
-  default: // MINUS
-    return builder.CreateSub(left, right);
+  auto value = rvalue_as_int(chain.back()->left(), m, builder, named_values);
+  for(auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    auto right = rvalue_as_int((*it)->right(), m, builder, named_values);
+    switch((*it)->op()) {
+    case token_type::PCTR_PLUS:
+      value = builder.CreateAdd(value, right);
+      break;
+    case token_type::PCTR_STAR:
+      value = builder.CreateMul(value, right);
+      break;
+    default: // MINUS
+      value = builder.CreateSub(value, right);
+    }
   }
+  return value;
 }
 
 llvm::Value* 
@@ -440,16 +481,16 @@ c4::binary_operator::cfvalue(llvm::Module& m,
   if(is_arithmetic()) {
     return expression::cfvalue(m, builder, named_values);
   } else if(is_logical()) { 
-    bool and_op = op_ == token_type::PCTR_AND;
+    bool and_op = op() == token_type::PCTR_AND;
     BasicBlock* curr = builder.GetInsertBlock();
     BasicBlock* t_block = create_block(builder);
     BasicBlock* f_block = create_block(builder);
-    auto l_cond = left_->cfvalue(m, builder, named_values);
+    auto l_cond = left()->cfvalue(m, builder, named_values);
     builder.CreateCondBr(l_cond, t_block, f_block);
     auto first = and_op ? t_block : f_block;
     auto second = and_op ? f_block : t_block;
     builder.SetInsertPoint(first);
-    auto r_cond = right_->cfvalue(m, builder, named_values);
+    auto r_cond = right()->cfvalue(m, builder, named_values);
     builder.CreateBr(second);
     builder.SetInsertPoint(second);
     PHINode* phi = builder.CreatePHI(builder.getInt1Ty(), 2);
@@ -458,29 +499,29 @@ c4::binary_operator::cfvalue(llvm::Module& m,
     return phi;    
   }
  
-  auto left = left_->rvalue(m, builder, named_values);
-  auto right = right_->rvalue(m, builder, named_values);
-   if(left_->e_type()->is_arithmetic() && right_->e_type()->is_arithmetic()) {
-    left = as_int(left, builder);
-    right = as_int(right, builder);
-  } else if(left_->e_type()->is_zero()) {
-    left = Constant::getNullValue(right->getType());
-  } else if(right_->e_type()->is_zero()) {
-    right = Constant::getNullValue(left->getType());
+  auto lhs = left()->rvalue(m, builder, named_values);
+  auto rhs = right()->rvalue(m, builder, named_values);
+   if(left()->e_type()->is_arithmetic() && right()->e_type()->is_arithmetic()) {
+    lhs = as_int(lhs, builder);
+    rhs = as_int(rhs, builder);
+  } else if(left()->e_type()->is_zero()) {
+    lhs = Constant::getNullValue(rhs->getType());
+  } else if(right()->e_type()->is_zero()) {
+    rhs = Constant::getNullValue(lhs->getType());
   } else {
-    right = builder.CreateBitCast(right, left->getType());
+    rhs = builder.CreateBitCast(rhs, lhs->getType());
   } 
   
-  switch(op_) {
+  switch(op()) {
   case token_type::PCTR_EQUAL:
-   return builder.CreateICmpEQ(left, right);
+   return builder.CreateICmpEQ(lhs, rhs);
   case token_type::PCTR_NOT_EQUAL:
-    return builder.CreateICmpNE(left, right);
+    return builder.CreateICmpNE(lhs, rhs);
   default:
-    if(left_->e_type()->is_arithmetic())
-      return builder.CreateICmpSLT(left, right);
+    if(left()->e_type()->is_arithmetic())
+      return builder.CreateICmpSLT(lhs, rhs);
     else
-      return builder.CreateICmpULT(left, right);
+      return builder.CreateICmpULT(lhs, rhs);
   }
 }
 
@@ -488,18 +529,18 @@ llvm::Value*
 c4::postfix_operator::lvalue(llvm::Module& m, llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
   
-  bool deref = op_ == token_type::PCTR_DEREF;
+  bool deref = op() == token_type::PCTR_DEREF;
   llvm::Value* struct_val = deref ? 
-    left_->rvalue(m, builder, named_values) :
-    left_->lvalue(m, builder, named_values);
-  auto& member = dynamic_cast<primary_expression*> (right_.get())->value().data;
+    left()->rvalue(m, builder, named_values) :
+    left()->lvalue(m, builder, named_values);
+  auto member = ast_cast<primary_expression>(right())->value().name;
   std::shared_ptr<c4::struct_type> struct_ty;
   if(deref) {
-    auto ptr_ty = as_pointer_type(left_->e_type());
+    auto ptr_ty = as_pointer_type(left()->e_type());
     assert(ptr_ty);
     struct_ty = as_struct_type(ptr_ty->underlying());
   } else {
-    struct_ty = as_struct_type(left_->e_type());
+    struct_ty = as_struct_type(left()->e_type());
   }
   assert(struct_ty);
   int index = struct_ty->index_of(member);
@@ -518,7 +559,7 @@ c4::postfix_operator::rvalue(llvm::Module& m, llvm::IRBuilder<>& builder,
 llvm::Value*
 c4::subscript_operator::lvalue(llvm::Module& m, llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  return ptr_addition(m, builder, named_values, left_, right_);
+  return ptr_addition(m, builder, named_values, left(), right());
 }
 
 llvm::Value*
@@ -530,11 +571,11 @@ c4::subscript_operator::rvalue(llvm::Module& m, llvm::IRBuilder<>& builder,
 llvm::Value*
 c4::function_call::rvalue(llvm::Module& m, llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  auto func_val = func_->rvalue(m, builder, named_values); 
-  if(params_.size() == 0) 
+  auto func_val = get_name()->rvalue(m, builder, named_values); 
+  if(params().empty()) 
     return builder.CreateCall(func_val);
   std::vector<llvm::Value*> args;
-  for(auto& expr : params_)
+  for(auto expr : params())
     args.emplace_back(expr->rvalue(m, builder, named_values));
   return builder.CreateCall(func_val, args);
 }
@@ -542,9 +583,9 @@ c4::function_call::rvalue(llvm::Module& m, llvm::IRBuilder<>& builder,
 llvm::Value* // TODO do we need to convert any types here?
 c4::ternary_expr::rvalue(llvm::Module& m, llvm::IRBuilder<>& builder, 
 			    named_values_map& named_values) const {
-  return builder.CreateSelect(test_->cfvalue(m, builder, named_values),
-			      true_->rvalue(m, builder, named_values),
-			      false_->rvalue(m, builder, named_values));
+  return builder.CreateSelect(test()->cfvalue(m, builder, named_values),
+			      true_expr()->rvalue(m, builder, named_values),
+			      false_expr()->rvalue(m, builder, named_values));
 }
 
 namespace {
@@ -563,8 +604,8 @@ llvm::Value*
 ptr_addition(llvm::Module& m, 
 	     llvm::IRBuilder<>& builder,
 	     c4::named_values_map& named_values, 
-	     const std::unique_ptr<c4::expression>& left,
-	     const std::unique_ptr<c4::expression>& right,
+	     const c4::ast_ptr<c4::expression>& left,
+	     const c4::ast_ptr<c4::expression>& right,
 	     bool sub) {
   auto& ptr = left->e_type()->is_int() ? right : left;
   auto& index = left->e_type()->is_int() ? left : right;
@@ -576,7 +617,7 @@ ptr_addition(llvm::Module& m,
   
 }
 
-llvm::Value* rvalue_as_int(const std::unique_ptr<c4::expression>& expr,
+llvm::Value* rvalue_as_int(const c4::ast_ptr<c4::expression>& expr,
 			   llvm::Module& m,  
 			   llvm::IRBuilder<>& builder,
 			   c4::named_values_map& named_values) {
@@ -588,7 +629,7 @@ llvm::Value* rvalue_as_int(const std::unique_ptr<c4::expression>& expr,
   return right;
 }
 
-llvm::Value* rvalue_as_char(const std::unique_ptr<c4::expression>& expr,
+llvm::Value* rvalue_as_char(const c4::ast_ptr<c4::expression>& expr,
 			    llvm::Module& m, 
 			    llvm::IRBuilder<>& builder,
 			    c4::named_values_map& named_values) {
@@ -606,7 +647,7 @@ llvm::Value* as_int(llvm::Value* input, llvm::IRBuilder<>& builder) {
     return builder.CreateSExt(input, builder.getInt32Ty());
 }
 
-llvm::Value* cast_val(const std::unique_ptr<c4::expression>& expr,
+llvm::Value* cast_val(const c4::ast_ptr<c4::expression>& expr,
 		      const std::shared_ptr<c4::type>& c4_type,
 		      llvm::Type* type, 
 		      llvm::Module& m,  
@@ -1,11 +1,14 @@
 #ifndef C4_AST_H
 #define C4_AST_H
 
+#include "ast_context.h"
 #include "ast_fwd.h"
-#include "ast_visitor.h"
 #include "token.h"
 #include "pos.h"
+#include "symbol.h"
+#include <initializer_list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
@@ -15,61 +18,94 @@
 
 namespace c4 {
 
-typedef std::map<std::string, llvm::AllocaInst*> named_values_map;
+typedef std::unordered_map<symbol, llvm::AllocaInst*> named_values_map;
 
 struct type;
+struct lazy_body;
 
 enum class linkage {
   NOT_DETERMINED = 0, EXTERNAL, INTERNAL, NONE
 };
 
+//! The class of a node. The decls, stmts and expressions each come in
+//! one run, so asking for the group is a range check.
+enum class ast_kind : unsigned char {
+  TRANSLATION_UNIT, DECLARATOR, TYPE_SPECIFIER, STRUCT_SPECIFIER,
+  PARAMETER_DECL, DECL, TYPE_NAME,
+  COMP_STMT, BREAK_STMT, CONTINUE_STMT, RETURN_STMT, LABELED_STMT,
+  GOTO_STMT, WHILE_STMT, IF_STMT, IF_ELSE_STMT, EXPR_STMT,
+  PRIMARY_EXPRESSION, ERROR_EXPR, SIZEOF_EXPR, SIZEOF_TYPE, UNARY_OPERATOR,
+  BINARY_OPERATOR, POSTFIX_OPERATOR, SUBSCRIPT_OPERATOR, FUNCTION_CALL,
+  TERNARY_EXPR
+};
+
 struct ast_node {
-  //! Return the class name of this object.
   ast_node(const ast_node&) = delete;
   ast_node& operator=(const ast_node&) = delete;
-  virtual ~ast_node() = default;
-  virtual void visit(ast_visitor*) = 0;
-  const Pos& position() { return pos_; }
-  virtual bool is_stmt() const { return false; }
-  virtual bool is_expression() const { return false; }
-  virtual bool is_decl() const { return false; }
+  ast_kind kind() const { return kind_; }
+  SourceLoc position() const;
+  bool is_stmt() const
+  { return kind_ >= ast_kind::COMP_STMT && kind_ <= ast_kind::EXPR_STMT; }
+  bool is_expression() const
+  { return kind_ >= ast_kind::PRIMARY_EXPRESSION && kind_ <= ast_kind::TERNARY_EXPR; }
+  bool is_decl() const
+  { return kind_ >= ast_kind::PARAMETER_DECL && kind_ <= ast_kind::TYPE_NAME; }
 protected:
-  ast_node() : pos_{"BAD POSITION"} {}
-  ast_node(const Pos& pos) : pos_(pos) {}
-  const Pos pos_;
+  ast_node(ast_kind kind) : kind_(kind) {}
+  ast_node(ast_kind kind, SourceLoc pos) : word_(pos.offset), kind_(kind) {}
+  // the ast_context owns every node and destroys it by its real type
+  ~ast_node() = default;
+  // the offset of the position; an expression keeps its id here, its
+  // position is in the table of its context
+  std::uint32_t word_ = 0;
+  const ast_kind kind_;
 };
 
+//! n as a T, or nullptr if it is another kind of node. Only nodes of
+//! exactly the class T match, a struct_specifier is no type_specifier.
+template<typename T>
+T* ast_cast(ast_node* n)
+{
+  return n && n->kind() == T::node_kind ? static_cast<T*>(n) : nullptr;
+}
+
+template<typename T>
+const T* ast_cast(const ast_node* n)
+{
+  return n && n->kind() == T::node_kind ? static_cast<const T*>(n) : nullptr;
+}
+
 ////////// DECLARATIONS //////////
 
 struct translation_unit : ast_node {
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::TRANSLATION_UNIT;
+  translation_unit() : ast_node(node_kind) {}
 
-  const std::vector<std::unique_ptr<decl>>& decls() const { return decls_; }
+  const ast_list<ast_ptr<decl>>& decls() const { return decls_; }
 
   //! Add a declaration to this translation unit.
-  void add_decl(decl* d) { decls_.emplace_back(d); }
+  void add_decl(ast_context& c, decl* d) { decls_.push_back(c, d); }
 private:
-  std::vector<std::unique_ptr<decl>> decls_;
+  ast_list<ast_ptr<decl>> decls_;
 };
 
 struct type_specifier : ast_node {
-  type_specifier(const Pos& p, token_type t) : ast_node(p), token(t) {}
+  static constexpr ast_kind node_kind = ast_kind::TYPE_SPECIFIER;
+  type_specifier(SourceLoc p, token_type t) : ast_node(node_kind, p), token(t) {}
 
-  void visit(ast_visitor* a) { a->visit(this); }
   token_type token;
 
   bool has_type() const { return type_.get() != 0; }
   std::shared_ptr<type>& get_type() { return type_; }
   void set_type(const std::shared_ptr<type>& t) { type_ = t; }
+protected:
+  type_specifier(ast_kind k, SourceLoc p, token_type t) : ast_node(k, p), token(t) {}
 private:
   std::shared_ptr<type> type_;
 };
 
 //! abstract base for all kinds of decls
 struct base_decl : ast_node {
-  base_decl(const Pos& p, type_specifier* ts, declarator* dl)
-    : ast_node{p}, ts_{ts}, dl_{dl}, name_{}, linkage_{linkage::NOT_DETERMINED} {}
-
   type_specifier* get_type_specifier() { return ts_.get(); }
   declarator* get_declarator() { return dl_.get(); }
   const declarator* get_declarator() const { return dl_.get(); }
@@ -78,224 +114,238 @@ struct base_decl : ast_node {
   std::shared_ptr<type>& get_type() { return ts_->get_type(); }
   void set_type(const std::shared_ptr<type>& t) { ts_->set_type(t); }
 
-  const std::string& get_name() const;
+  symbol get_name() const;
 
-  const std::vector<std::unique_ptr<parameter_decl>>&
+  const ast_list<ast_ptr<parameter_decl>>&
   parameter_decls() const;
 
   const linkage& get_linkage() const { return linkage_; }
   void set_linkage(const linkage& l) { linkage_ = l; }
 
-  bool is_decl() const override final { return true; }
-
   llvm::Function* gen_func_code(llvm::Module&, llvm::IRBuilder<>&, 
 				llvm::IRBuilder<>&, named_values_map*) const;
 
+protected:
+  base_decl(ast_kind k, SourceLoc p, type_specifier* ts, declarator* dl)
+    : ast_node{k, p}, ts_{ts}, dl_{dl}, name_{}, linkage_{linkage::NOT_DETERMINED} {}
+
 private:
-  std::unique_ptr<type_specifier> ts_;
-  std::unique_ptr<declarator> dl_;
-  mutable std::string name_;
+  ast_ptr<type_specifier> ts_;
+  ast_ptr<declarator> dl_;
+  mutable symbol name_;
   linkage linkage_;
 };
 
 //! A decl used for parameters.
 struct parameter_decl : base_decl {
-  using base_decl::base_decl;
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::PARAMETER_DECL;
+  parameter_decl(SourceLoc p, type_specifier* ts, declarator* dl)
+    : base_decl(node_kind, p, ts, dl) {}
 };
 
 //! A base_decl with an optional body.
 struct decl : base_decl {
-  using base_decl::base_decl;
-  void visit(ast_visitor* a) { a->visit(this); }
-
-  void set_body(comp_stmt* s) { s_.reset(s); }
-  comp_stmt* get_body() { return s_.get(); }
-  bool has_body() const { return s_ != nullptr; }
+  static constexpr ast_kind node_kind = ast_kind::DECL;
+  decl(SourceLoc p, type_specifier* ts, declarator* dl)
+    : base_decl(node_kind, p, ts, dl) {}
+
+  void set_body(comp_stmt* s) { s_ = s; lazy_ = nullptr; }
+  //! A body the parser skipped; get_body() parses it.
+  void set_lazy_body(lazy_body* b) { lazy_ = b; }
+  lazy_body* get_lazy_body() const { return lazy_; }
+  comp_stmt* get_body() const;
+  bool has_body() const { return s_.get() != nullptr || lazy_ != nullptr; }
   void gen_code(llvm::Module&, llvm::IRBuilder<>&, 
 		llvm::IRBuilder<>&, named_values_map*) const;
 private:
-  std::unique_ptr<comp_stmt> s_;
+  mutable ast_ptr<comp_stmt> s_;
+  mutable lazy_body* lazy_ = nullptr;
 };
 
 
 struct struct_specifier : type_specifier {
-  struct_specifier(const Pos& p, token_type t, const std::string& tag)
-    : type_specifier(p, t), tag_(tag) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::STRUCT_SPECIFIER;
+  struct_specifier(SourceLoc p, token_type t, symbol tag)
+    : type_specifier(node_kind, p, t), tag_(tag) {}
   bool has_decls() const { return !decls_.empty(); }
-  const std::string& get_tag() const { return tag_; }
-  void add_decl(decl* d) { decls_.emplace_back(d); }
-  const std::vector<std::unique_ptr<decl>>& decls() const { return decls_; }
+  symbol get_tag() const { return tag_; }
+  void add_decl(ast_context& c, decl* d) { decls_.push_back(c, d); }
+  const ast_list<ast_ptr<decl>>& decls() const { return decls_; }
 private:
-  std::vector<std::unique_ptr<decl>> decls_;
-  const std::string tag_;
+  ast_list<ast_ptr<decl>> decls_;
+  const symbol tag_;
 };
 
 struct declarator : ast_node {
-  declarator(bool p, declarator* d) : p_(p), d_(d) {}
-  declarator(bool p, const std::string& identifier)
-    : p_(p), d_(nullptr), ident_(identifier) {}
+  static constexpr ast_kind node_kind = ast_kind::DECLARATOR;
+  declarator(bool p, declarator* d) : ast_node(node_kind), p_(p), d_(d) {}
+  declarator(bool p, symbol identifier)
+    : ast_node(node_kind), p_(p), d_(nullptr), ident_(identifier) {}
 
-  void visit(ast_visitor* a) { a->visit(this); }
 
   bool pointer() { return p_; }
   declarator* get_declarator() const { return d_.get(); }
 
-  const std::string& get_identifier() const { return ident_; }
+  symbol get_identifier() const { return ident_; }
 
-  const std::vector<std::unique_ptr<parameter_decl>>&
+  const ast_list<ast_ptr<parameter_decl>>&
   parameter_decls() const { return pds_; }
 
-  void add_parameter_decl(parameter_decl* pd) { pds_.emplace_back(pd); }
+  void add_parameter_decl(ast_context& c, parameter_decl* pd)
+  { pds_.push_back(c, pd); }
 private:
   bool p_;
-  std::unique_ptr<declarator> d_;
-  std::vector<std::unique_ptr<parameter_decl>> pds_;
-  std::string ident_;
+  ast_ptr<declarator> d_;
+  ast_list<ast_ptr<parameter_decl>> pds_;
+  symbol ident_;
 };
 
 struct type_name : base_decl {
-  using base_decl::base_decl;
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::TYPE_NAME;
+  type_name(SourceLoc p, type_specifier* ts, declarator* dl)
+    : base_decl(node_kind, p, ts, dl) {}
 };
 
 ////////// STATEMENTS //////////
 
 struct stmt : ast_node {
-  void visit(ast_visitor* a) { a->visit(this); }
   virtual void gen_code(llvm::Module&, llvm::IRBuilder<>&, 
 			llvm::IRBuilder<>&, named_values_map&)=0;
-
-  bool is_stmt() const override final { return true; }
 protected:
   using ast_node::ast_node;
 };
 
 struct comp_stmt : stmt {
-  void add_stmt(ast_node* s) { stmts_.emplace_back(s); }
-  const std::vector<std::unique_ptr<ast_node>>& sub_stmts() const {
+  static constexpr ast_kind node_kind = ast_kind::COMP_STMT;
+  comp_stmt() : stmt(node_kind) {}
+  void add_stmt(ast_context& c, ast_node* s) { stmts_.push_back(c, s); }
+  const ast_list<ast_ptr<ast_node>>& sub_stmts() const {
     return stmts_;
   }
-  void visit(ast_visitor* a) { a->visit(this); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder,
 		llvm::IRBuilder<>&, named_values_map&) override;
 private:
-  std::vector<std::unique_ptr<ast_node>> stmts_;
+  ast_list<ast_ptr<ast_node>> stmts_;
 };
 
 struct break_stmt : stmt {
-  break_stmt(const Pos& pos) : stmt(pos) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::BREAK_STMT;
+  break_stmt(SourceLoc pos) : stmt(node_kind, pos) {}
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 };
 
 struct continue_stmt : stmt {
-  continue_stmt(const Pos& pos) : stmt(pos) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::CONTINUE_STMT;
+  continue_stmt(SourceLoc pos) : stmt(node_kind, pos) {}
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 };
 
 struct return_stmt : stmt {
-  return_stmt(expression* expr, const Pos& pos) : stmt(pos), expr_(expr) {}
-  return_stmt(const Pos& pos) : stmt(pos), expr_(nullptr) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::RETURN_STMT;
+  return_stmt(expression* expr, SourceLoc pos) : stmt(node_kind, pos), expr_(expr) {}
+  return_stmt(SourceLoc pos) : stmt(node_kind, pos), expr_(nullptr) {}
   expression* expr() { return expr_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
   std::shared_ptr<type>& exp_rtype() { return type_; }
 private:
   std::shared_ptr<type> type_;
-  std::unique_ptr<expression> expr_;
+  ast_ptr<expression> expr_;
 };
 
 struct labeled_stmt : stmt {
- labeled_stmt(const std::string& label, stmt* state, const Pos& pos)
-   : stmt(pos), block_(nullptr), label_(label), stmt_(state) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  const std::string& get_label() { return label_; }
+  static constexpr ast_kind node_kind = ast_kind::LABELED_STMT;
+ labeled_stmt(symbol label, stmt* state, SourceLoc pos)
+   : stmt(node_kind, pos), block_(nullptr), label_(label), stmt_(state) {}
+  symbol get_label() { return label_; }
   stmt* get_stmt() { return stmt_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
   llvm::BasicBlock* get_block(llvm::IRBuilder<>&);
 private:
   llvm::BasicBlock* block_;
-  const std::string label_;
-  std::unique_ptr<stmt> stmt_;
+  const symbol label_;
+  ast_ptr<stmt> stmt_;
 };
 
 struct goto_stmt : stmt {
-  goto_stmt(const std::string& ident, const Pos& pos)
-    : stmt(pos), ident_(ident) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  const std::string& get_label() { return ident_; }
+  static constexpr ast_kind node_kind = ast_kind::GOTO_STMT;
+  goto_stmt(symbol ident, SourceLoc pos)
+    : stmt(node_kind, pos), stmt_(nullptr), ident_(ident) {}
+  symbol get_label() { return ident_; }
+  //! The statement sema found for the label.
+  labeled_stmt* get_labeled_stmt() { return stmt_; }
   void set_label(labeled_stmt* stmt) { stmt_ = stmt; }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 private:
   labeled_stmt* stmt_;
-  const std::string ident_;
+  const symbol ident_;
 };
 
 struct while_stmt : stmt {
- while_stmt(expression* cond, stmt* body, const Pos& pos)
-   : stmt(pos), cond_(cond), body_(body) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::WHILE_STMT;
+ while_stmt(expression* cond, stmt* body, SourceLoc pos)
+   : stmt(node_kind, pos), cond_(cond), body_(body) {}
   expression* condition() { return cond_.get(); }
   stmt* body() { return body_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 private:
-  std::unique_ptr<expression> cond_;
-  std::unique_ptr<stmt> body_;
+  ast_ptr<expression> cond_;
+  ast_ptr<stmt> body_;
 };
 
 struct if_stmt : stmt {
-  if_stmt(expression* cond, stmt* body, const Pos& pos)
-    : stmt(pos), cond_(cond), body_(body) {}
+  static constexpr ast_kind node_kind = ast_kind::IF_STMT;
+  if_stmt(expression* cond, stmt* body, SourceLoc pos)
+    : stmt(node_kind, pos), cond_(cond), body_(body) {}
   stmt* body() { return body_.get(); }
   expression* condition() { return cond_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
-  void visit(ast_visitor* a) { a->visit(this); }
 private:
-  std::unique_ptr<expression> cond_;
-  std::unique_ptr<stmt> body_;
+  ast_ptr<expression> cond_;
+  ast_ptr<stmt> body_;
 };
 
 struct if_else_stmt : stmt {
-  if_else_stmt(expression* cond, stmt* if_body, stmt* else_body, const Pos& pos)
-    : stmt(pos), cond_(cond), if_body_(if_body), else_body_(else_body) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::IF_ELSE_STMT;
+  if_else_stmt(expression* cond, stmt* if_body, stmt* else_body, SourceLoc pos)
+    : stmt(node_kind, pos), cond_(cond), if_body_(if_body), else_body_(else_body) {}
   expression* condition() { return cond_.get(); }
   stmt* if_body() { return if_body_.get(); }
   stmt* else_body() { return else_body_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 private:
-  std::unique_ptr<expression> cond_;
-  std::unique_ptr<stmt> if_body_;
-  std::unique_ptr<stmt> else_body_;
+  ast_ptr<expression> cond_;
+  ast_ptr<stmt> if_body_;
+  ast_ptr<stmt> else_body_;
 };
 
 struct expr_stmt : stmt {
-  expr_stmt(expression* expr) : expr_(expr) {}
-  expr_stmt() : expr_(nullptr) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::EXPR_STMT;
+  expr_stmt(expression* expr) : stmt(node_kind), expr_(expr) {}
+  expr_stmt() : stmt(node_kind), expr_(nullptr) {}
   expression* expr() { return expr_.get(); }
   void gen_code(llvm::Module&, llvm::IRBuilder<>& builder, 
 		llvm::IRBuilder<>&, named_values_map&) override;
 private:
-  std::unique_ptr<expression> expr_;
+  ast_ptr<expression> expr_;
 };
 
 ////////// EXPRESSIONS  //////////
 
+//! An expression is an entry in the table of its ast_context, which
+//! holds its operator, its operands, its position and its type. The
+//! node adds code generation and what has no room in the table.
 struct expression : ast_node {
-  void visit(ast_visitor* a) { a->visit(this); }
-  std::shared_ptr<type>& e_type() { return type_; }
+  expr_id id() const { return word_; }
+  ast_context& context() const { return *ctx_; }
+  std::shared_ptr<type>& e_type() const { return ctx_->type_of(word_); }
   virtual llvm::Value* lvalue(llvm::Module&,
 			      llvm::IRBuilder<>&,
                               named_values_map&) 
@@ -311,17 +361,44 @@ struct expression : ast_node {
     auto zero = llvm::Constant::getNullValue(val->getType());
     return builder.CreateICmpNE(val, zero);
   }
-
-  bool is_expression() const override final { return true; }
 protected:
-  std::shared_ptr<type> type_;
-  using ast_node::ast_node;
+  expression(ast_context& c, ast_kind kind, token_type op, SourceLoc pos,
+             std::initializer_list<expression*> operands = {})
+    : ast_node(kind)
+  { c.add_expression(this, kind, op, pos, operands.begin(), operands.size()); }
+  expression(ast_context& c, ast_kind kind, token_type op, SourceLoc pos,
+             expression* const* operands, std::size_t n)
+    : ast_node(kind)
+  { c.add_expression(this, kind, op, pos, operands, n); }
+  token_type table_op() const { return ctx_->entry(word_).op; }
+  expression* operand_at(std::size_t i) const
+  { return ctx_->expression_at(ctx_->operand(word_, i)); }
+private:
+  friend class ast_context;
+  friend struct ast_node;
+  ast_context* ctx_ = nullptr;
 };
 
+inline expr_id ast_context::id_of(const expression* e) { return e->id(); }
+
+inline void ast_context::set_id(expression* e, expr_id id)
+{
+  e->ctx_ = this;
+  e->word_ = id;
+}
+
+inline SourceLoc ast_node::position() const
+{
+  if(!is_expression())
+    return SourceLoc{word_};
+  auto e = static_cast<const expression*>(this);
+  return e->ctx_->position_of(word_);
+}
+
 struct primary_expression : expression {
-  primary_expression(const token& val, const Pos& pos)
-    : expression(pos), val_(val) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::PRIMARY_EXPRESSION;
+  primary_expression(ast_context& c, const token& val, SourceLoc pos)
+    : expression(c, node_kind, val.type, pos), val_(val) {}
   const token& value() const { return val_; }
   llvm::Value* lvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
@@ -332,131 +409,125 @@ private:
   const token val_;
 };
 
+//! Stands in for an expression that didn't parse. There are errors
+//! then, so neither sema nor codegen ever get to see it.
+struct error_expr : expression {
+  static constexpr ast_kind node_kind = ast_kind::ERROR_EXPR;
+  error_expr(ast_context& c, SourceLoc pos)
+    : expression(c, node_kind, token_type::INVALID, pos) {}
+  llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
+    const override { assert(false); return nullptr; }
+};
+
 struct sizeof_expr : expression {
-  sizeof_expr(expression* expr, const Pos& pos) : expression(pos), expr_(expr) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  expression* expr() { return expr_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::SIZEOF_EXPR;
+  sizeof_expr(ast_context& c, expression* expr, SourceLoc pos)
+    : expression(c, node_kind, token_type::KWD_SIZEOF, pos, {expr}) {}
+  expression* expr() const { return operand_at(0); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
-private:
-  std::unique_ptr<expression> expr_;
 };
 
 struct sizeof_type : expression {
-  sizeof_type(type_name* tn, const Pos& pos) : expression(pos), tn_(tn) {}
-  void visit(ast_visitor* a) { a->visit(this); }
+  static constexpr ast_kind node_kind = ast_kind::SIZEOF_TYPE;
+  sizeof_type(ast_context& c, type_name* tn, SourceLoc pos)
+    : expression(c, node_kind, token_type::KWD_SIZEOF, pos), tn_(tn) {}
   type_name* get_type_name() { return tn_.get(); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
 private:
-  std::unique_ptr<type_name> tn_;
+  ast_ptr<type_name> tn_;
 };
 
 struct unary_operator : expression {
-  unary_operator(token_type op, expression* operand, const Pos& pos)
-    : expression(pos), operator_(op), operand_(operand) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  token_type op() { return operator_; }
-  expression* operand() { return operand_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::UNARY_OPERATOR;
+  unary_operator(ast_context& c, token_type op, expression* operand, SourceLoc pos)
+    : expression(c, node_kind, op, pos, {operand}) {}
+  token_type op() const { return table_op(); }
+  expression* operand() const { return operand_at(0); }
   llvm::Value* lvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
   llvm::Value* cfvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&)
     const override;
-private:
-  token_type operator_;
-  std::unique_ptr<expression> operand_;
 };
 
 struct binary_operator : expression {
-  binary_operator(token_type op, expression* left, expression* right,
-                  const Pos& pos)
-    : expression(pos), op_(op), left_(left), right_(right) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  token_type op() { return op_; }
-  expression* left() { return left_.get(); }
-  expression* right() { return right_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::BINARY_OPERATOR;
+  binary_operator(ast_context& c, token_type op, expression* left, expression* right,
+                  SourceLoc pos)
+    : expression(c, node_kind, op, pos, {left, right}) {}
+  token_type op() const { return table_op(); }
+  expression* left() const { return operand_at(0); }
+  expression* right() const { return operand_at(1); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
   llvm::Value* cfvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&)
     const override;
 private:
   inline bool is_arithmetic() const { 
-    return op_ == token_type::PCTR_PLUS || op_ == token_type::PCTR_STAR ||
-      op_ == token_type::PCTR_MINUS || op_ == token_type::PCTR_ASSIGN;
+    auto o = op();
+    return o == token_type::PCTR_PLUS || o == token_type::PCTR_STAR ||
+      o == token_type::PCTR_MINUS || o == token_type::PCTR_ASSIGN;
   }
   inline bool is_logical() const { 
-    return op_ == token_type::PCTR_AND || op_ == token_type::PCTR_OR;
+    auto o = op();
+    return o == token_type::PCTR_AND || o == token_type::PCTR_OR;
   }
-  token_type op_;
-  std::unique_ptr<expression> left_;
-  std::unique_ptr<expression> right_;
 };
 
+//! A member access; the right operand is the member name, a primary
+//! expression that is no expression of its own and gets no type.
 struct postfix_operator : expression {
-  postfix_operator(token_type op, expression* left, expression* right,
-                   const Pos& pos)
-    : expression(pos), op_(op), left_(left), right_(right) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  token_type op() { return op_; }
-  expression* left() { return left_.get(); }
-  expression* right() { return right_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::POSTFIX_OPERATOR;
+  postfix_operator(ast_context& c, token_type op, expression* left, expression* right,
+                   SourceLoc pos)
+    : expression(c, node_kind, op, pos, {left, right}) {}
+  token_type op() const { return table_op(); }
+  expression* left() const { return operand_at(0); }
+  expression* right() const { return operand_at(1); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
   llvm::Value* lvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
-private:
-  token_type op_;
-  std::unique_ptr<expression> left_;
-  std::unique_ptr<expression> right_;
 };
 
 struct subscript_operator : expression {
-  subscript_operator(expression* left, expression* right, const Pos& pos)
-    : expression(pos), left_(left), right_(right) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  expression* left() { return left_.get(); }
-  expression* right() { return right_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::SUBSCRIPT_OPERATOR;
+  subscript_operator(ast_context& c, expression* left, expression* right, SourceLoc pos)
+    : expression(c, node_kind, token_type::PCTR_LBRACKET, pos, {left, right}) {}
+  expression* left() const { return operand_at(0); }
+  expression* right() const { return operand_at(1); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
   llvm::Value* lvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
-private:
-  std::unique_ptr<expression> left_;
-  std::unique_ptr<expression> right_;
 };
 
+//! The operands of a call are the called expression and then the
+//! arguments, so a call is made after all of them.
 struct function_call : expression {
-  function_call(expression* func, const Pos& pos)
-    : expression(pos), func_(func) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  void add_param(expression* p) { params_.emplace_back(p); }
-  const std::vector<std::unique_ptr<expression>>& params() const {
-    return params_;
-  }
-  expression* get_name() { return func_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::FUNCTION_CALL;
+  function_call(ast_context& c, expression* const* operands, std::size_t n, SourceLoc pos)
+    : expression(c, node_kind, token_type::PCTR_LPAREN, pos, operands, n) {}
+  expr_list params() const { return expr_list{context(), id(), 1}; }
+  expression* get_name() const { return operand_at(0); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
-private:
-  std::unique_ptr<expression> func_;
-  std::vector<std::unique_ptr<expression>> params_;
 };
 
 struct ternary_expr : expression {
-  ternary_expr(expression* test, expression* true_expr,
-	       expression* false_expr, const Pos& pos)
-    : expression(pos), test_(test), true_(true_expr), false_(false_expr) {}
-  void visit(ast_visitor* a) { a->visit(this); }
-  expression* test() { return test_.get(); }
-  expression* true_expr() { return true_.get(); }
-  expression* false_expr() { return false_.get(); }
+  static constexpr ast_kind node_kind = ast_kind::TERNARY_EXPR;
+  ternary_expr(ast_context& c, expression* test, expression* true_expr,
+	       expression* false_expr, SourceLoc pos)
+    : expression(c, node_kind, token_type::PCTR_QUESTIONMARK, pos,
+                 {test, true_expr, false_expr}) {}
+  expression* test() const { return operand_at(0); }
+  expression* true_expr() const { return operand_at(1); }
+  expression* false_expr() const { return operand_at(2); }
   llvm::Value* rvalue(llvm::Module&, llvm::IRBuilder<>&, named_values_map&) 
     const override;
-private:
-  std::unique_ptr<expression> test_;
-  std::unique_ptr<expression> true_;
-  std::unique_ptr<expression> false_;
 };
 
 } // c4
@@ -0,0 +1,128 @@
+#include "ast_context.h"
+#include "ast.h"
+
+#include <iterator>
+#include <limits>
+
+namespace c4 {
+
+const std::size_t ast_context::block_size;
+
+ast_context::~ast_context()
+{
+  for(cleanup* c = cleanups_; c; c = c->next)
+    c->run(c + 1);
+}
+
+void* ast_context::allocate_block(std::size_t size)
+{
+  // new[] aligns for every fundamental type
+  std::size_t n = std::max(block_size, size);
+  blocks_.emplace_back(new char[n]);
+  char* p = blocks_.back().get();
+  free_ = p + size;
+  left_ = n - size;
+  allocated_ += size;
+  return p;
+}
+
+// the types are kept here so that expressions go without a cleanup
+static_assert(std::is_trivially_destructible<binary_operator>::value
+              && std::is_trivially_destructible<primary_expression>::value,
+              "expressions must not need destruction");
+
+// the arrays grow by doubling, each growth is an allocation like a block
+void ast_context::reserve_expressions(std::size_t n)
+{
+  exprs_.reserve(n);
+  locs_.reserve(n);
+  nodes_.reserve(n);
+  table_blocks_ += 3;
+}
+
+void ast_context::grow_table(std::size_t n)
+{
+  assert(exprs_.size() < std::numeric_limits<expr_id>::max());
+  if(exprs_.size() == exprs_.capacity())
+    reserve_expressions(std::max<std::size_t>(1024, 2 * exprs_.capacity()));
+  if(operands_.size() + n > operands_.capacity()) {
+    operands_.reserve(std::max(operands_.size() + n, std::max<std::size_t>(1024, 2 * operands_.capacity())));
+    ++table_blocks_;
+  }
+}
+
+expr_id ast_context::first_of(expr_id id) const
+{
+  // operand 0 is made first, so the run starts at its first
+  while(operand_count(id) != 0)
+    id = operand(id, 0);
+  return id;
+}
+
+// the types come with sema, until then there are none
+void ast_context::make_types()
+{
+  types_.resize(exprs_.size());
+  ++table_blocks_;
+}
+
+std::size_t ast_context::table_bytes() const
+{
+  return exprs_.size() * sizeof(expr_entry) + operands_.size() * sizeof(expr_id)
+    + locs_.size() * sizeof(SourceLoc) + types_.size() * sizeof(std::shared_ptr<type>)
+    + nodes_.size() * sizeof(expression*);
+}
+
+void ast_context::adopt(ast_context& other)
+{
+  // renumber the expressions of other after these, their operands and
+  // types move along
+  expr_id offset = expressions();
+  std::size_t n = exprs_.size() + other.exprs_.size();
+  if(n > exprs_.capacity())
+    reserve_expressions(std::max(n, 2 * exprs_.capacity()));
+  if(operands_.size() + other.operands_.size() > operands_.capacity()) {
+    operands_.reserve(std::max(operands_.size() + other.operands_.size(), 2 * operands_.capacity()));
+    ++table_blocks_;
+  }
+  auto operands = static_cast<std::uint32_t>(operands_.size());
+  for(auto e : other.exprs_) {
+    e.operands += operands;
+    exprs_.push_back(e);
+  }
+  for(auto id : other.operands_)
+    operands_.push_back(id + offset);
+  locs_.insert(locs_.end(), other.locs_.begin(), other.locs_.end());
+  if(!other.types_.empty()) {
+    types_.resize(offset);
+    types_.insert(types_.end(), std::make_move_iterator(other.types_.begin()),
+                  std::make_move_iterator(other.types_.end()));
+  }
+  for(auto e : other.nodes_) {
+    e->ctx_ = this;
+    e->word_ += offset;
+    nodes_.push_back(e);
+  }
+  other.exprs_.clear();
+  other.operands_.clear();
+  other.locs_.clear();
+  other.types_.clear();
+  other.nodes_.clear();
+  blocks_.insert(blocks_.end(), std::make_move_iterator(other.blocks_.begin()),
+                 std::make_move_iterator(other.blocks_.end()));
+  other.blocks_.clear();
+  if(other.cleanups_) {
+    other.last_cleanup_->next = cleanups_;
+    if(!cleanups_)
+      last_cleanup_ = other.last_cleanup_;
+    cleanups_ = other.cleanups_;
+  }
+  allocated_ += other.allocated_;
+  table_blocks_ += other.table_blocks_;
+  other.table_blocks_ = 0;
+  other.cleanups_ = other.last_cleanup_ = nullptr;
+  other.free_ = nullptr;
+  other.left_ = other.allocated_ = 0;
+}
+
+} // c4
@@ -0,0 +1,287 @@
+#ifndef C4_AST_CONTEXT_H
+#define C4_AST_CONTEXT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "pos.h"
+
+namespace c4 {
+
+struct expression;
+struct type;
+class expr_list;
+enum class ast_kind : unsigned char;
+enum class token_type : std::uint8_t;
+
+//! The number of an expression in the ast_context that made it. An
+//! expression is made after its operands, the first one first, so the
+//! ids of an expression and of everything below it are a run that ends
+//! with its own.
+typedef std::uint32_t expr_id;
+
+//! An expression in the flat table: its kind, its operator, or for a
+//! primary expression the type of its token, and where its operand ids
+//! start in the table's operands; they end where the next one's start.
+struct expr_entry
+{
+  ast_kind kind;
+  token_type op;
+  std::uint32_t operands;
+};
+
+//! Owns the nodes of a translation unit. Nodes are bump allocated from
+//! large blocks and stay until the context goes away, which frees the
+//! blocks without walking the tree. Only nodes with a destructor that
+//! does something, those holding a type, are chained together and
+//! destroyed first.
+//! Expressions are also kept flat: one array of entries indexed by id,
+//! with the operands as ids, and parallel arrays of their positions,
+//! their types and their nodes. An expression node holds no more than
+//! its id and what the table has no room for, so a pass over kinds,
+//! operators, operands and types scans the arrays in id order and only
+//! goes to a node for a name or a constant.
+class ast_context
+{
+public:
+  ast_context() = default;
+  ast_context(const ast_context&) = delete;
+  ast_context& operator=(const ast_context&) = delete;
+  ~ast_context();
+
+  //! A new node; an expression gets the context as its first argument
+  //! and puts itself in the table.
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  {
+    if(std::is_trivially_destructible<T>::value)
+      return construct<T>(allocate(sizeof(T), alignof(T)),
+                          std::is_base_of<expression, T>{}, std::forward<Args>(args)...);
+    // the cleanup goes right before the node, with the same alignment
+    static_assert(alignof(T) <= alignof(cleanup), "node over-aligned");
+    auto c = static_cast<cleanup*>(allocate(sizeof(cleanup) + sizeof(T), alignof(cleanup)));
+    T* t = construct<T>(c + 1, std::is_base_of<expression, T>{}, std::forward<Args>(args)...);
+    *c = cleanup{&destroy<T>, cleanups_};
+    if(!cleanups_)
+      last_cleanup_ = c;
+    cleanups_ = c;
+    return t;
+  }
+
+  //! Uninitialized memory that lives as long as the context.
+  void* allocate(std::size_t size, std::size_t align)
+  {
+    std::size_t skip = -reinterpret_cast<std::uintptr_t>(free_) & (align - 1);
+    if(left_ < size + skip)
+      return allocate_block(size);
+    char* p = free_ + skip;
+    free_ = p + size;
+    left_ -= size + skip;
+    allocated_ += size;
+    return p;
+  }
+
+  //! Take over the nodes of other, which must not allocate any more.
+  //! Its expressions get the ids after the ones made here.
+  void adopt(ast_context& other);
+
+  //! Put a new expression in the table, after n operands; the id it
+  //! gets. Expression constructors call this.
+  expr_id add_expression(expression* e, ast_kind kind, token_type op, SourceLoc pos,
+                         expression* const* operands, std::size_t n)
+  {
+    if(exprs_.size() == exprs_.capacity() || operands_.size() + n > operands_.capacity())
+      grow_table(n);
+    auto id = static_cast<expr_id>(exprs_.size());
+    exprs_.push_back(expr_entry{kind, op, static_cast<std::uint32_t>(operands_.size())});
+    for(std::size_t i = 0; i != n; ++i)
+      operands_.push_back(id_of(operands[i]));
+    locs_.push_back(pos);
+    nodes_.push_back(e);
+    set_id(e, id);
+    return id;
+  }
+
+  //! The expressions made so far, with ids below that.
+  expr_id expressions() const { return static_cast<expr_id>(exprs_.size()); }
+  const expr_entry& entry(expr_id id) const { assert(id < exprs_.size()); return exprs_[id]; }
+  std::size_t operand_count(expr_id id) const
+  { return operands_end(id) - exprs_[id].operands; }
+  expr_id operand(expr_id id, std::size_t i) const
+  { assert(i < operand_count(id)); return operands_[exprs_[id].operands + i]; }
+  SourceLoc position_of(expr_id id) const { return locs_[id]; }
+  //! The type sema gave an expression. References into the table only
+  //! last until the next expression is made.
+  std::shared_ptr<type>& type_of(expr_id id)
+  {
+    assert(id < exprs_.size());
+    if(id >= types_.size())
+      make_types();
+    return types_[id];
+  }
+  expression* expression_at(expr_id id) const { assert(id < nodes_.size()); return nodes_[id]; }
+  //! The first id of the run of expression id and everything below it.
+  expr_id first_of(expr_id id) const;
+
+  //! The bytes handed out so far.
+  std::size_t allocated() const { return allocated_; }
+  //! The bytes the flat table takes; like allocated(), without what it
+  //! has room for.
+  std::size_t table_bytes() const;
+  //! The blocks taken from the heap so far, those the table grew into
+  //! included.
+  std::size_t blocks() const { return blocks_.size() + table_blocks_; }
+
+private:
+  static const std::size_t block_size = 64 * 1024;
+
+  // nodes that need destruction, in a list through the blocks
+  struct cleanup
+  {
+    void (*run)(void*);
+    cleanup* next;
+  };
+
+  void* allocate_block(std::size_t size);
+
+  template<typename T, typename... Args>
+  T* construct(void* p, std::true_type, Args&&... args)
+  { return new (p) T(*this, std::forward<Args>(args)...); }
+  template<typename T, typename... Args>
+  T* construct(void* p, std::false_type, Args&&... args)
+  { return new (p) T(std::forward<Args>(args)...); }
+
+  std::uint32_t operands_end(expr_id id) const
+  {
+    return id + 1 < exprs_.size() ? exprs_[id + 1].operands
+                                  : static_cast<std::uint32_t>(operands_.size());
+  }
+  void reserve_expressions(std::size_t n);
+  void grow_table(std::size_t n);
+  static expr_id id_of(const expression* e);
+  void set_id(expression* e, expr_id id);
+  void make_types();
+
+  template<typename T>
+  static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  cleanup* cleanups_ = nullptr;
+  cleanup* last_cleanup_ = nullptr;
+  // the flat table; the arrays indexed by id grow together, all but
+  // the types, which only sema makes room for
+  std::vector<expr_entry> exprs_;
+  std::vector<expr_id> operands_;
+  std::vector<SourceLoc> locs_;
+  std::vector<std::shared_ptr<type>> types_;
+  std::vector<expression*> nodes_;
+  std::size_t table_blocks_ = 0;
+  char* free_ = nullptr;
+  std::size_t left_ = 0;
+  std::size_t allocated_ = 0;
+};
+
+//! A child of a node. The context owns it, so this is a plain pointer
+//! that keeps the get() of an owning one.
+template<typename T>
+class ast_ptr
+{
+public:
+  ast_ptr(T* p = nullptr) : p_(p) {}
+
+  T* get() const { return p_; }
+  T* operator->() const { return p_; }
+  T& operator*() const { return *p_; }
+  explicit operator bool() const { return p_ != nullptr; }
+
+private:
+  T* p_;
+};
+
+//! The children of a node, in memory of the context. Growing leaves the
+//! old elements behind in the context, so T must not need destruction.
+template<typename T>
+class ast_list
+{
+public:
+  typedef const T* const_iterator;
+
+  void push_back(ast_context& c, T x)
+  {
+    if(size_ == capacity_)
+      grow(c);
+    data_[size_++] = x;
+  }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  const T& front() const { return data_[0]; }
+  const T& back() const { return data_[size_ - 1]; }
+
+private:
+  void grow(ast_context& c)
+  {
+    std::uint32_t capacity = capacity_ != 0 ? capacity_ * 2 : 4;
+    T* data = static_cast<T*>(c.allocate(capacity * sizeof(T), alignof(T)));
+    std::copy(data_, data_ + size_, data);
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  T* data_ = nullptr;
+  std::uint32_t size_ = 0;
+  std::uint32_t capacity_ = 0;
+};
+
+template<typename T>
+typename ast_list<T>::const_iterator begin(const ast_list<T>& l) { return l.begin(); }
+
+template<typename T>
+typename ast_list<T>::const_iterator end(const ast_list<T>& l) { return l.end(); }
+
+//! Operands of an expression in the table from the skip-th on, as nodes:
+//! the arguments of a call. It keeps ids, so growing the table leaves it
+//! valid.
+class expr_list
+{
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator(const expr_list* l, std::size_t i) : l_(l), i_(i) {}
+    expression* operator*() const { return (*l_)[i_]; }
+    const_iterator& operator++() { ++i_; return *this; }
+    bool operator==(const const_iterator& o) const { return i_ == o.i_; }
+    bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+  private:
+    const expr_list* l_;
+    std::size_t i_;
+  };
+
+  expr_list(const ast_context& c, expr_id id, std::size_t skip) : c_(&c), id_(id), skip_(skip) {}
+
+  const_iterator begin() const { return const_iterator{this, 0}; }
+  const_iterator end() const { return const_iterator{this, size()}; }
+  std::size_t size() const { return c_->operand_count(id_) - skip_; }
+  bool empty() const { return size() == 0; }
+  expression* operator[](std::size_t i) const
+  { return c_->expression_at(c_->operand(id_, skip_ + i)); }
+
+private:
+  const ast_context* c_;
+  expr_id id_;
+  std::size_t skip_;
+};
+
+} // c4
+#endif /* C4_AST_CONTEXT_H */
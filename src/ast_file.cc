@@ -0,0 +1,1177 @@
+#include "ast_file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "ast_context.h"
+#include "diagnostic.h"
+#include "hash.h"
+#include "input.h"
+#include "lexer.h"
+#include "source_manager.h"
+#include "type.h"
+
+#include "llvm/ADT/SmallVector.h"
+
+namespace c4 {
+
+namespace {
+
+// After the header come the name of the input with a terminating 0,
+// the text of the input, the names of the symbols, each with a
+// terminating 0, and the types, the struct members, the nodes and the
+// labels of the gotos. Those are numbers, each in as many bytes of 7
+// bits as it needs, lowest first.
+struct header
+{
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t name_size;
+  std::uint32_t source_size;
+  std::uint32_t symbols;
+  std::uint32_t symbol_bytes;
+  std::uint32_t types;
+  std::uint32_t type_bytes;
+  std::uint32_t member_bytes;
+  std::uint32_t nodes;
+  std::uint32_t node_bytes;
+  std::uint32_t label_bytes;
+  std::uint64_t checksum; // of everything after the header
+};
+
+static_assert(sizeof(header) == 56, "the AST format changed");
+
+const char magic[4] = {'C', '4', 'A', 'S'};
+
+// A type is its kind and then
+//   POINTER  the underlying type
+//   STRUCT   the tag, the members come in a section of their own
+//   FUNCTION the return type, the number of arguments and their types
+// A type is referred to by its number plus one, 0 is no type. Types
+// only refer to types before them, except for struct members: a member
+// record is the struct, the number of members and a symbol and a type
+// for each. Symbols are numbered from one as well, 0 is the empty one.
+enum class type_kind : std::uint32_t {
+  INT, CHAR, ZERO, VOID, ERROR, POINTER, STRUCT, FUNCTION
+};
+
+// A node is its kind, the difference of its location to the one of the
+// node before and then, in the order the loader reads them, its fields
+// and its children, lists with their length in front. Children come
+// before their parent and are referred to by how many nodes before it
+// they are, 0 is no child. An expression ends with its type. A location
+// is an offset into the text plus one, 0 is the invalid one. The label
+// of a goto may come after it, so the labels are pairs of the numbers
+// of a goto and its labeled_stmt after the nodes.
+
+template<typename T>
+T read(const char* p)
+{
+  T t;
+  std::memcpy(&t, p, sizeof(t));
+  return t;
+}
+
+template<typename E>
+std::uint32_t as_number(E e)
+{ return static_cast<std::uint32_t>(e); }
+
+// small differences either way in few bits
+std::uint32_t zigzag(std::uint32_t d) { return d >> 31 ? ~(d << 1) : d << 1; }
+std::uint32_t unzigzag(std::uint32_t z) { return z & 1 ? ~(z >> 1) : z >> 1; }
+
+void put(std::vector<char>& to, std::uint32_t v)
+{
+  for(; v >= 0x80; v >>= 7)
+    to.push_back(static_cast<char>(v | 0x80));
+  to.push_back(static_cast<char>(v));
+}
+
+const std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
+
+// numbers the nodes, types and symbols of a tree as it writes them
+struct writer
+{
+  writer(const lexer& l)
+    : begin(l.begin()), size(static_cast<std::uint32_t>(l.end() - l.begin())),
+      base(l.base()) {}
+
+  // write the tree of n, every node after its children, and return the
+  // number of n
+  std::uint32_t tree(ast_node* n);
+  // write the members of the structs and the labels of the gotos
+  void finish();
+
+  // add the children of n to pending, in the order node refers to them
+  // and with nullptr for the ones it doesn't have
+  void children(ast_node* n);
+  template<typename T>
+  void children(const ast_list<ast_ptr<T>>& l);
+  // write n, whose children got the numbers in c, and return its number
+  std::uint32_t node(ast_node* n, const std::uint32_t* c);
+  // start the record of n, its fields and children follow right away
+  std::uint32_t record(ast_node* n);
+  void put_child(std::uint32_t child)
+  { put(node_bytes, child == no_node ? 0 : current - child); }
+  void put_children(const std::uint32_t* c, std::size_t n);
+  std::uint32_t loc(SourceLoc l);
+  std::uint32_t sym(symbol s);
+  std::uint32_t type_ref(const std::shared_ptr<type>& t);
+  std::uint32_t add_type(type_kind k);
+
+  const char* begin;
+  std::uint32_t size;
+  SourceLoc base;
+  bool ok = true;
+
+  std::string symbol_names;
+  std::unordered_map<symbol, std::uint32_t> symbols;
+  std::unordered_map<const type*, std::uint32_t> type_refs;
+  std::vector<std::pair<struct_type*, std::uint32_t>> structs;
+  std::vector<char> type_bytes;
+  std::vector<char> member_bytes;
+  std::uint32_t types = 0;
+
+  std::unordered_map<const labeled_stmt*, std::uint32_t> labels;
+  std::vector<std::pair<std::uint32_t, labeled_stmt*>> gotos;
+  std::vector<char> node_bytes;
+  std::vector<char> label_bytes;
+  std::uint32_t nodes = 0;
+  std::uint32_t current = 0; // the node being written
+  std::uint32_t last_loc = 0;
+
+  // the nodes to write with the number of their children once those
+  // are written, and the numbers of the ones written but not referred
+  // to yet; a deep tree is no deeper on the call stack
+  struct step
+  {
+    ast_node* n;
+    std::size_t children; // to take from done, or -1 to push them first
+  };
+  std::vector<step> steps;
+  std::vector<ast_node*> pending;
+  std::vector<std::uint32_t> done;
+};
+
+const std::size_t unexpanded = static_cast<std::size_t>(-1);
+
+std::uint32_t writer::tree(ast_node* n)
+{
+  steps.push_back(step{n, unexpanded});
+  while(!steps.empty()) {
+    step s = steps.back();
+    steps.pop_back();
+    if(!s.n) {
+      done.push_back(no_node);
+    } else if(s.children == unexpanded) {
+      pending.clear();
+      children(s.n);
+      steps.push_back(step{s.n, pending.size()});
+      for(auto c = pending.rbegin(); c != pending.rend(); ++c)
+        steps.push_back(step{*c, unexpanded});
+    } else {
+      std::size_t first = done.size() - s.children;
+      std::uint32_t id = node(s.n, done.data() + first);
+      done.resize(first);
+      done.push_back(id);
+    }
+  }
+  std::uint32_t id = done.back();
+  done.pop_back();
+  return id;
+}
+
+template<typename T>
+void writer::children(const ast_list<ast_ptr<T>>& l)
+{
+  for(auto& x : l)
+    pending.push_back(x.get());
+}
+
+void writer::children(ast_node* n)
+{
+  switch(n->kind()) {
+  case ast_kind::TRANSLATION_UNIT:
+    children(static_cast<translation_unit*>(n)->decls());
+    break;
+  case ast_kind::DECLARATOR: {
+    auto d = static_cast<declarator*>(n);
+    pending.push_back(d->get_declarator());
+    children(d->parameter_decls());
+    break;
+  }
+  case ast_kind::STRUCT_SPECIFIER:
+    children(static_cast<struct_specifier*>(n)->decls());
+    break;
+  case ast_kind::PARAMETER_DECL:
+  case ast_kind::DECL:
+  case ast_kind::TYPE_NAME: {
+    auto d = static_cast<base_decl*>(n);
+    pending.push_back(d->get_type_specifier());
+    pending.push_back(d->get_declarator());
+    if(auto dd = ast_cast<decl>(n))
+      pending.push_back(dd->get_body());
+    break;
+  }
+
+  case ast_kind::COMP_STMT:
+    children(static_cast<comp_stmt*>(n)->sub_stmts());
+    break;
+  case ast_kind::RETURN_STMT:
+    pending.push_back(static_cast<return_stmt*>(n)->expr());
+    break;
+  case ast_kind::LABELED_STMT:
+    pending.push_back(static_cast<labeled_stmt*>(n)->get_stmt());
+    break;
+  case ast_kind::WHILE_STMT: {
+    auto ws = static_cast<while_stmt*>(n);
+    pending.push_back(ws->condition());
+    pending.push_back(ws->body());
+    break;
+  }
+  case ast_kind::IF_STMT: {
+    auto is = static_cast<if_stmt*>(n);
+    pending.push_back(is->condition());
+    pending.push_back(is->body());
+    break;
+  }
+  case ast_kind::IF_ELSE_STMT: {
+    auto ies = static_cast<if_else_stmt*>(n);
+    pending.push_back(ies->condition());
+    pending.push_back(ies->if_body());
+    pending.push_back(ies->else_body());
+    break;
+  }
+  case ast_kind::EXPR_STMT:
+    pending.push_back(static_cast<expr_stmt*>(n)->expr());
+    break;
+
+  case ast_kind::SIZEOF_EXPR:
+    pending.push_back(static_cast<sizeof_expr*>(n)->expr());
+    break;
+  case ast_kind::SIZEOF_TYPE:
+    pending.push_back(static_cast<sizeof_type*>(n)->get_type_name());
+    break;
+  case ast_kind::UNARY_OPERATOR:
+    pending.push_back(static_cast<unary_operator*>(n)->operand());
+    break;
+  case ast_kind::BINARY_OPERATOR: {
+    auto o = static_cast<binary_operator*>(n);
+    pending.push_back(o->left());
+    pending.push_back(o->right());
+    break;
+  }
+  case ast_kind::POSTFIX_OPERATOR: {
+    auto o = static_cast<postfix_operator*>(n);
+    pending.push_back(o->left());
+    pending.push_back(o->right());
+    break;
+  }
+  case ast_kind::SUBSCRIPT_OPERATOR: {
+    auto o = static_cast<subscript_operator*>(n);
+    pending.push_back(o->left());
+    pending.push_back(o->right());
+    break;
+  }
+  case ast_kind::FUNCTION_CALL: {
+    auto fc = static_cast<function_call*>(n);
+    pending.push_back(fc->get_name());
+    for(auto e : fc->params())
+      pending.push_back(e);
+    break;
+  }
+  case ast_kind::TERNARY_EXPR: {
+    auto te = static_cast<ternary_expr*>(n);
+    pending.push_back(te->test());
+    pending.push_back(te->true_expr());
+    pending.push_back(te->false_expr());
+    break;
+  }
+
+  case ast_kind::TYPE_SPECIFIER:
+  case ast_kind::BREAK_STMT:
+  case ast_kind::CONTINUE_STMT:
+  case ast_kind::GOTO_STMT:
+  case ast_kind::PRIMARY_EXPRESSION:
+  case ast_kind::ERROR_EXPR:
+    break;
+  }
+}
+
+void writer::put_children(const std::uint32_t* c, std::size_t n)
+{
+  put(node_bytes, static_cast<std::uint32_t>(n));
+  for(std::size_t i = 0; i < n; ++i)
+    put_child(c[i]);
+}
+
+std::uint32_t writer::record(ast_node* n)
+{
+  std::uint32_t l = loc(n->position());
+  put(node_bytes, as_number(n->kind()));
+  put(node_bytes, zigzag(l - last_loc));
+  last_loc = l;
+  return current = nodes++;
+}
+
+std::uint32_t writer::loc(SourceLoc l)
+{
+  if(!l.valid())
+    return 0;
+  if(l.offset < base.offset || l.offset - base.offset > size) {
+    ok = false;
+    return 0;
+  }
+  return l.offset - base.offset + 1;
+}
+
+std::uint32_t writer::sym(symbol s)
+{
+  if(s.empty())
+    return 0;
+  auto r = symbols.emplace(s, static_cast<std::uint32_t>(symbols.size() + 1));
+  if(r.second) {
+    auto name = s.str();
+    symbol_names.append(name.data(), name.size());
+    symbol_names += '\0';
+  }
+  return r.first->second;
+}
+
+std::uint32_t writer::add_type(type_kind k)
+{
+  put(type_bytes, as_number(k));
+  return ++types;
+}
+
+std::uint32_t writer::type_ref(const std::shared_ptr<type>& t)
+{
+  if(!t)
+    return 0;
+  auto it = type_refs.find(t.get());
+  if(it != type_refs.end())
+    return it->second;
+
+  std::uint32_t ref;
+  if(auto p = as_pointer_type(t.get())) {
+    std::uint32_t underlying = type_ref(p->underlying());
+    ref = add_type(type_kind::POINTER);
+    put(type_bytes, underlying);
+  } else if(auto f = as_function_type(t.get())) {
+    std::uint32_t ret = type_ref(f->return_type());
+    std::vector<std::uint32_t> args;
+    for(auto& a : f->arguments())
+      args.push_back(type_ref(a));
+    ref = add_type(type_kind::FUNCTION);
+    put(type_bytes, ret);
+    put(type_bytes, static_cast<std::uint32_t>(args.size()));
+    for(auto a : args)
+      put(type_bytes, a);
+  } else if(auto s = as_struct_type(t.get())) {
+    // the members may lead back here, so they are written at the end
+    ref = add_type(type_kind::STRUCT);
+    put(type_bytes, sym(s->get_tag()));
+    structs.emplace_back(s, ref);
+  } else if(t->is_arithmetic()) {
+    ref = add_type(t->is_char() ? type_kind::CHAR
+                   : t->is_zero() ? type_kind::ZERO : type_kind::INT);
+  } else if(t->is_void()) {
+    ref = add_type(type_kind::VOID);
+  } else {
+    assert(t->is_error());
+    ref = add_type(type_kind::ERROR);
+  }
+  type_refs.emplace(t.get(), ref);
+  return ref;
+}
+
+std::uint32_t writer::node(ast_node* n, const std::uint32_t* c)
+{
+  std::uint32_t id;
+  switch(n->kind()) {
+  case ast_kind::TRANSLATION_UNIT: {
+    id = record(n);
+    put_children(c, static_cast<translation_unit*>(n)->decls().size());
+    break;
+  }
+  case ast_kind::DECLARATOR: {
+    auto d = static_cast<declarator*>(n);
+    id = record(n);
+    put(node_bytes, d->pointer());
+    put_child(c[0]);
+    put(node_bytes, sym(d->get_identifier()));
+    put_children(c + 1, d->parameter_decls().size());
+    break;
+  }
+  case ast_kind::TYPE_SPECIFIER: {
+    auto ts = static_cast<type_specifier*>(n);
+    id = record(n);
+    put(node_bytes, as_number(ts->token));
+    put(node_bytes, type_ref(ts->get_type()));
+    break;
+  }
+  case ast_kind::STRUCT_SPECIFIER: {
+    auto s = static_cast<struct_specifier*>(n);
+    id = record(n);
+    put(node_bytes, as_number(s->token));
+    put(node_bytes, sym(s->get_tag()));
+    put(node_bytes, type_ref(s->get_type()));
+    put_children(c, s->decls().size());
+    break;
+  }
+  case ast_kind::PARAMETER_DECL:
+  case ast_kind::DECL:
+  case ast_kind::TYPE_NAME: {
+    auto d = static_cast<base_decl*>(n);
+    id = record(n);
+    put_child(c[0]);
+    put_child(c[1]);
+    put(node_bytes, as_number(d->get_linkage()));
+    if(ast_cast<decl>(n))
+      put_child(c[2]);
+    break;
+  }
+
+  case ast_kind::COMP_STMT: {
+    id = record(n);
+    put_children(c, static_cast<comp_stmt*>(n)->sub_stmts().size());
+    break;
+  }
+  case ast_kind::BREAK_STMT:
+  case ast_kind::CONTINUE_STMT:
+    id = record(n);
+    break;
+  case ast_kind::RETURN_STMT: {
+    auto rs = static_cast<return_stmt*>(n);
+    id = record(n);
+    put_child(c[0]);
+    put(node_bytes, type_ref(rs->exp_rtype()));
+    break;
+  }
+  case ast_kind::LABELED_STMT: {
+    auto ls = static_cast<labeled_stmt*>(n);
+    id = record(n);
+    put(node_bytes, sym(ls->get_label()));
+    put_child(c[0]);
+    labels.emplace(ls, id);
+    break;
+  }
+  case ast_kind::GOTO_STMT: {
+    auto gs = static_cast<goto_stmt*>(n);
+    id = record(n);
+    put(node_bytes, sym(gs->get_label()));
+    gotos.emplace_back(id, gs->get_labeled_stmt());
+    break;
+  }
+  case ast_kind::WHILE_STMT:
+  case ast_kind::IF_STMT:
+    id = record(n);
+    put_child(c[0]);
+    put_child(c[1]);
+    break;
+  case ast_kind::IF_ELSE_STMT:
+    id = record(n);
+    put_child(c[0]);
+    put_child(c[1]);
+    put_child(c[2]);
+    break;
+  case ast_kind::EXPR_STMT:
+    id = record(n);
+    put_child(c[0]);
+    break;
+
+  case ast_kind::PRIMARY_EXPRESSION: {
+    // the token mostly starts where the node does
+    auto& t = static_cast<primary_expression*>(n)->value();
+    std::uint32_t offset = 0;
+    if(t.start >= begin && static_cast<std::size_t>(t.start - begin) <= size)
+      offset = static_cast<std::uint32_t>(t.start - begin);
+    else
+      ok = false;
+    if(t.length > size - offset)
+      ok = false;
+    id = record(n);
+    put(node_bytes, as_number(t.type));
+    put(node_bytes, zigzag(offset + 1 - last_loc));
+    put(node_bytes, t.length);
+    put(node_bytes, sym(t.name));
+    break;
+  }
+  case ast_kind::ERROR_EXPR:
+    id = record(n);
+    break;
+  case ast_kind::SIZEOF_EXPR:
+  case ast_kind::SIZEOF_TYPE:
+    id = record(n);
+    put_child(c[0]);
+    break;
+  case ast_kind::UNARY_OPERATOR:
+    id = record(n);
+    put(node_bytes, as_number(static_cast<unary_operator*>(n)->op()));
+    put_child(c[0]);
+    break;
+  case ast_kind::BINARY_OPERATOR:
+    id = record(n);
+    put(node_bytes, as_number(static_cast<binary_operator*>(n)->op()));
+    put_child(c[0]);
+    put_child(c[1]);
+    break;
+  case ast_kind::POSTFIX_OPERATOR:
+    id = record(n);
+    put(node_bytes, as_number(static_cast<postfix_operator*>(n)->op()));
+    put_child(c[0]);
+    put_child(c[1]);
+    break;
+  case ast_kind::SUBSCRIPT_OPERATOR:
+    id = record(n);
+    put_child(c[0]);
+    put_child(c[1]);
+    break;
+  case ast_kind::FUNCTION_CALL:
+    id = record(n);
+    put_child(c[0]);
+    put_children(c + 1, static_cast<function_call*>(n)->params().size());
+    break;
+  case ast_kind::TERNARY_EXPR:
+    id = record(n);
+    put_child(c[0]);
+    put_child(c[1]);
+    put_child(c[2]);
+    break;
+  }
+
+  if(n->is_expression())
+    put(node_bytes, type_ref(static_cast<expression*>(n)->e_type()));
+  return id;
+}
+
+void writer::finish()
+{
+  // writing the members may add structs
+  for(std::size_t i = 0; i < structs.size(); ++i) {
+    auto s = structs[i];
+    std::vector<std::uint32_t> members;
+    for(auto& m : s.first->members()) {
+      members.push_back(sym(m.first));
+      members.push_back(type_ref(m.second));
+    }
+    put(member_bytes, s.second);
+    put(member_bytes, static_cast<std::uint32_t>(s.first->members().size()));
+    for(auto m : members)
+      put(member_bytes, m);
+  }
+  for(auto& g : gotos) {
+    auto it = labels.find(g.second);
+    if(it == labels.end()) {
+      ok = false;
+      continue;
+    }
+    put(label_bytes, g.first);
+    put(label_bytes, it->second);
+  }
+}
+
+// which nodes may stand where a T is expected
+bool fits(const ast_node* n, const type_specifier*)
+{
+  return n->kind() == ast_kind::TYPE_SPECIFIER
+    || n->kind() == ast_kind::STRUCT_SPECIFIER;
+}
+
+bool fits(const ast_node* n, const stmt*) { return n->is_stmt(); }
+
+bool fits(const ast_node* n, const expression*) { return n->is_expression(); }
+
+// what a comp_stmt holds
+bool fits(const ast_node* n, const ast_node*)
+{ return n->is_stmt() || n->kind() == ast_kind::DECL; }
+
+template<typename T>
+bool fits(const ast_node* n, const T*) { return n->kind() == T::node_kind; }
+
+// makes the nodes of a file; every number is checked before it becomes
+// a pointer, a damaged file only makes the loader fail
+class loader
+{
+public:
+  loader(ast_context& ctx, const char* source, std::uint32_t size, SourceLoc base)
+    : ctx_(ctx), source_(source), size_(size), base_(base) {}
+
+  bool symbols(const char* p, std::uint32_t bytes, std::uint32_t n);
+  bool types(const char* p, std::uint32_t bytes, std::uint32_t n);
+  bool members(const char* p, std::uint32_t bytes);
+  translation_unit* nodes(const char* p, std::uint32_t bytes, std::uint32_t n);
+  bool labels(const char* p, std::uint32_t bytes);
+
+private:
+  void section(const char* p, std::uint32_t bytes)
+  { p_ = p; end_ = p + bytes; }
+
+  std::uint32_t number()
+  {
+    if(p_ != end_ && !(*p_ & 0x80))
+      return static_cast<unsigned char>(*p_++);
+    return long_number();
+  }
+  std::uint32_t long_number();
+
+  // the length of a list, each element takes a byte at least
+  std::uint32_t count()
+  {
+    std::uint32_t n = number();
+    if(n > static_cast<std::size_t>(end_ - p_)) {
+      ok_ = false;
+      return 0;
+    }
+    return n;
+  }
+
+  SourceLoc loc();
+  symbol sym();
+  token_type token();
+  std::shared_ptr<type> type_ref(bool optional = false);
+  template<typename T> T* optional_child();
+  template<typename T> T* child();
+  ast_node* node();
+
+  ast_context& ctx_;
+  const char* source_;
+  std::uint32_t size_;
+  SourceLoc base_;
+  const char* p_ = nullptr;
+  const char* end_ = nullptr;
+  bool ok_ = true;
+  std::uint32_t last_loc_ = 0;
+
+  std::vector<symbol> symbols_;
+  std::vector<std::shared_ptr<type>> types_;
+  std::vector<ast_node*> nodes_;
+  std::size_t gotos_ = 0;
+};
+
+std::uint32_t loader::long_number()
+{
+  std::uint32_t v = 0;
+  for(unsigned shift = 0; shift < 32 && p_ != end_; shift += 7) {
+    auto b = static_cast<unsigned char>(*p_++);
+    if(shift == 28 && b > 0x0f)
+      break;
+    v |= std::uint32_t{b & 0x7fu} << shift;
+    if(!(b & 0x80))
+      return v;
+  }
+  ok_ = false;
+  return 0;
+}
+
+SourceLoc loader::loc()
+{
+  std::uint32_t l = last_loc_ += unzigzag(number());
+  if(l == 0)
+    return SourceLoc{};
+  if(l - 1 > size_)
+    ok_ = false;
+  return SourceLoc{base_.offset + l - 1};
+}
+
+symbol loader::sym()
+{
+  std::uint32_t s = number();
+  if(s >= symbols_.size()) {
+    ok_ = false;
+    return symbol{};
+  }
+  return symbols_[s];
+}
+
+token_type loader::token()
+{
+  std::uint32_t t = number();
+  if(t >= num_token_types)
+    ok_ = false;
+  return static_cast<token_type>(t);
+}
+
+std::shared_ptr<type> loader::type_ref(bool optional)
+{
+  std::uint32_t t = number();
+  if(t != 0 && t <= types_.size())
+    return types_[t - 1];
+  if(t != 0 || !optional)
+    ok_ = false;
+  return nullptr;
+}
+
+template<typename T>
+T* loader::optional_child()
+{
+  std::uint32_t back = number();
+  if(back == 0)
+    return nullptr;
+  if(back > nodes_.size()) {
+    ok_ = false;
+    return nullptr;
+  }
+  ast_node* n = nodes_[nodes_.size() - back];
+  if(!fits(n, static_cast<T*>(nullptr))) {
+    ok_ = false;
+    return nullptr;
+  }
+  return static_cast<T*>(n);
+}
+
+template<typename T>
+T* loader::child()
+{
+  T* n = optional_child<T>();
+  if(!n)
+    ok_ = false;
+  return n;
+}
+
+bool loader::symbols(const char* p, std::uint32_t bytes, std::uint32_t n)
+{
+  const char* end = p + bytes;
+  if(n > bytes)
+    return false;
+  symbols_.reserve(std::size_t{n} + 1);
+  symbols_.push_back(symbol{});
+  for(std::uint32_t i = 0; i < n; ++i) {
+    auto z = static_cast<const char*>(std::memchr(p, 0, static_cast<std::size_t>(end - p)));
+    if(!z)
+      return false;
+    symbols_.push_back(symbol::intern(llvm::StringRef{p, static_cast<std::size_t>(z - p)}));
+    p = z + 1;
+  }
+  return p == end;
+}
+
+bool loader::types(const char* p, std::uint32_t bytes, std::uint32_t n)
+{
+  section(p, bytes);
+  if(n > bytes)
+    return false;
+  types_.reserve(n);
+  for(std::uint32_t i = 0; i < n && ok_; ++i) {
+    std::uint32_t kind = number();
+    switch(static_cast<type_kind>(kind)) {
+    case type_kind::INT: types_.push_back(arithmetic_type::get_int()); break;
+    case type_kind::CHAR: types_.push_back(arithmetic_type::get_char()); break;
+    case type_kind::ZERO: types_.push_back(arithmetic_type::get_zero()); break;
+    case type_kind::VOID: types_.push_back(void_type::get_void()); break;
+    case type_kind::ERROR: types_.push_back(error_type::get_error()); break;
+    case type_kind::POINTER: {
+      auto underlying = type_ref();
+      types_.push_back(std::make_shared<pointer_type>(underlying));
+      break;
+    }
+    case type_kind::STRUCT: {
+      symbol tag = sym();
+      types_.push_back(std::make_shared<struct_type>(tag));
+      break;
+    }
+    case type_kind::FUNCTION: {
+      auto f = std::make_shared<function_type>(type_ref());
+      for(std::uint32_t j = 0, k = count(); j < k; ++j)
+        f->add_argument_type(type_ref());
+      types_.push_back(f);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return ok_ && p_ == end_;
+}
+
+bool loader::members(const char* p, std::uint32_t bytes)
+{
+  section(p, bytes);
+  while(ok_ && p_ != end_) {
+    auto s = as_struct_type(type_ref().get());
+    if(!s)
+      return false;
+    for(std::uint32_t i = 0, k = count(); i < k; ++i) {
+      symbol name = sym();
+      s->add_member(std::make_pair(name, type_ref()));
+    }
+  }
+  return ok_;
+}
+
+translation_unit* loader::nodes(const char* p, std::uint32_t bytes, std::uint32_t n)
+{
+  section(p, bytes);
+  // a node takes two bytes at least
+  if(n == 0 || n > bytes / 2)
+    return nullptr;
+  nodes_.reserve(n);
+  for(std::uint32_t i = 0; i < n && ok_; ++i)
+    nodes_.push_back(node());
+  if(!ok_ || p_ != end_)
+    return nullptr;
+  return ast_cast<translation_unit>(nodes_.back());
+}
+
+bool loader::labels(const char* p, std::uint32_t bytes)
+{
+  section(p, bytes);
+  std::size_t labeled = 0;
+  while(ok_ && p_ != end_) {
+    std::uint32_t g = number();
+    std::uint32_t l = number();
+    if(g >= nodes_.size() || l >= nodes_.size())
+      return false;
+    auto gs = ast_cast<goto_stmt>(nodes_[g]);
+    auto ls = ast_cast<labeled_stmt>(nodes_[l]);
+    if(!gs || !ls || gs->get_labeled_stmt())
+      return false;
+    gs->set_label(ls);
+    ++labeled;
+  }
+  // code generation needs the label of every goto
+  return ok_ && labeled == gotos_;
+}
+
+ast_node* loader::node()
+{
+  std::uint32_t kind = number();
+  SourceLoc pos = loc();
+  if(kind > as_number(ast_kind::TERNARY_EXPR)) {
+    ok_ = false;
+    return nullptr;
+  }
+
+  ast_node* n;
+  switch(static_cast<ast_kind>(kind)) {
+  case ast_kind::TRANSLATION_UNIT: {
+    auto tu = ctx_.make<translation_unit>();
+    for(std::uint32_t i = 0, k = count(); i < k; ++i)
+      tu->add_decl(ctx_, child<decl>());
+    n = tu;
+    break;
+  }
+  case ast_kind::DECLARATOR: {
+    bool pointer = number() != 0;
+    auto inner = optional_child<declarator>();
+    symbol identifier = sym();
+    if(inner && !identifier.empty())
+      ok_ = false;
+    auto d = inner ? ctx_.make<declarator>(pointer, inner)
+      : ctx_.make<declarator>(pointer, identifier);
+    for(std::uint32_t i = 0, k = count(); i < k; ++i)
+      d->add_parameter_decl(ctx_, child<parameter_decl>());
+    n = d;
+    break;
+  }
+  case ast_kind::TYPE_SPECIFIER: {
+    auto ts = ctx_.make<type_specifier>(pos, token());
+    ts->set_type(type_ref(true));
+    n = ts;
+    break;
+  }
+  case ast_kind::STRUCT_SPECIFIER: {
+    token_type t = token();
+    symbol tag = sym();
+    auto s = ctx_.make<struct_specifier>(pos, t, tag);
+    s->set_type(type_ref(true));
+    for(std::uint32_t i = 0, k = count(); i < k; ++i)
+      s->add_decl(ctx_, child<decl>());
+    n = s;
+    break;
+  }
+  case ast_kind::PARAMETER_DECL:
+  case ast_kind::DECL:
+  case ast_kind::TYPE_NAME: {
+    auto ts = child<type_specifier>();
+    auto dl = optional_child<declarator>();
+    std::uint32_t l = number();
+    if(l > as_number(linkage::NONE))
+      ok_ = false;
+    base_decl* d;
+    if(kind == as_number(ast_kind::PARAMETER_DECL)) {
+      d = ctx_.make<parameter_decl>(pos, ts, dl);
+    } else if(kind == as_number(ast_kind::TYPE_NAME)) {
+      d = ctx_.make<type_name>(pos, ts, dl);
+    } else {
+      auto dd = ctx_.make<decl>(pos, ts, dl);
+      if(auto body = optional_child<comp_stmt>())
+        dd->set_body(body);
+      d = dd;
+    }
+    d->set_linkage(static_cast<linkage>(l));
+    n = d;
+    break;
+  }
+
+  case ast_kind::COMP_STMT: {
+    auto cs = ctx_.make<comp_stmt>();
+    for(std::uint32_t i = 0, k = count(); i < k; ++i)
+      cs->add_stmt(ctx_, child<ast_node>());
+    n = cs;
+    break;
+  }
+  case ast_kind::BREAK_STMT:
+    n = ctx_.make<break_stmt>(pos);
+    break;
+  case ast_kind::CONTINUE_STMT:
+    n = ctx_.make<continue_stmt>(pos);
+    break;
+  case ast_kind::RETURN_STMT: {
+    auto e = optional_child<expression>();
+    auto rs = e ? ctx_.make<return_stmt>(e, pos) : ctx_.make<return_stmt>(pos);
+    rs->exp_rtype() = type_ref(true);
+    n = rs;
+    break;
+  }
+  case ast_kind::LABELED_STMT: {
+    symbol label = sym();
+    auto s = child<stmt>();
+    n = ctx_.make<labeled_stmt>(label, s, pos);
+    break;
+  }
+  case ast_kind::GOTO_STMT:
+    n = ctx_.make<goto_stmt>(sym(), pos);
+    ++gotos_;
+    break;
+  case ast_kind::WHILE_STMT: {
+    auto cond = child<expression>();
+    auto body = child<stmt>();
+    n = ctx_.make<while_stmt>(cond, body, pos);
+    break;
+  }
+  case ast_kind::IF_STMT: {
+    auto cond = child<expression>();
+    auto body = child<stmt>();
+    n = ctx_.make<if_stmt>(cond, body, pos);
+    break;
+  }
+  case ast_kind::IF_ELSE_STMT: {
+    auto cond = child<expression>();
+    auto if_body = child<stmt>();
+    auto else_body = child<stmt>();
+    n = ctx_.make<if_else_stmt>(cond, if_body, else_body, pos);
+    break;
+  }
+  case ast_kind::EXPR_STMT:
+    n = ctx_.make<expr_stmt>(optional_child<expression>());
+    break;
+
+  case ast_kind::PRIMARY_EXPRESSION: {
+    token_type t = token();
+    std::uint32_t offset = last_loc_ + unzigzag(number()) - 1;
+    std::uint32_t length = number();
+    symbol name = sym();
+    if(offset > size_ || length > size_ - offset || length > max_token_length) {
+      ok_ = false;
+      offset = length = 0;
+    }
+    c4::token val{t, llvm::StringRef{source_ + offset, length}};
+    val.name = name;
+    n = ctx_.make<primary_expression>(val, pos);
+    break;
+  }
+  case ast_kind::ERROR_EXPR:
+    n = ctx_.make<error_expr>(pos);
+    break;
+  case ast_kind::SIZEOF_EXPR: {
+    auto expr = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<sizeof_expr>(expr, pos);
+    break;
+  }
+  case ast_kind::SIZEOF_TYPE:
+    n = ctx_.make<sizeof_type>(child<type_name>(), pos);
+    break;
+  case ast_kind::UNARY_OPERATOR: {
+    token_type op = token();
+    auto operand = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<unary_operator>(op, operand, pos);
+    break;
+  }
+  case ast_kind::BINARY_OPERATOR: {
+    token_type op = token();
+    auto left = child<expression>();
+    auto right = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<binary_operator>(op, left, right, pos);
+    break;
+  }
+  case ast_kind::POSTFIX_OPERATOR: {
+    token_type op = token();
+    auto left = child<expression>();
+    auto right = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<postfix_operator>(op, left, right, pos);
+    break;
+  }
+  case ast_kind::SUBSCRIPT_OPERATOR: {
+    auto left = child<expression>();
+    auto right = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<subscript_operator>(left, right, pos);
+    break;
+  }
+  case ast_kind::FUNCTION_CALL: {
+    // the operands are made already, the called one first
+    llvm::SmallVector<expression*, 8> operands{child<expression>()};
+    for(std::uint32_t i = 0, k = count(); i < k && ok_; ++i)
+      operands.push_back(child<expression>());
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<function_call>(operands.data(), operands.size(), pos);
+    break;
+  }
+  case ast_kind::TERNARY_EXPR: {
+    auto test = child<expression>();
+    auto true_expr = child<expression>();
+    auto false_expr = child<expression>();
+    if(!ok_)
+      return nullptr;
+    n = ctx_.make<ternary_expr>(test, true_expr, false_expr, pos);
+    break;
+  }
+  }
+
+  if(n->is_expression())
+    static_cast<expression*>(n)->e_type() = type_ref(true);
+  return n;
+}
+
+template<typename T>
+void append(std::vector<char>& data, const T* p, std::size_t n)
+{
+  auto bytes = reinterpret_cast<const char*>(p);
+  data.insert(data.end(), bytes, bytes + n);
+}
+
+}
+
+bool write_ast(const char* path, translation_unit* tu, const lexer& l,
+               const char* name)
+{
+  writer w{l};
+  w.tree(tu);
+  w.finish();
+  const std::uint32_t max = std::numeric_limits<std::uint32_t>::max();
+  std::size_t name_size = std::strlen(name) + 1;
+  if(!w.ok || name_size > max || w.symbol_names.size() > max || w.type_bytes.size() > max
+     || w.member_bytes.size() > max || w.node_bytes.size() > max
+     || w.label_bytes.size() > max) {
+    errorf(Pos{path}, "the tree of '%s' can't be saved", name);
+    return false;
+  }
+
+  header h;
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = ast_format_version;
+  h.name_size = static_cast<std::uint32_t>(name_size);
+  h.source_size = w.size;
+  h.symbols = static_cast<std::uint32_t>(w.symbols.size());
+  h.symbol_bytes = static_cast<std::uint32_t>(w.symbol_names.size());
+  h.types = w.types;
+  h.type_bytes = static_cast<std::uint32_t>(w.type_bytes.size());
+  h.member_bytes = static_cast<std::uint32_t>(w.member_bytes.size());
+  h.nodes = w.nodes;
+  h.node_bytes = static_cast<std::uint32_t>(w.node_bytes.size());
+  h.label_bytes = static_cast<std::uint32_t>(w.label_bytes.size());
+
+  std::vector<char> data(sizeof(header));
+  data.reserve(sizeof(header) + name_size + w.size + w.symbol_names.size()
+               + w.type_bytes.size() + w.member_bytes.size() + w.node_bytes.size()
+               + w.label_bytes.size());
+  append(data, name, name_size);
+  append(data, w.begin, w.size);
+  append(data, w.symbol_names.data(), w.symbol_names.size());
+  append(data, w.type_bytes.data(), w.type_bytes.size());
+  append(data, w.member_bytes.data(), w.member_bytes.size());
+  append(data, w.node_bytes.data(), w.node_bytes.size());
+  append(data, w.label_bytes.data(), w.label_bytes.size());
+  h.checksum = content_hash(data.data() + sizeof(header), data.data() + data.size());
+  std::memcpy(data.data(), &h, sizeof(h));
+
+  // write a temporary and rename it, so nobody maps half a file
+  std::string tmp = std::string{path} + ".XXXXXX";
+  int fd = mkstemp(&tmp[0]);
+  if(fd == -1) {
+    errorErrno(Pos{path});
+    return false;
+  }
+  mode_t mask = ::umask(0);
+  ::umask(mask);
+  std::FILE* f = ::fdopen(fd, "wb");
+  bool ok = f && ::fchmod(fd, 0666 & ~mask) == 0
+    && std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  ok = (f ? std::fclose(f) == 0 : ::close(fd) == 0) && ok;
+  if(!ok || std::rename(tmp.c_str(), path) != 0) {
+    int error = errno;
+    ::unlink(tmp.c_str());
+    errno = error;
+    errorErrno(Pos{path});
+    return false;
+  }
+  return true;
+}
+
+loaded_ast read_ast(const input& file, ast_context& ctx)
+{
+  auto damaged = [&file] {
+    errorf(Pos{file.name()}, "not an AST file of this version, or a damaged one");
+    return loaded_ast{nullptr, nullptr};
+  };
+
+  const char* p = file.begin();
+  std::size_t length = static_cast<std::size_t>(file.end() - p);
+  if(length < sizeof(header))
+    return damaged();
+  auto h = read<header>(p);
+  if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != ast_format_version
+     || h.name_size == 0
+     || length != sizeof(header) + std::uint64_t{h.name_size} + h.source_size
+                  + h.symbol_bytes + h.type_bytes + h.member_bytes + h.node_bytes
+                  + h.label_bytes
+     || content_hash(p + sizeof(header), file.end()) != h.checksum)
+    return damaged();
+
+  const char* name = p + sizeof(header);
+  const char* source = name + h.name_size;
+  const char* symbols = source + h.source_size;
+  const char* types = symbols + h.symbol_bytes;
+  const char* members = types + h.type_bytes;
+  const char* nodes = members + h.member_bytes;
+  const char* labels = nodes + h.node_bytes;
+  if(name[h.name_size - 1] != '\0')
+    return damaged();
+
+  // the locations of the nodes are offsets into the text, which becomes
+  // a buffer of its own, just like when it was lexed
+  SourceLoc base = source_manager::get().add_buffer(name, source, source + h.source_size);
+  loader ld{ctx, source, h.source_size, base};
+  translation_unit* tu = nullptr;
+  if(ld.symbols(symbols, h.symbol_bytes, h.symbols)
+     && ld.types(types, h.type_bytes, h.types)
+     && ld.members(members, h.member_bytes))
+    tu = ld.nodes(nodes, h.node_bytes, h.nodes);
+  if(!tu || !ld.labels(labels, h.label_bytes))
+    return damaged();
+  return loaded_ast{name, tu};
+}
+
+} // c4
@@ -0,0 +1,46 @@
+#ifndef C4_AST_FILE_H
+#define C4_AST_FILE_H
+
+#include <cstdint>
+
+namespace c4 {
+
+class ast_context;
+class input;
+class lexer;
+struct translation_unit;
+
+//! Saved translation units. A file holds a tree after sema with the
+//! types sema resolved, so code generation can start from it without
+//! lexing, parsing or checking the input again. It is a header, the
+//! name and the text of the input, the symbols and then the types and
+//! the nodes as numbers of 7 bit groups. Nodes come children first and
+//! refer to their children by how far back those are, and locations
+//! are kept as the difference to the one before, so most numbers take
+//! a byte. Tokens point into the text, which is used straight from the
+//! mapping of the file when it is read back.
+
+//! Bump this whenever the records, the node kinds or the token types
+//! change.
+const std::uint32_t ast_format_version = 2;
+
+//! Write tu, which was parsed from l and has been through sema, to
+//! path; name is the name of the input. Reports an error if the file
+//! can't be written.
+bool write_ast(const char* path, translation_unit* tu, const lexer& l,
+               const char* name);
+
+//! A translation unit read back by read_ast, and the name of its input.
+//! Both point into the file, which must outlive them.
+struct loaded_ast
+{
+  const char* name;
+  translation_unit* tu;
+};
+
+//! Make the nodes saved in file in ctx. Reports an error and returns a
+//! null tu if it is no AST file of this version or it is damaged.
+loaded_ast read_ast(const input& file, ast_context& ctx);
+
+} // c4
+#endif /* C4_AST_FILE_H */
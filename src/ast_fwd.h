@@ -36,6 +36,7 @@ struct postfix_operator;
 struct subscript_operator;
 struct function_call;
 struct ternary_expr;
+struct error_expr;
 
 } // c4
 #endif /* C4_AST_FWD_H */
@@ -1,79 +1,369 @@
 #ifndef C4_AST_VISITOR_H
 #define C4_AST_VISITOR_H
 
-#include "ast_fwd.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ast.h"
 
 namespace c4 {
 
+//! Walks the tree and calls Derived::handle for every node; the children
+//! of a node are only visited if handle returns true, and then
+//! Derived::leave is called for the node after them. Statements,
+//! operators and calls that have something between their parts, a
+//! condition and a body, two operands or two arguments, get
+//! Derived::between(n, i) after their i-th child. Derived hides the
+//! handles, leaves and betweens it wants with its own and brings the
+//! others in with using ast_visitor<Derived>::handle, ::leave and
+//! ::between. Everything is resolved at compile time, the only dispatch
+//! is the switch over the kind of a node.
+//! The nodes still to visit are kept on a stack of their own, not on
+//! the call stack, so a tree of any depth can be walked. A visitor that
+//! visits children from its handles, to print them in order or to
+//! check them before their parent, recurses once per level again; one
+//! that works on the way down in handle, in between the children and on
+//! the way back up in leave does not.
+template<typename Derived>
 struct ast_visitor {
-  void visit(ast_node*);
-
-  void visit(translation_unit*);
-  void visit(declarator*); 
-  void visit(parameter_decl*);
-  void visit(decl*);
-  void visit(type_specifier*);
-  void visit(type_name*);
-  void visit(struct_specifier*);
-
-  void visit(stmt*);
-  void visit(comp_stmt*);
-  void visit(break_stmt*);
-  void visit(continue_stmt*);
-  void visit(return_stmt*);
-  void visit(labeled_stmt*);
-  void visit(goto_stmt*);
-  void visit(while_stmt*);
-  void visit(if_stmt*);
-  void visit(if_else_stmt*);
-  void visit(expr_stmt*);
-
-  void visit(expression*);
-  void visit(primary_expression*);
-  void visit(sizeof_expr*);
-  void visit(sizeof_type*);
-  void visit(unary_operator*);
-  void visit(binary_operator*);
-  void visit(postfix_operator*);
-  void visit(subscript_operator*);
-  void visit(function_call*);
-  void visit(ternary_expr*);
-
-
-  virtual bool handle(translation_unit*) { return true; }
-  virtual bool handle(declarator*) { return true; }
-  virtual bool handle(parameter_decl*) { return true; }
-  virtual bool handle(decl*) { return true; }
-  virtual bool handle(type_specifier*) { return true; }
-  virtual bool handle(type_name*) { return true; }
-  virtual bool handle(struct_specifier*) { return true; }
-
-  virtual bool handle(stmt*) { return true; }
-  virtual bool handle(comp_stmt*) { return true; }
-  virtual bool handle(break_stmt*) { return true; }
-  virtual bool handle(continue_stmt*) { return true; }
-  virtual bool handle(return_stmt*) { return true; }
-  virtual bool handle(labeled_stmt*) { return true; }
-  virtual bool handle(goto_stmt*) { return true; }
-  virtual bool handle(while_stmt*) { return true; }
-  virtual bool handle(if_stmt*) { return true; }
-  virtual bool handle(if_else_stmt*) { return true; }
-  virtual bool handle(expr_stmt*) { return true; }
-
-  virtual bool handle(expression*) { return true; }
-  virtual bool handle(primary_expression*) { return true; }
-  virtual bool handle(sizeof_expr*) { return true; }
-  virtual bool handle(sizeof_type*) { return true; }
-  virtual bool handle(unary_operator*) { return true; } 
-  virtual bool handle(binary_operator*) { return true; }
-  virtual bool handle(postfix_operator*) { return true; }
-  virtual bool handle(subscript_operator*) { return true; }
-  virtual bool handle(function_call*) { return true; }
-  virtual bool handle(ternary_expr*) { return true; }
-
-  virtual ~ast_visitor() {}
+  //! Visit n and, as far as the handles let it, what is below it. A
+  //! handle may visit nodes itself, that walk ends before it returns.
+  void visit(ast_node* n);
+
+  bool handle(translation_unit*) { return true; }
+  bool handle(declarator*) { return true; }
+  bool handle(parameter_decl*) { return true; }
+  bool handle(decl*) { return true; }
+  bool handle(type_specifier*) { return true; }
+  bool handle(type_name*) { return true; }
+  bool handle(struct_specifier*) { return true; }
+
+  bool handle(comp_stmt*) { return true; }
+  bool handle(break_stmt*) { return true; }
+  bool handle(continue_stmt*) { return true; }
+  bool handle(return_stmt*) { return true; }
+  bool handle(labeled_stmt*) { return true; }
+  bool handle(goto_stmt*) { return true; }
+  bool handle(while_stmt*) { return true; }
+  bool handle(if_stmt*) { return true; }
+  bool handle(if_else_stmt*) { return true; }
+  bool handle(expr_stmt*) { return true; }
+
+  bool handle(primary_expression*) { return true; }
+  bool handle(sizeof_expr*) { return true; }
+  bool handle(sizeof_type*) { return true; }
+  bool handle(unary_operator*) { return true; }
+  bool handle(binary_operator*) { return true; }
+  bool handle(postfix_operator*) { return true; }
+  bool handle(subscript_operator*) { return true; }
+  bool handle(function_call*) { return true; }
+  bool handle(ternary_expr*) { return true; }
+  bool handle(error_expr*) { return true; }
+
+  template<typename T>
+  void leave(T*) {}
+  template<typename T>
+  void between(T*, std::size_t) {}
+
+protected:
+  ~ast_visitor() = default;
+
+private:
+  Derived& derived() { return static_cast<Derived&>(*this); }
+
+  enum entry : std::uintptr_t { VISIT, LEAVE, BETWEEN, MASK = 3 };
+
+  bool enter(ast_node*);
+  void exit(ast_node*);
+  void next(ast_node*, std::size_t);
+  void push(ast_node* n) { stack_.push_back(reinterpret_cast<std::uintptr_t>(n)); }
+  void push_between(ast_node* n, std::size_t i);
+  template<typename T>
+  void push(const ast_list<ast_ptr<T>>& l, ast_node* parent = nullptr);
+  void push(const expr_list& l, ast_node* parent);
+  void push_children(ast_node*);
+
+  // the nodes to visit, and with the low bits set, the ones to leave or
+  // to go on with after a child, whose index is the entry below; a
+  // visit from a handle works on top of the entries of the outer one
+  std::vector<std::uintptr_t> stack_;
 };
 
+template<typename D>
+void ast_visitor<D>::visit(ast_node* n) {
+  static_assert(alignof(ast_node) > MASK, "the low bits of a node are taken");
+  std::size_t base = stack_.size();
+  push(n);
+  while(stack_.size() != base) {
+    std::uintptr_t top = stack_.back();
+    stack_.pop_back();
+    n = reinterpret_cast<ast_node*>(top & ~std::uintptr_t{MASK});
+    switch(top & MASK) {
+    case VISIT:
+      if(enter(n)) {
+        stack_.push_back(top | LEAVE);
+        push_children(n);
+      }
+      break;
+    case LEAVE:
+      exit(n);
+      break;
+    default: {
+      std::size_t i = stack_.back();
+      stack_.pop_back();
+      next(n, i);
+    }
+    }
+  }
+}
+
+template<typename D>
+bool ast_visitor<D>::enter(ast_node* n) {
+  switch(n->kind()) {
+  case ast_kind::TRANSLATION_UNIT: return derived().handle(static_cast<translation_unit*>(n));
+  case ast_kind::DECLARATOR: return derived().handle(static_cast<declarator*>(n));
+  case ast_kind::TYPE_SPECIFIER: return derived().handle(static_cast<type_specifier*>(n));
+  case ast_kind::STRUCT_SPECIFIER: return derived().handle(static_cast<struct_specifier*>(n));
+  case ast_kind::PARAMETER_DECL: return derived().handle(static_cast<parameter_decl*>(n));
+  case ast_kind::DECL: return derived().handle(static_cast<decl*>(n));
+  case ast_kind::TYPE_NAME: return derived().handle(static_cast<type_name*>(n));
+
+  case ast_kind::COMP_STMT: return derived().handle(static_cast<comp_stmt*>(n));
+  case ast_kind::BREAK_STMT: return derived().handle(static_cast<break_stmt*>(n));
+  case ast_kind::CONTINUE_STMT: return derived().handle(static_cast<continue_stmt*>(n));
+  case ast_kind::RETURN_STMT: return derived().handle(static_cast<return_stmt*>(n));
+  case ast_kind::LABELED_STMT: return derived().handle(static_cast<labeled_stmt*>(n));
+  case ast_kind::GOTO_STMT: return derived().handle(static_cast<goto_stmt*>(n));
+  case ast_kind::WHILE_STMT: return derived().handle(static_cast<while_stmt*>(n));
+  case ast_kind::IF_STMT: return derived().handle(static_cast<if_stmt*>(n));
+  case ast_kind::IF_ELSE_STMT: return derived().handle(static_cast<if_else_stmt*>(n));
+  case ast_kind::EXPR_STMT: return derived().handle(static_cast<expr_stmt*>(n));
+
+  case ast_kind::PRIMARY_EXPRESSION: return derived().handle(static_cast<primary_expression*>(n));
+  case ast_kind::ERROR_EXPR: return derived().handle(static_cast<error_expr*>(n));
+  case ast_kind::SIZEOF_EXPR: return derived().handle(static_cast<sizeof_expr*>(n));
+  case ast_kind::SIZEOF_TYPE: return derived().handle(static_cast<sizeof_type*>(n));
+  case ast_kind::UNARY_OPERATOR: return derived().handle(static_cast<unary_operator*>(n));
+  case ast_kind::BINARY_OPERATOR: return derived().handle(static_cast<binary_operator*>(n));
+  case ast_kind::POSTFIX_OPERATOR: return derived().handle(static_cast<postfix_operator*>(n));
+  case ast_kind::SUBSCRIPT_OPERATOR: return derived().handle(static_cast<subscript_operator*>(n));
+  case ast_kind::FUNCTION_CALL: return derived().handle(static_cast<function_call*>(n));
+  case ast_kind::TERNARY_EXPR: return derived().handle(static_cast<ternary_expr*>(n));
+  }
+  return false;
+}
+
+template<typename D>
+void ast_visitor<D>::exit(ast_node* n) {
+  switch(n->kind()) {
+  case ast_kind::TRANSLATION_UNIT: derived().leave(static_cast<translation_unit*>(n)); break;
+  case ast_kind::DECLARATOR: derived().leave(static_cast<declarator*>(n)); break;
+  case ast_kind::TYPE_SPECIFIER: derived().leave(static_cast<type_specifier*>(n)); break;
+  case ast_kind::STRUCT_SPECIFIER: derived().leave(static_cast<struct_specifier*>(n)); break;
+  case ast_kind::PARAMETER_DECL: derived().leave(static_cast<parameter_decl*>(n)); break;
+  case ast_kind::DECL: derived().leave(static_cast<decl*>(n)); break;
+  case ast_kind::TYPE_NAME: derived().leave(static_cast<type_name*>(n)); break;
+
+  case ast_kind::COMP_STMT: derived().leave(static_cast<comp_stmt*>(n)); break;
+  case ast_kind::BREAK_STMT: derived().leave(static_cast<break_stmt*>(n)); break;
+  case ast_kind::CONTINUE_STMT: derived().leave(static_cast<continue_stmt*>(n)); break;
+  case ast_kind::RETURN_STMT: derived().leave(static_cast<return_stmt*>(n)); break;
+  case ast_kind::LABELED_STMT: derived().leave(static_cast<labeled_stmt*>(n)); break;
+  case ast_kind::GOTO_STMT: derived().leave(static_cast<goto_stmt*>(n)); break;
+  case ast_kind::WHILE_STMT: derived().leave(static_cast<while_stmt*>(n)); break;
+  case ast_kind::IF_STMT: derived().leave(static_cast<if_stmt*>(n)); break;
+  case ast_kind::IF_ELSE_STMT: derived().leave(static_cast<if_else_stmt*>(n)); break;
+  case ast_kind::EXPR_STMT: derived().leave(static_cast<expr_stmt*>(n)); break;
+
+  case ast_kind::PRIMARY_EXPRESSION: derived().leave(static_cast<primary_expression*>(n)); break;
+  case ast_kind::ERROR_EXPR: derived().leave(static_cast<error_expr*>(n)); break;
+  case ast_kind::SIZEOF_EXPR: derived().leave(static_cast<sizeof_expr*>(n)); break;
+  case ast_kind::SIZEOF_TYPE: derived().leave(static_cast<sizeof_type*>(n)); break;
+  case ast_kind::UNARY_OPERATOR: derived().leave(static_cast<unary_operator*>(n)); break;
+  case ast_kind::BINARY_OPERATOR: derived().leave(static_cast<binary_operator*>(n)); break;
+  case ast_kind::POSTFIX_OPERATOR: derived().leave(static_cast<postfix_operator*>(n)); break;
+  case ast_kind::SUBSCRIPT_OPERATOR: derived().leave(static_cast<subscript_operator*>(n)); break;
+  case ast_kind::FUNCTION_CALL: derived().leave(static_cast<function_call*>(n)); break;
+  case ast_kind::TERNARY_EXPR: derived().leave(static_cast<ternary_expr*>(n)); break;
+  }
+}
+
+template<typename D>
+void ast_visitor<D>::next(ast_node* n, std::size_t i) {
+  switch(n->kind()) {
+  case ast_kind::WHILE_STMT: derived().between(static_cast<while_stmt*>(n), i); break;
+  case ast_kind::IF_STMT: derived().between(static_cast<if_stmt*>(n), i); break;
+  case ast_kind::IF_ELSE_STMT: derived().between(static_cast<if_else_stmt*>(n), i); break;
+  case ast_kind::BINARY_OPERATOR: derived().between(static_cast<binary_operator*>(n), i); break;
+  case ast_kind::SUBSCRIPT_OPERATOR: derived().between(static_cast<subscript_operator*>(n), i); break;
+  case ast_kind::FUNCTION_CALL: derived().between(static_cast<function_call*>(n), i); break;
+  case ast_kind::TERNARY_EXPR: derived().between(static_cast<ternary_expr*>(n), i); break;
+  default: break;
+  }
+}
+
+template<typename D>
+void ast_visitor<D>::push_between(ast_node* n, std::size_t i) {
+  stack_.push_back(i);
+  stack_.push_back(reinterpret_cast<std::uintptr_t>(n) | BETWEEN);
+}
+
+// with a parent, between is called for it after every element but the
+// last
+template<typename D>
+template<typename T>
+void ast_visitor<D>::push(const ast_list<ast_ptr<T>>& l, ast_node* parent) {
+  for(std::size_t i = l.size(); i-- != 0;) {
+    push(l[i].get());
+    if(parent && i != 0)
+      push_between(parent, i - 1);
+  }
+}
+
+template<typename D>
+void ast_visitor<D>::push(const expr_list& l, ast_node* parent) {
+  for(std::size_t i = l.size(); i-- != 0;) {
+    push(l[i]);
+    if(i != 0)
+      push_between(parent, i - 1);
+  }
+}
+
+// the children are pushed last first, so they come off in order
+template<typename D>
+void ast_visitor<D>::push_children(ast_node* n) {
+  switch(n->kind()) {
+  /////////// DECLARATIONS //////////
+  case ast_kind::TRANSLATION_UNIT:
+    push(static_cast<translation_unit*>(n)->decls());
+    break;
+  case ast_kind::DECLARATOR:
+    if(auto inner = static_cast<declarator*>(n)->get_declarator())
+      push(inner);
+    break;
+  case ast_kind::STRUCT_SPECIFIER:
+    push(static_cast<struct_specifier*>(n)->decls());
+    break;
+  case ast_kind::PARAMETER_DECL: {
+    auto pd = static_cast<parameter_decl*>(n);
+    if(pd->get_declarator())
+      push(pd->get_declarator());
+    if(pd->get_type_specifier())
+      push(pd->get_type_specifier());
+    break;
+  }
+  case ast_kind::DECL: {
+    auto d = static_cast<decl*>(n);
+    if(d->has_body())
+      push(d->get_body());
+    if(d->get_declarator())
+      push(d->get_declarator());
+    push(d->get_type_specifier());
+    break;
+  }
+  case ast_kind::TYPE_NAME: {
+    auto tn = static_cast<type_name*>(n);
+    if(auto ad = tn->get_declarator())
+      if(ad->pointer() || ad->get_declarator())
+        push(ad);
+    push(tn->get_type_specifier());
+    break;
+  }
+
+  ////////// STATEMENTS //////////
+  case ast_kind::COMP_STMT:
+    push(static_cast<comp_stmt*>(n)->sub_stmts());
+    break;
+  case ast_kind::RETURN_STMT:
+    if(auto expr = static_cast<return_stmt*>(n)->expr())
+      push(expr);
+    break;
+  case ast_kind::LABELED_STMT:
+    push(static_cast<labeled_stmt*>(n)->get_stmt());
+    break;
+  case ast_kind::WHILE_STMT: {
+    auto ws = static_cast<while_stmt*>(n);
+    push(ws->body());
+    push_between(n, 0);
+    push(ws->condition());
+    break;
+  }
+  case ast_kind::IF_STMT: {
+    auto is = static_cast<if_stmt*>(n);
+    push(is->body());
+    push_between(n, 0);
+    push(is->condition());
+    break;
+  }
+  case ast_kind::IF_ELSE_STMT: {
+    auto ies = static_cast<if_else_stmt*>(n);
+    push(ies->else_body());
+    push_between(n, 1);
+    push(ies->if_body());
+    push_between(n, 0);
+    push(ies->condition());
+    break;
+  }
+  case ast_kind::EXPR_STMT:
+    if(auto expr = static_cast<expr_stmt*>(n)->expr())
+      push(expr);
+    break;
+
+  ////////// EXPRESSIONS //////////
+  case ast_kind::SIZEOF_EXPR:
+    push(static_cast<sizeof_expr*>(n)->expr());
+    break;
+  case ast_kind::SIZEOF_TYPE:
+    push(static_cast<sizeof_type*>(n)->get_type_name());
+    break;
+  case ast_kind::UNARY_OPERATOR:
+    push(static_cast<unary_operator*>(n)->operand());
+    break;
+  case ast_kind::BINARY_OPERATOR: {
+    auto o = static_cast<binary_operator*>(n);
+    push(o->right());
+    push_between(n, 0);
+    push(o->left());
+    break;
+  }
+  case ast_kind::POSTFIX_OPERATOR:
+    // the member after . or -> is no expression of its own, a visitor
+    // that wants it takes it from the operator
+    push(static_cast<postfix_operator*>(n)->left());
+    break;
+  case ast_kind::SUBSCRIPT_OPERATOR: {
+    auto o = static_cast<subscript_operator*>(n);
+    push(o->right());
+    push_between(n, 0);
+    push(o->left());
+    break;
+  }
+  case ast_kind::FUNCTION_CALL:
+    // the name is left to the handles, it comes before the parentheses
+    push(static_cast<function_call*>(n)->params(), n);
+    break;
+  case ast_kind::TERNARY_EXPR: {
+    auto te = static_cast<ternary_expr*>(n);
+    push(te->false_expr());
+    push_between(n, 1);
+    push(te->true_expr());
+    push_between(n, 0);
+    push(te->test());
+    break;
+  }
+
+  // no children
+  case ast_kind::TYPE_SPECIFIER:
+  case ast_kind::BREAK_STMT:
+  case ast_kind::CONTINUE_STMT:
+  case ast_kind::GOTO_STMT:
+  case ast_kind::PRIMARY_EXPRESSION:
+  case ast_kind::ERROR_EXPR:
+    break;
+  }
+}
+
 } // c4
 
 #endif /* C4_AST_VISITOR_H */
@@ -11,7 +11,7 @@ namespace c4 {
 bool compile(ast_node* ast, llvm::Module& m,
              llvm::LLVMContext& ctx) {
   llvm::IRBuilder<> builder(ctx), alloca_builder(ctx);
-  auto tu = dynamic_cast<translation_unit*>(ast);
+  auto tu = ast_cast<translation_unit>(ast);
 
   for(auto& d : tu->decls()) {
     d->gen_code(m, builder, alloca_builder, nullptr);
@@ -1,8 +1,6 @@
 #include "decl_parser.h"
 #include "ast.h"
 
-#include <vector>
-#include <memory>
 
 namespace c4 {
 
@@ -17,7 +15,7 @@ type_specifier* decl_parser::match_type_specifier() {
      || t().first.type == token_type::KWD_UNION) {
     return match_struct();
   } else {
-    auto x = new type_specifier(t().second, t().first.type);
+    auto x = make<type_specifier>(t().second, t().first.type);
     consume();
     return x;
   }
@@ -25,36 +23,43 @@ type_specifier* decl_parser::match_type_specifier() {
 
 void decl_parser::match_struct_declaration_list(struct_specifier* s) {
   while(!possibly(token_type::PCTR_RBRACE) && !possibly(token_type::T_EOF)) {
-    std::unique_ptr<decl> member{(*this)()};
+    decl* member = (*this)();
+    if(!member->get_type_specifier()) {
+      // reported already, just step over the ';' that ends it
+      if(possibly(token_type::PCTR_SEMICOLON))
+        consume();
+      continue;
+    }
     if(member->get_declarator() || 
-       dynamic_cast<struct_specifier*>(member->get_type_specifier()))
-      s->add_decl(member.release());
-    expect(token_type::PCTR_SEMICOLON);
+       ast_cast<struct_specifier>(member->get_type_specifier()))
+      s->add_decl(*get_context(), member);
+    if(!expect(token_type::PCTR_SEMICOLON))
+      synchronize(SYNC_DECL);
   }
 }
 
 decl* decl_parser::operator()() {
-  Pos p = t().second;
-  std::unique_ptr<type_specifier> ts{match_type_specifier()};
-  std::unique_ptr<declarator> dl {match_declarator()};
-  if(ts == nullptr && dl == nullptr) { // todo should this still be here?
-    // neither of the parsers consumed input, consume it ourselves
-    consume();
-  }
-  if(!dl && !dynamic_cast<struct_specifier*>(ts.get()))
+  SourceLoc p = t().second;
+  type_specifier* ts = match_type_specifier();
+  declarator* dl = match_declarator();
+  if(ts == nullptr && dl == nullptr) {
+    // nothing of a declaration here, skip what is left of it
+    synchronize(SYNC_DECL);
+  } else if(!dl && !ast_cast<struct_specifier>(ts)) {
     errorf(p, "declaration with empty declarator");
-  return new decl{p, ts.release(), dl.release()};
+  }
+  return make<decl>(p, ts, dl);
 }
 
 struct_specifier* decl_parser::match_struct() {
   assert(possibly(token_type::KWD_STRUCT) || possibly(token_type::KWD_UNION));
-  Pos structpos = t().second;
+  SourceLoc structpos = t().second;
   auto type = t().first.type;
   struct_specifier* s =  nullptr;
   consume();
   auto tag = t();
   expect(token_type::IDENTIFIER);
-  s = new struct_specifier{structpos, type, tag.first.data};
+  s = make<struct_specifier>(structpos, type, tag.first.name);
   
   if(possibly(token_type::PCTR_LBRACE)) {
     consume();
@@ -71,7 +76,7 @@ declarator* decl_parser::match_declarator(declarator_kind kind) {
   // parse pointers
   if(possibly(token_type::PCTR_STAR)) {
     consume();
-    return new declarator{true, match_declarator(kind)};
+    return make<declarator>(true, match_declarator(kind));
   }
 
   // parse direct (abs) declarators
@@ -81,23 +86,23 @@ declarator* decl_parser::match_declarator(declarator_kind kind) {
     // parse param list
     if((kind != NON_ABSTRACT) && (is_type_specifier(t().first) 
 				  || possibly(token_type::PCTR_RPAREN))) {
-      dp = new declarator{false, ""};
+      dp = make<declarator>(false, symbol{});
       match_parameter_type_list(dp);
       expect(token_type::PCTR_RPAREN);
       return dp;
     } else {
-      dp = new declarator{false, match_declarator(kind)};
+      dp = make<declarator>(false, match_declarator(kind));
       expect(token_type::PCTR_RPAREN);
     }
   } else if(kind != ABSTRACT && possibly(token_type::IDENTIFIER)) {
-    dp = new declarator{false, t().first.data};
+    dp = make<declarator>(false, t().first.name);
     consume(); // todo: error when non-abstract and missing identifier
   }
 
   // parse param list
   if(possibly(token_type::PCTR_LPAREN)) {
     if(!dp)
-      dp = new declarator{false, ""}; 
+      dp = make<declarator>(false, symbol{}); 
     consume();
     match_parameter_type_list(dp);
     expect(token_type::PCTR_RPAREN);
@@ -109,12 +114,15 @@ void decl_parser::match_parameter_type_list(declarator* d) {
   if(possibly(token_type::PCTR_VARARGS))
     errorf(t().second, "require an argument before '...'");
   
-  if(!possibly(token_type::PCTR_RPAREN) && !possibly(token_type::T_EOF))
+  if(!possibly(token_type::PCTR_RPAREN) && !at_sync(SYNC_LIST))
     match_parameter_type(d);
 
-  while(!possibly(token_type::PCTR_RPAREN) && !possibly(token_type::T_EOF)) {
+  while(!possibly(token_type::PCTR_RPAREN) && !at_sync(SYNC_LIST)) {
+    const char* start = t().first.start;
     expect(token_type::PCTR_COMMA);
     match_parameter_type(d);
+    if(t().first.start == start)
+      break; // stuck, leave it to the ')'
   }
   if(d->parameter_decls().empty())
     errorf(t().second, "empty parameter list not allowed");
@@ -126,10 +134,10 @@ void decl_parser::match_parameter_type(declarator* d) {
    if(!possibly(token_type::PCTR_RPAREN))
      errorf(t().second, "'...' needs to be the last argument");
  } else {
-   Pos p = t().second;
-   std::unique_ptr<type_specifier> ts{match_type_specifier()};
-   std::unique_ptr<declarator> dl{match_declarator(BOTH)};
-   d->add_parameter_decl(new parameter_decl{p, ts.release(), dl.release()});
+   SourceLoc p = t().second;
+   type_specifier* ts = match_type_specifier();
+   declarator* dl = match_declarator(BOTH);
+   d->add_parameter_decl(*get_context(), make<parameter_decl>(p, ts, dl));
  }
 }
 }
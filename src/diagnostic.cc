@@ -3,15 +3,25 @@
 #include <cstring>
 #include <errno.h>
 #include <iostream>
+#include <string>
+#include <utility>
 
 #include "pos.h"
+#include "source_manager.h"
 #include "diagnostic.h"
 
-static void verrorf(c4::Pos const*, char const* fmt, va_list);
+static void verrorf(c4::SourceLoc, c4::Pos const*, char const* fmt, va_list);
+static void printHead(c4::Pos const*);
 
 static unsigned nErrors   = 0;
 static bool     newErrors = false;
 
+// where the diagnostics of this thread go instead of stderr
+static thread_local DiagnosticBuffer* buffer = nullptr;
+
+static void (*flushHook)(void*) = nullptr;
+static void*    flushData = nullptr;
+
 void errorErrno(c4::Pos const& pos)
 {
 	errorf(pos, "%s", strerror(errno));
@@ -21,7 +31,15 @@ void errorf(c4::Pos const& pos, char const* fmt, ...)
 {
 	va_list ap;
 	va_start(ap, fmt);
-	verrorf(&pos, fmt, ap);
+	verrorf(c4::SourceLoc{}, &pos, fmt, ap);
+	va_end(ap);
+}
+
+void errorf(c4::SourceLoc const loc, char const* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	verrorf(loc, nullptr, fmt, ap);
 	va_end(ap);
 }
 
@@ -29,7 +47,7 @@ void errorf(char const* fmt, ...)
 {
 	va_list ap;
 	va_start(ap, fmt);
-	verrorf(nullptr, fmt, ap);
+	verrorf(c4::SourceLoc{}, nullptr, fmt, ap);
 	va_end(ap);
 }
 
@@ -45,6 +63,52 @@ bool hasNewErrors()
 	return res;
 }
 
+unsigned errorCount()
+{
+	return nErrors + (buffer ? static_cast<unsigned>(buffer->size()) : 0);
+}
+
+void setDiagnosticFlushHook(void (*hook)(void*), void* data)
+{
+	flushHook = hook;
+	flushData = data;
+}
+
+DiagnosticBuffer* setDiagnosticBuffer(DiagnosticBuffer* buf)
+{
+	auto const old = buffer;
+	buffer = buf;
+	return old;
+}
+
+void DiagnosticBuffer::add(c4::SourceLoc const loc, c4::Pos const* const pos,
+                           std::string message)
+{
+	entries_.push_back(Entry{loc, pos != nullptr, pos ? *pos : c4::Pos{""},
+	                         std::move(message)});
+}
+
+void DiagnosticBuffer::flush()
+{
+	flush(0, entries_.size());
+	entries_.clear();
+}
+
+void DiagnosticBuffer::flush(std::size_t const first, std::size_t const last)
+{
+	for (std::size_t i = first; i != last; ++i) {
+		auto const& e = entries_[i];
+		if (e.loc.valid()) {
+			auto const pos = c4::source_manager::get().resolve(e.loc);
+			printHead(&pos);
+		} else {
+			printHead(e.hasPos ? &e.pos : nullptr);
+		}
+		fwrite(e.message.data(), 1, e.message.size(), stderr);
+		fputc('\n', stderr);
+	}
+}
+
 int printDiagnosticSummary()
 {
 	if (nErrors != 0) {
@@ -54,48 +118,31 @@ int printDiagnosticSummary()
 	return 0;
 }
 
-static void verrorf(c4::Pos const* const pos, char const* fmt, va_list ap)
+// write the message to out(text, length) piece by piece
+template<typename Out>
+static void format(char const* fmt, va_list ap, Out out)
 {
 #if __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wformat-extra-args"
 #endif
-	newErrors = true;
-	++nErrors;
-
-        // flush std::cout before printing anything to stderr to avoid
-        // interleaving, since we turned of io sync and never flush
-        // cout
-        std::cout.flush();
-
-	auto const out = stderr;
-
-	if (pos) {
-		auto const posFmt =
-			pos->column != 0 ? "%s:%u:%u: " :
-			pos->line   != 0 ? "%s:%u: "    :
-			"%s: ";
-		fprintf(out, posFmt, pos->name, pos->line, pos->column);
-	}
-	fputs("error: ", out);
-
 	for (; auto f = strchr(fmt, '%'); fmt = f) {
-		fwrite(fmt, 1, f - fmt, out);
+		out(fmt, f - fmt);
 		++f; // Skip '%'.
 		switch (*f++) {
 		case '%':
-			fputc('%', out);
+			out("%", 1);
 			break;
 
 		case 'c': {
 			auto const c = (char)va_arg(ap, int);
-			fputc(c, out);
+			out(&c, 1);
 			break;
 		}
 
 		case 's': {
 			auto const s = va_arg(ap, char const*);
-			fputs(s, out);
+			out(s, strlen(s));
 			break;
 		}
 
@@ -103,10 +150,52 @@ static void verrorf(c4::Pos const* const pos, char const* fmt, va_list ap)
 			PANIC("invalid format specifier");
 		}
 	}
-	fputs(fmt, out);
-
-	fputc('\n', out);
+	out(fmt, strlen(fmt));
 #if __clang__
 #pragma clang diagnostic pop
 #endif
 }
+
+static void verrorf(c4::SourceLoc const loc, c4::Pos const* const pos,
+                    char const* fmt, va_list ap)
+{
+	if (buffer) {
+		std::string message;
+		format(fmt, ap, [&](char const* s, std::size_t n) { message.append(s, n); });
+		buffer->add(loc, pos, std::move(message));
+		return;
+	}
+
+	if (loc.valid()) {
+		auto const resolved = c4::source_manager::get().resolve(loc);
+		printHead(&resolved);
+	} else {
+		printHead(pos);
+	}
+	format(fmt, ap, [](char const* s, std::size_t n) { fwrite(s, 1, n, stderr); });
+	fputc('\n', stderr);
+}
+
+static void printHead(c4::Pos const* const pos)
+{
+	newErrors = true;
+	++nErrors;
+
+        // flush std::cout before printing anything to stderr to avoid
+        // interleaving, since we turned of io sync and never flush
+        // cout
+        std::cout.flush();
+	if (flushHook)
+		flushHook(flushData);
+
+	auto const out = stderr;
+
+	if (pos) {
+		auto const posFmt =
+			pos->column != 0 ? "%s:%u:%u: " :
+			pos->line   != 0 ? "%s:%u: "    :
+			"%s: ";
+		fprintf(out, posFmt, pos->name, pos->line, pos->column);
+	}
+	fputs("error: ", out);
+}
@@ -1,12 +1,15 @@
 #ifndef DIAGNOSTIC_H
 #define DIAGNOSTIC_H
 
-namespace c4 {
-struct Pos;
-}
+#include <string>
+#include <vector>
+
+#include "pos.h"
 
 void errorf(const c4::Pos &, const char * fmt, ...);
 
+void errorf(c4::SourceLoc, const char * fmt, ...);
+
 void errorf(const char* fmt, ...);
 
 void errorErrno(const c4::Pos& pos);
@@ -16,6 +19,48 @@ bool hasErrors();
 
 bool hasNewErrors();
 
+//! The errors reported so far, with those kept back on this thread.
+unsigned errorCount();
+
 int printDiagnosticSummary();
 
+//! Have hook(data) called before every diagnostic, so output that is
+//! still buffered appears before it. Pass nullptr to remove the hook.
+void setDiagnosticFlushHook(void (*hook)(void*), void* data);
+
+//! Diagnostics that were kept back instead of printed. Their locations
+//! are resolved only when they are printed.
+class DiagnosticBuffer
+{
+public:
+  //! Keep a diagnostic at loc or, without one, at pos if that is set.
+  void add(c4::SourceLoc loc, c4::Pos const* pos, std::string message);
+
+  //! Print the kept diagnostics as if they were reported now.
+  void flush();
+
+  //! Print the kept diagnostics [first, last) and keep them all.
+  void flush(std::size_t first, std::size_t last);
+
+  //! Drop the kept diagnostics.
+  void clear() { entries_.clear(); }
+
+  bool empty() const { return entries_.empty(); }
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  struct Entry
+  {
+    c4::SourceLoc loc;
+    bool hasPos;
+    c4::Pos pos;
+    std::string message;
+  };
+  std::vector<Entry> entries_;
+};
+
+//! Keep the diagnostics of the calling thread in buf until it is called
+//! again with nullptr. Returns the buffer that was set before.
+DiagnosticBuffer* setDiagnosticBuffer(DiagnosticBuffer* buf);
+
 #endif
@@ -3,84 +3,146 @@
 #include "decl_parser.h"
 #include "diagnostic.h"
 
+#include "llvm/ADT/SmallVector.h"
+
+#include <array>
+
 namespace {
 
-int left_precedence(const c4::token& t) {
-  switch(t.type) {
-  case c4::token_type::PCTR_STAR: return 15;
-  case c4::token_type::PCTR_PLUS:
-  case c4::token_type::PCTR_MINUS: return 13;
-  case c4::token_type::PCTR_LESS: return 11;
-  case c4::token_type::PCTR_EQUAL:
-  case c4::token_type::PCTR_NOT_EQUAL: return 9;
-  case c4::token_type::PCTR_AND: return 7;
-  case c4::token_type::PCTR_OR: return 5;
-  case c4::token_type::PCTR_QUESTIONMARK: return 3;
-  case c4::token_type::PCTR_ASSIGN: return 0;
-  default: return -1;
-  }
-}
+using c4::token_type;
 
-int right_precedence(const c4::token& t) {
-  switch(t.type) {
-  case c4::token_type::PCTR_STAR: return 14;
-  case c4::token_type::PCTR_PLUS:
-  case c4::token_type::PCTR_MINUS: return 12;
-  case c4::token_type::PCTR_LESS: return 10;
-  case c4::token_type::PCTR_EQUAL:
-  case c4::token_type::PCTR_NOT_EQUAL: return 8;
-  case c4::token_type::PCTR_AND: return 6;
-  case c4::token_type::PCTR_OR: return 4;
-  case c4::token_type::PCTR_QUESTIONMARK: return 2;
-  case c4::token_type::PCTR_ASSIGN: return 1;
-  default: return -1;
-  }
+//! How tightly a binary operator binds its left and its right operand;
+//! -1 for tokens that are no binary operator. A left associative
+//! operator binds its left operand tighter than its right one.
+struct precedence
+{
+  signed char left;
+  signed char right;
+};
+
+constexpr precedence precedence_of(token_type t)
+{
+  return t == token_type::PCTR_STAR ? precedence{15, 14}
+    : t == token_type::PCTR_PLUS || t == token_type::PCTR_MINUS ? precedence{13, 12}
+    : t == token_type::PCTR_LESS ? precedence{11, 10}
+    : t == token_type::PCTR_EQUAL || t == token_type::PCTR_NOT_EQUAL ? precedence{9, 8}
+    : t == token_type::PCTR_AND ? precedence{7, 6}
+    : t == token_type::PCTR_OR ? precedence{5, 4}
+    : t == token_type::PCTR_QUESTIONMARK ? precedence{3, 2}
+    : t == token_type::PCTR_ASSIGN ? precedence{0, 1}
+    : precedence{-1, -1};
 }
 
+template<std::size_t... Ts>
+constexpr std::array<precedence, sizeof...(Ts)> make_precedences(index_list<Ts...>)
+{ return {{ precedence_of(static_cast<token_type>(Ts))... }}; }
+
+constexpr std::array<precedence, c4::num_token_types> precedences
+  = make_precedences(make_index_list<c4::num_token_types>::type{});
+
+inline const precedence& precedence_of(const c4::token& t)
+{ return precedences[static_cast<std::size_t>(t.type)]; }
+
+//! A conditional waiting for its last operand takes every operator but
+//! assignment into it, so it binds like an operator right below the
+//! right precedence of '?'.
+const int conditional_left = 1;
+
+//! An operator whose right operand is still being parsed.
+struct pending_operator
+{
+  token_type op;
+  int left;
+  c4::SourceLoc pos;
+  c4::expression* lhs;
+  c4::expression* true_expr; // for '?'
+};
+
 } // unnamed
 
 namespace c4 {
 
+// Operator precedence parsing with an explicit stack: operators wait
+// on the stack until one that doesn't bind tighter shows up, so the
+// stack of the machine stays flat however long the expression is. The
+// trees are the same as precedence climbing makes. Parentheses and
+// calls still nest a frame of this, so the operators it has room for
+// are few; more than eight wait on the heap.
 expression* expr_parser::operator()() {
-  expression* left = match_operand();
-  return match_subexpression(left, 0);
+  llvm::SmallVector<pending_operator, 8> stack;
+  expression* operand = match_operand();
+  for(;;) {
+    int right = precedence_of(t().first).right;
+    while(!stack.empty() && right <= stack.back().left) {
+      const pending_operator& p = stack.back();
+      if(p.op == token_type::PCTR_QUESTIONMARK)
+        operand = make<ternary_expr>(p.lhs, p.true_expr, operand, p.pos);
+      else
+        operand = make<binary_operator>(p.op, p.lhs, operand, p.pos);
+      stack.pop_back();
+    }
+    if(right < 0)
+      return operand;
+
+    auto op = t();
+    consume();
+    if(is_ternary(op.first)) {
+      expression* true_expr = (*this)();
+      expect(token_type::PCTR_COLON);
+      stack.push_back(pending_operator{op.first.type, conditional_left, op.second,
+                                       operand, true_expr});
+    } else {
+      stack.push_back(pending_operator{op.first.type, precedence_of(op.first).left,
+                                       op.second, operand, nullptr});
+    }
+    operand = match_operand();
+  }
 }
 
 expression* expr_parser::match_operand() {
   return match_unary_expression();
 }
 
+// The prefix operators are collected first and applied from the
+// innermost one out, a long chain of them doesn't recurse.
 expression* expr_parser::match_unary_expression() {
-  expression* res;
-  if(possibly(token_type::KWD_SIZEOF)) {
-    auto size_pos = t().second;
-    consume();
-    if(possibly(token_type::PCTR_LPAREN)) {
-      if(is_type_specifier(peek().first)) {
+  if(!possibly(token_type::KWD_SIZEOF) && !is_unary_operator(t().first))
+    return match_postfix_expression();
+
+  llvm::SmallVector<std::pair<token_type, SourceLoc>, 4> prefixes;
+  expression* res = nullptr;
+  for(;;) {
+    if(possibly(token_type::KWD_SIZEOF)) {
+      auto size_pos = t().second;
+      consume();
+      if(possibly(token_type::PCTR_LPAREN) && is_type_specifier(peek().first)) {
 	consume();
-	decl_parser dp{get_lexer()};
-        Pos p = t().second;
-        std::unique_ptr<type_specifier> ts{dp.match_type_specifier()};
-        std::unique_ptr<declarator> dl{dp.match_declarator
-	    (decl_parser::ABSTRACT)};
-	res = new sizeof_type{
-	  new type_name{p, ts.release(), dl.release()}, size_pos};
+	decl_parser dp{get_lexer(), get_context()};
+        SourceLoc p = t().second;
+        type_specifier* ts = dp.match_type_specifier();
+        declarator* dl = dp.match_declarator(decl_parser::ABSTRACT);
+	res = make<sizeof_type>(make<type_name>(p, ts, dl), size_pos);
 	expect(token_type::PCTR_RPAREN);
-      } else {
-      	res = new sizeof_expr{match_unary_expression(), size_pos}; 
+        break;
       }
+      prefixes.push_back(std::make_pair(token_type::KWD_SIZEOF, size_pos));
+    } else if(is_unary_operator(t().first)) {
+      prefixes.push_back(std::make_pair(t().first.type, t().second));
+      consume();
     } else {
-      res =  new sizeof_expr{match_unary_expression(), size_pos};
+      res = match_postfix_expression();
+      break;
     }
-    return res;
-  } else if(is_unary_operator(t().first)) {
-    auto op = t();
-    consume();
-    return new unary_operator{op.first.type, match_unary_expression(), 
-	op.second};
-  } else {
-    return match_postfix_expression();
   }
+
+  while(!prefixes.empty()) {
+    auto op = prefixes.pop_back_val();
+    if(op.first == token_type::KWD_SIZEOF)
+      res = make<sizeof_expr>(res, op.second);
+    else
+      res = make<unary_operator>(op.first, res, op.second);
+  }
+  return res;
 }
 
 expression* expr_parser::match_postfix_expression() {
@@ -92,35 +154,39 @@ expression* expr_parser::match_postfix_expression() {
        || op.first.type == token_type::PCTR_DEREF) {
       auto right = t();
       expect(token_type::IDENTIFIER);
-      res = new postfix_operator{op.first.type, res, 
-				 new primary_expression{right.first, 
-							right.second}, 
-				 op.second}; 
+      res = make<postfix_operator>(op.first.type, res, 
+				 make<primary_expression>(right.first, 
+							right.second), 
+				 op.second); 
     } else if(op.first.type == token_type::PCTR_LBRACKET) {
       expression* right = (*this)();
       expect(token_type::PCTR_RBRACKET);
-      res = new subscript_operator{res, right, op.second};
+      res = make<subscript_operator>(res, right, op.second);
     } else { // op == (
-      function_call* temp = new function_call{res, op.second};
-      
-      if(!possibly(token_type::PCTR_RPAREN) &&
-	    !possibly(token_type::T_EOF)) {
-	if(auto expr = (*this)())
-	  temp->add_param(expr);
-      }
-      while(!possibly(token_type::PCTR_RPAREN) &&
-	    !possibly(token_type::T_EOF)) {
-	  expect(token_type::PCTR_COMMA);
-	  if(auto expr = (*this)())
-	    temp->add_param(expr);
-      }
-      expect(token_type::PCTR_RPAREN);
-      res = temp;
+      res = match_call(res, op.second);
     }
   }
   return res;
 }
 
+// the call comes after its operands, the called one first; the frame
+// with the operands is only there for calls, not on every level of
+// nesting
+expression* expr_parser::match_call(expression* callee, SourceLoc pos) {
+  llvm::SmallVector<expression*, 8> operands{callee};
+  if(!possibly(token_type::PCTR_RPAREN) && !at_sync(SYNC_LIST))
+    operands.push_back((*this)());
+  while(!possibly(token_type::PCTR_RPAREN) && !at_sync(SYNC_LIST)) {
+    const char* start = t().first.start;
+    expect(token_type::PCTR_COMMA);
+    operands.push_back((*this)());
+    if(t().first.start == start)
+      break; // stuck, leave it to the ')'
+  }
+  expect(token_type::PCTR_RPAREN);
+  return make<function_call>(operands.data(), operands.size(), pos);
+}
+
 expression* expr_parser::match_primary_expression() {
   switch(t().first.type) {
   case token_type::IDENTIFIER:
@@ -129,7 +195,7 @@ expression* expr_parser::match_primary_expression() {
   case token_type::STRING_LITERAL: {
     auto res = t();
     consume();
-    return new primary_expression{res.first, res.second};
+    return make<primary_expression>(res.first, res.second);
   }
   case token_type::PCTR_LPAREN: {
     consume();
@@ -140,31 +206,9 @@ expression* expr_parser::match_primary_expression() {
   default: { 
     errorf(t().second, "expected expression before '%s' token", 
 	  token_to_string(t().first.type));
-    return nullptr;
+    return make<error_expr>(t().second);
   }
   }
 }
 
-expression* expr_parser::match_subexpression(expression* left, int min_prec) {
-  while(right_precedence(t().first) >= min_prec) {
-    auto op = t();
-    consume();
-    if(is_ternary(op.first)) {
-      expression* true_expr = (*this)();
-      expect(token_type::PCTR_COLON);
-      expression* false_expr = match_operand();
-      false_expr = match_subexpression(false_expr, 2);
-      left = new ternary_expr(left, true_expr, false_expr, op.second);
-      continue;
-    }
-    expression* right = match_operand();
-    while(right_precedence(t().first) > left_precedence(op.first)) {
-      right = match_subexpression(right, right_precedence(t().first));
-    }
-    left =  new binary_operator{op.first.type, left, right, op.second};
-  }
-  return left;
-}
-
-
 } // c4
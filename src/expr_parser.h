@@ -18,9 +18,9 @@ struct expr_parser : parser_base
   expression* operator()();
  private:
   expression* match_operand();
-  expression* match_subexpression(expression* left, int min_prec);
   expression* match_unary_expression();
   expression* match_postfix_expression();
+  expression* match_call(expression* callee, SourceLoc pos);
   expression* match_primary_expression();
 };
 
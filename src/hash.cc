@@ -0,0 +1,24 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace c4 {
+
+std::uint64_t content_hash(const char* begin, const char* end)
+{
+  std::uint64_t h = hash_mix(0, static_cast<std::uint64_t>(end - begin));
+  std::uint64_t word;
+  for(; end - begin >= 8; begin += 8) {
+    std::memcpy(&word, begin, sizeof(word));
+    h = hash_mix(h, word);
+  }
+  if(begin != end) {
+    // the rest as a word padded with zeros, the size tells them apart
+    word = 0;
+    std::memcpy(&word, begin, static_cast<std::size_t>(end - begin));
+    h = hash_mix(h, word);
+  }
+  return hash_finalize(h);
+}
+
+} // c4
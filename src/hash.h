@@ -0,0 +1,34 @@
+#ifndef C4_HASH_H
+#define C4_HASH_H
+
+#include <cstdint>
+
+namespace c4 {
+
+//! murmur3's 64 bit finalizer: a bijection in which every bit of k
+//! flips every bit of the result about half of the time.
+inline std::uint64_t hash_finalize(std::uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+//! Mix v into the running hash h. v goes through the finalizer first,
+//! so close values don't make close hashes; the multiplier is odd, so
+//! the step loses nothing of h. Finish with hash_finalize.
+inline std::uint64_t hash_mix(std::uint64_t h, std::uint64_t v)
+{
+  return (h ^ hash_finalize(v)) * 0x9e3779b97f4a7c15ULL;
+}
+
+//! A 64 bit hash of [begin, end) for names and checksums, mixed with
+//! hash_mix a word at a time. It is no cryptographic digest, whoever
+//! must not be fooled compares the bytes too.
+std::uint64_t content_hash(const char* begin, const char* end);
+
+} // c4
+#endif /* C4_HASH_H */
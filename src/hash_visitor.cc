@@ -0,0 +1,314 @@
+#include "hash_visitor.h"
+#include "ast.h"
+#include "hash.h"
+#include "type.h"
+#include "util.h"
+
+#include <algorithm>
+
+namespace c4 {
+
+namespace {
+
+// The node kinds go in by their names and the tokens by their
+// spelling, so adding or moving an enumerator keeps the hashes.
+const char* kind_name(ast_kind k)
+{
+  switch(k) {
+  case ast_kind::TRANSLATION_UNIT: return "translation_unit";
+  case ast_kind::DECLARATOR: return "declarator";
+  case ast_kind::TYPE_SPECIFIER: return "type_specifier";
+  case ast_kind::STRUCT_SPECIFIER: return "struct_specifier";
+  case ast_kind::PARAMETER_DECL: return "parameter_decl";
+  case ast_kind::DECL: return "decl";
+  case ast_kind::TYPE_NAME: return "type_name";
+  case ast_kind::COMP_STMT: return "comp_stmt";
+  case ast_kind::BREAK_STMT: return "break_stmt";
+  case ast_kind::CONTINUE_STMT: return "continue_stmt";
+  case ast_kind::RETURN_STMT: return "return_stmt";
+  case ast_kind::LABELED_STMT: return "labeled_stmt";
+  case ast_kind::GOTO_STMT: return "goto_stmt";
+  case ast_kind::WHILE_STMT: return "while_stmt";
+  case ast_kind::IF_STMT: return "if_stmt";
+  case ast_kind::IF_ELSE_STMT: return "if_else_stmt";
+  case ast_kind::EXPR_STMT: return "expr_stmt";
+  case ast_kind::PRIMARY_EXPRESSION: return "primary_expression";
+  case ast_kind::ERROR_EXPR: return "error_expr";
+  case ast_kind::SIZEOF_EXPR: return "sizeof_expr";
+  case ast_kind::SIZEOF_TYPE: return "sizeof_type";
+  case ast_kind::UNARY_OPERATOR: return "unary_operator";
+  case ast_kind::BINARY_OPERATOR: return "binary_operator";
+  case ast_kind::POSTFIX_OPERATOR: return "postfix_operator";
+  case ast_kind::SUBSCRIPT_OPERATOR: return "subscript_operator";
+  case ast_kind::FUNCTION_CALL: return "function_call";
+  case ast_kind::TERNARY_EXPR: return "ternary_expr";
+  }
+  PANIC("unknown ast_kind");
+}
+
+// the tags of the kinds, hashed once
+struct kind_tags {
+  std::uint64_t tags[static_cast<std::size_t>(ast_kind::TERNARY_EXPR) + 1];
+  kind_tags()
+  {
+    for(std::size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); ++i) {
+      llvm::StringRef name = kind_name(static_cast<ast_kind>(i));
+      tags[i] = content_hash(name.begin(), name.end());
+    }
+  }
+};
+
+std::uint64_t kind_tag(ast_kind k)
+{
+  static const kind_tags t;
+  return t.tags[static_cast<std::size_t>(k)];
+}
+
+// what a type starts with, kept apart from the node kinds
+enum class type_tag : std::uint64_t {
+  NONE = 0x100, INT = 0x101, CHAR = 0x102, ZERO = 0x103, VOID = 0x104,
+  ERROR = 0x105, POINTER = 0x106, STRUCT = 0x107, FUNCTION = 0x108
+};
+
+}
+
+void hash_visitor::reset()
+{
+  h_ = 0;
+}
+
+void hash_visitor::mix(std::uint64_t v)
+{
+  h_ = hash_mix(h_, v);
+}
+
+void hash_visitor::mix(token_type t)
+{
+  mix(llvm::StringRef{token_to_string(t)});
+}
+
+void hash_visitor::mix(llvm::StringRef s)
+{
+  mix(content_hash(s.begin(), s.end()));
+}
+
+void hash_visitor::mix(symbol s)
+{
+  mix(s.empty() ? llvm::StringRef{} : s.str());
+}
+
+void hash_visitor::node(ast_node* n)
+{
+  mix(kind_tag(n->kind()));
+  if(n->is_expression())
+    mix(static_cast<expression*>(n)->e_type());
+}
+
+std::uint64_t hash_visitor::type_hash(type* t)
+{
+  if(!t)
+    return static_cast<std::uint64_t>(type_tag::NONE);
+  // inside a struct the hash of a type depends on the structs around
+  // it, so only the ones outside are kept
+  bool outside = structs_.empty();
+  if(outside) {
+    auto it = types_.find(t);
+    if(it != types_.end())
+      return it->second;
+  }
+
+  std::uint64_t h = 0;
+  if(auto p = as_pointer_type(t)) {
+    h = hash_mix(h, static_cast<std::uint64_t>(type_tag::POINTER));
+    h = hash_mix(h, type_hash(p->underlying().get()));
+  } else if(auto f = as_function_type(t)) {
+    h = hash_mix(h, static_cast<std::uint64_t>(type_tag::FUNCTION));
+    h = hash_mix(h, type_hash(f->return_type().get()));
+    h = hash_mix(h, f->arguments().size());
+    for(auto& a : f->arguments())
+      h = hash_mix(h, type_hash(a.get()));
+  } else if(auto s = as_struct_type(t)) {
+    // a member may lead back to the struct, then it is only its tag
+    std::uint64_t old = h_;
+    h_ = hash_mix(h, static_cast<std::uint64_t>(type_tag::STRUCT));
+    mix(s->get_tag());
+    if(std::find(structs_.begin(), structs_.end(), t) == structs_.end()) {
+      structs_.push_back(t);
+      mix(s->members().size());
+      for(auto& m : s->members()) {
+        mix(m.first);
+        mix(m.second);
+      }
+      structs_.pop_back();
+    }
+    h = h_;
+    h_ = old;
+  } else if(t->is_arithmetic()) {
+    h = hash_mix(h, static_cast<std::uint64_t>(t->is_char() ? type_tag::CHAR
+                                               : t->is_zero() ? type_tag::ZERO
+                                               : type_tag::INT));
+  } else if(t->is_void()) {
+    h = hash_mix(h, static_cast<std::uint64_t>(type_tag::VOID));
+  } else {
+    h = hash_mix(h, static_cast<std::uint64_t>(type_tag::ERROR));
+  }
+  h = hash_finalize(h);
+
+  if(outside)
+    types_.emplace(t, h);
+  return h;
+}
+
+/////////// DECLARATIONS //////////
+
+bool hash_visitor::handle(translation_unit* tu) {
+  node(tu);
+  mix(tu->decls().size());
+  return true;
+}
+
+bool hash_visitor::handle(declarator* d) {
+  node(d);
+  mix(d->pointer());
+  mix(d->get_identifier());
+  mix(d->get_declarator() != nullptr);
+  // the walk leaves the parameters out
+  mix(d->parameter_decls().size());
+  for(auto& p : d->parameter_decls())
+    visit(p.get());
+  return true;
+}
+
+bool hash_visitor::handle(parameter_decl* pd) {
+  node(pd);
+  mix(static_cast<std::uint64_t>(pd->get_linkage()));
+  mix(pd->get_type_specifier() != nullptr);
+  mix(pd->get_declarator() != nullptr);
+  return true;
+}
+
+bool hash_visitor::handle(decl* d) {
+  node(d);
+  mix(static_cast<std::uint64_t>(d->get_linkage()));
+  mix(d->get_declarator() != nullptr);
+  mix(d->has_body());
+  return true;
+}
+
+bool hash_visitor::handle(type_specifier* ts) {
+  node(ts);
+  mix(ts->token);
+  mix(ts->get_type());
+  return true;
+}
+
+bool hash_visitor::handle(type_name* tn) {
+  node(tn);
+  // the walk skips a declarator that declares nothing
+  auto ad = tn->get_declarator();
+  mix(ad && (ad->pointer() || ad->get_declarator()));
+  return true;
+}
+
+bool hash_visitor::handle(struct_specifier* s) {
+  node(s);
+  mix(s->token);
+  mix(s->get_tag());
+  mix(s->get_type());
+  mix(s->decls().size());
+  return true;
+}
+
+////////// STATEMENTS //////////
+
+bool hash_visitor::handle(comp_stmt* cs) {
+  node(cs);
+  mix(cs->sub_stmts().size());
+  return true;
+}
+
+bool hash_visitor::handle(return_stmt* rs) {
+  node(rs);
+  mix(rs->expr() != nullptr);
+  mix(rs->exp_rtype());
+  return true;
+}
+
+bool hash_visitor::handle(labeled_stmt* ls) {
+  node(ls);
+  mix(ls->get_label());
+  return true;
+}
+
+bool hash_visitor::handle(goto_stmt* gs) {
+  node(gs);
+  mix(gs->get_label());
+  return true;
+}
+
+bool hash_visitor::handle(expr_stmt* es) {
+  node(es);
+  mix(es->expr() != nullptr);
+  return true;
+}
+
+////////// EXPRESSIONS //////////
+
+bool hash_visitor::handle(primary_expression* pe) {
+  node(pe);
+  mix(pe->value().type);
+  mix(pe->value().data());
+  return true;
+}
+
+bool hash_visitor::handle(unary_operator* o) {
+  node(o);
+  mix(o->op());
+  return true;
+}
+
+bool hash_visitor::handle(binary_operator* o) {
+  node(o);
+  mix(o->op());
+  return true;
+}
+
+bool hash_visitor::handle(postfix_operator* o) {
+  node(o);
+  mix(o->op());
+  return true;
+}
+
+// the walk leaves the member out, it goes in after the struct
+void hash_visitor::leave(postfix_operator* o) {
+  visit(o->right());
+}
+
+bool hash_visitor::handle(function_call* fc) {
+  node(fc);
+  // the walk only takes the arguments
+  visit(fc->get_name());
+  mix(fc->params().size());
+  return true;
+}
+
+std::vector<decl_hash> hash_decls(translation_unit* tu)
+{
+  std::vector<decl_hash> hashes;
+  hashes.reserve(tu->decls().size());
+  hash_visitor hv;
+  for(auto& d : tu->decls()) {
+    std::uint64_t body = 0;
+    if(d->has_body()) {
+      hv.reset();
+      hv.visit(d->get_body());
+      body = hv.hash();
+    }
+    hv.reset();
+    hv.visit(d.get());
+    hashes.push_back(decl_hash{d.get(), hv.hash(), body});
+  }
+  return hashes;
+}
+
+} // c4
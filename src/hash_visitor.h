@@ -0,0 +1,84 @@
+#ifndef C4_HASH_VISITOR_H
+#define C4_HASH_VISITOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast_visitor.h"
+#include "hash.h"
+
+namespace c4 {
+
+//! Hashes the structure of a checked tree: the kinds of the nodes,
+//! their tokens, names and operators and the types sema gave them, but
+//! no positions, so moving code around or reformatting it keeps the
+//! hash. Kinds, names and tokens go in by their spelling and numbers in
+//! a fixed order, so the same tree hashes the same on every run, every
+//! host and every build.
+struct hash_visitor : ast_visitor<hash_visitor> {
+  hash_visitor() { reset(); }
+
+  //! The hash of the nodes visited since the last reset.
+  std::uint64_t hash() const { return hash_finalize(h_); }
+  void reset();
+
+  // every node goes in with its kind and, for expressions, its type;
+  // the others add what their children don't show
+  template<typename T>
+  bool handle(T* n) { node(n); return true; }
+
+  bool handle(translation_unit*);
+  bool handle(declarator*);
+  bool handle(parameter_decl*);
+  bool handle(decl*);
+  bool handle(type_specifier*);
+  bool handle(type_name*);
+  bool handle(struct_specifier*);
+
+  bool handle(comp_stmt*);
+  bool handle(return_stmt*);
+  bool handle(labeled_stmt*);
+  bool handle(goto_stmt*);
+  bool handle(expr_stmt*);
+
+  bool handle(primary_expression*);
+  bool handle(unary_operator*);
+  bool handle(binary_operator*);
+  bool handle(postfix_operator*);
+  bool handle(function_call*);
+
+  using ast_visitor<hash_visitor>::leave;
+  void leave(postfix_operator*);
+
+private:
+  void node(ast_node*);
+  void mix(std::uint64_t v);
+  void mix(symbol s);
+  void mix(token_type t);
+  void mix(llvm::StringRef s);
+  void mix(const std::shared_ptr<type>& t) { mix(type_hash(t.get())); }
+  std::uint64_t type_hash(type* t);
+
+  std::uint64_t h_;
+  // the structs whose members are being hashed, they only go in by
+  // their tag once more; and the types hashed outside of any struct
+  std::vector<const type*> structs_;
+  std::unordered_map<const type*, std::uint64_t> types_;
+};
+
+//! The hashes of a declaration of a translation unit.
+struct decl_hash
+{
+  decl* d;
+  std::uint64_t hash; // of all of d
+  std::uint64_t body; // of the body alone, 0 without one
+};
+
+//! Hash every declaration of tu, which must have been through sema.
+//! Declarations inside others are covered by the outer one.
+std::vector<decl_hash> hash_decls(translation_unit* tu);
+
+} // c4
+
+#endif /* C4_HASH_VISITOR_H */
@@ -1,10 +1,9 @@
 #include "input.h"
 
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
-#include <iterator>
-#include <algorithm>
-#include <stdexcept>
-#include <iostream>
+#include <utility>
 
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -12,54 +11,187 @@
 
 #include <sys/mman.h>
 
+namespace {
+
+c4::input_stats counters;
+
+// buffers of inputs that were read, kept for the next ones; most
+// inputs are small files and the pool saves the allocations
+std::vector<std::vector<char>> pool;
+constexpr std::size_t max_pooled = 8;
+constexpr std::size_t max_pooled_capacity = 1024 * 1024;
+
+std::vector<char> take_buffer()
+{
+  // reserve once, so give_back never allocates
+  pool.reserve(max_pooled);
+  if(pool.empty())
+    return std::vector<char>{};
+  auto b = std::move(pool.back());
+  pool.pop_back();
+  return b;
+}
+
+void give_back(std::vector<char>& b) noexcept
+{
+  if(pool.size() < pool.capacity() && b.capacity() != 0
+     && b.capacity() <= max_pooled_capacity) {
+    b.clear();
+    pool.push_back(std::move(b));
+  }
+}
+
+}
+
 namespace c4 {
 
-input::input(const char* name) : name_(name) { 
+input::input(const char* name, const input_policy& policy) : name_(name) {
   if(strcmp(name_, "-") == 0) {
     name_ = "<stdin>";
-    // read from std::cin
-    std::cin.unsetf(std::ios_base::skipws);
-    std::copy(std::istream_iterator<char>(std::cin), std::istream_iterator<char>(),
-              std::back_inserter(input_));
-    std::cin.setf(std::ios_base::skipws);
-    begin_ = input_.data();
-    end_ = input_.data() + input_.size();
+    // a redirected file can be mapped, pipes and terminals are read
+    if(!map(STDIN_FILENO, policy))
+      read_all(STDIN_FILENO, 0);
   } else {
     int fd = open(name, O_RDONLY);
     if(fd == -1)
       throw input_error("Could not open file.");
 
-    struct stat sb;
-    if(fstat(fd, &sb) == -1) {
+    // fifos and the like are read like stdin
+    try {
+      if(!map(fd, policy))
+        read_all(fd, 0);
+    } catch(input_error&) {
+      int err = errno;
       close(fd);
-      throw input_error("Could not stat file.");
+      errno = err;
+      throw;
     }
+    close(fd);
+  }
+}
+
+bool input::map(int fd, const input_policy& policy) {
+  struct stat sb;
+  if(fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode))
+    return false;
+
+  // stdin may already have been read from; map whole pages and skip
+  // what was consumed
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if(offset == -1)
+    return false;
+  if(offset >= sb.st_size)
+    return true; // nothing left, the input stays empty
+
+  std::size_t length = static_cast<std::size_t>(sb.st_size);
+  std::size_t rest = length - static_cast<std::size_t>(offset);
+  if(rest < policy.read_threshold) {
+    read_all(fd, rest);
+    return true;
+  }
+
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if(policy.populate)
+    flags |= MAP_POPULATE;
+#endif
+  void* m = mmap(nullptr, length, PROT_READ, flags, fd, 0);
+  if(m == MAP_FAILED)
+    return false;
 
-    if(sb.st_size != 0) {
-      begin_ = static_cast<const char*>
-        (mmap(nullptr, sb.st_size,
-              PROT_READ, MAP_PRIVATE,
-              fd, 0));
-      if(begin_ == MAP_FAILED) {
-        close(fd);
-        throw input_error("mmap failed.");
-      }
-
-      end_ = begin_ + sb.st_size;
-    } else {
-      begin_ = end_ = nullptr;
+  if(policy.advise) {
+    // these are advice values, not flags, so one call each
+    madvise(m, length, MADV_SEQUENTIAL);
+    madvise(m, length, MADV_WILLNEED);
+  }
+  ++counters.mapped_files;
+  counters.mapped_bytes += rest;
+
+  map_ = m;
+  map_length_ = length;
+  begin_ = static_cast<const char*>(m) + offset;
+  end_ = static_cast<const char*>(m) + length;
+  mode_ = mode::MAPPED;
+  return true;
+}
+
+void input::read_all(int fd, std::size_t size_hint) {
+  constexpr std::size_t block = 64 * 1024;
+  // one byte more than expected sees EOF without growing
+  input_ = take_buffer();
+  input_.resize(size_hint != 0 ? size_hint + 1 : block);
+  std::size_t size = 0;
+  for(;;) {
+    if(size == input_.size())
+      input_.resize(2 * input_.size());
+
+    ssize_t n = read(fd, input_.data() + size, input_.size() - size);
+    if(n == 0)
+      break;
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+      throw input_error("Could not read file.");
     }
+    size += static_cast<std::size_t>(n);
+  }
+  input_.resize(size);
+  ++counters.read_files;
+  counters.read_bytes += size;
 
-    close(fd);
+  if(size != 0) {
+    begin_ = input_.data();
+    end_ = input_.data() + size;
+    mode_ = mode::READ;
   }
 }
 
-input::~input() noexcept {
-  if(strcmp(name_, "<stdin>") != 0 && std::distance(begin_, end_) != 0) {
-    if(-1 == munmap(const_cast<char*>(begin_), std::distance(begin_, end_))) {
+input::input(input&& o) noexcept
+  : input_(std::move(o.input_)), name_(o.name_), begin_(o.begin_),
+    end_(o.end_), mode_(o.mode_), map_(o.map_), map_length_(o.map_length_) {
+  // o must not unmap what we own now
+  o.begin_ = o.end_ = nullptr;
+  o.mode_ = mode::EMPTY;
+  o.map_ = nullptr;
+  o.map_length_ = 0;
+}
+
+input& input::operator=(input&& o) noexcept {
+  if(this != &o) {
+    release();
+    input_ = std::move(o.input_);
+    name_ = o.name_;
+    begin_ = o.begin_;
+    end_ = o.end_;
+    mode_ = o.mode_;
+    map_ = o.map_;
+    map_length_ = o.map_length_;
+    o.begin_ = o.end_ = nullptr;
+    o.mode_ = mode::EMPTY;
+    o.map_ = nullptr;
+    o.map_length_ = 0;
+  }
+  return *this;
+}
+
+void input::release() noexcept {
+  if(mode_ == mode::MAPPED) {
+    if(-1 == munmap(map_, map_length_)) {
       std::abort();
     }
   }
+  give_back(input_);
+  mode_ = mode::EMPTY;
+  map_ = nullptr;
+  map_length_ = 0;
+}
+
+input::~input() noexcept {
+  release();
+}
+
+const input_stats& input::stats() {
+  return counters;
 }
 
 }
@@ -1,6 +1,7 @@
 #ifndef C4_INPUT_H
 #define C4_INPUT_H
 
+#include <cstddef>
 #include <type_traits>
 #include <stdexcept>
 #include <vector>
@@ -11,24 +12,63 @@ struct input_error : std::runtime_error {
   using runtime_error::runtime_error;
 };
 
+//! How inputs are brought into memory.
+struct input_policy {
+  //! Regular files smaller than this are read into a pooled buffer,
+  //! which is cheaper than mmap and munmap.
+  std::size_t read_threshold = 32 * 1024;
+  //! Ask the kernel to read ahead and to expect sequential access.
+  bool advise = true;
+  //! Fault the whole mapping in up front with MAP_POPULATE.
+  bool populate = false;
+};
+
+//! What the inputs so far cost.
+struct input_stats {
+  std::size_t mapped_files = 0;
+  std::size_t mapped_bytes = 0;
+  std::size_t read_files = 0;
+  std::size_t read_bytes = 0;
+};
+
 class input {
 public:
-  input(const char* name);
+  //! Where the bytes of an input live.
+  enum class mode {
+    EMPTY,  //!< nothing to read
+    MAPPED, //!< mmapped from the file, or from stdin if it is one
+    READ    //!< read into a buffer, for small files, pipes and terminals
+  };
+
+  input(const char* name, const input_policy& policy = input_policy{});
   input(const input&) = delete;
   input& operator=(const input&) = delete;
-  input(input&&) noexcept = default;
-  // works on clang. gcc bug?
-  input& operator=(input&& o) /* noexcept */ = default; 
+  input(input&& o) noexcept;
+  input& operator=(input&& o) noexcept;
   ~input() noexcept;
 
   const char* begin() const { return begin_; }
   const char* end() const { return end_; }
   const char* name() const { return name_; }
+  mode read_mode() const { return mode_; }
+
+  //! Counters over every input created so far.
+  static const input_stats& stats();
 private:
+  //! Map the rest of fd from its current offset, or read it if it is
+  //! small; false for anything that is not a regular file.
+  bool map(int fd, const input_policy& policy);
+  //! Read fd up to EOF in large blocks, expecting size_hint bytes.
+  void read_all(int fd, std::size_t size_hint);
+  void release() noexcept;
+
   std::vector<char> input_;
   const char* name_;
-  const char* begin_;
-  const char* end_;
+  const char* begin_ = nullptr;
+  const char* end_ = nullptr;
+  mode mode_ = mode::EMPTY;
+  void* map_ = nullptr; // the whole mapping, begin_ may lie behind it
+  std::size_t map_length_ = 0;
 };
 
 static_assert(std::is_nothrow_move_constructible<input>::value, "type-specification violation");
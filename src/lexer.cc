@@ -1,13 +1,27 @@
 #include "lexer.h"
 #include <algorithm>
+#include <array>
+#include <thread>
 
 #include "munchers.h"
+#include "scan.h"
 #include "diagnostic.h"
+#include "util.h"
 
 namespace {
+
+template<std::size_t... Cs>
+constexpr std::array<c4::muncher_kind, sizeof...(Cs)>
+make_dispatch_table(index_list<Cs...>)
+{ return {{ c4::first_char_muncher(Cs)... }}; }
+
+// which muncher to send for a token starting with a given byte
+constexpr std::array<c4::muncher_kind, 256> dispatch_table
+  = make_dispatch_table(make_index_list<256>::type{});
+
 template <typename Muncher>
 void call_muncher(const char* begin, const char* end,
-                  c4::token& cur, Muncher& m)
+                  c4::token& cur, const Muncher& m)
 {
   auto x = m(begin, end);
 
@@ -15,102 +29,349 @@ void call_muncher(const char* begin, const char* end,
     if(x.type != c4::token_type::INVALID) {
       cur = x;
     } else { // both are invalid
-      if(x.data.size() > cur.data.size())
+      if(x.length > cur.length)
         cur = x;
     }
   } else {
     if(x.type != c4::token_type::INVALID) {
-      if(x.data.size() > cur.data.size())
+      if(x.length > cur.length)
         cur = x;
     }
   }
 }
+
+void munch(const char* begin, const char* end, c4::token& cur,
+           c4::lexer::strategy s, c4::lex_diags& errors)
+{
+  using namespace c4;
+  if(s == lexer::LONGEST_MATCH) {
+    punctuator_muncher pm;
+    identifier_muncher im;
+    decimal_muncher dm;
+    string_muncher sm{errors};
+    comment_muncher cm{errors};
+
+    call_muncher(begin, end, cur, pm);
+    call_muncher(begin, end, cur, im);
+    call_muncher(begin, end, cur, dm);
+    call_muncher(begin, end, cur, sm);
+    call_muncher(begin, end, cur, cm);
+    return;
+  }
+
+  switch(dispatch_table[static_cast<unsigned char>(*begin)]) {
+  case muncher_kind::PUNCTUATOR: cur = punctuator_muncher{}(begin, end); break;
+  case muncher_kind::IDENTIFIER: cur = identifier_muncher{}(begin, end); break;
+  case muncher_kind::DECIMAL: cur = decimal_muncher{}(begin, end); break;
+  case muncher_kind::STRING: cur = string_muncher{errors}(begin, end); break;
+  case muncher_kind::SLASH: {
+    auto next = std::next(begin);
+    if(next != end && (*next == '/' || *next == '*'))
+      cur = comment_muncher{errors}(begin, end);
+    else
+      cur = punctuator_muncher{}(begin, end);
+    break;
+  }
+  case muncher_kind::NONE: break;
+  }
+}
+
+void intern(c4::token& t)
+{
+  if(t.type == c4::token_type::IDENTIFIER)
+    t.name = c4::symbol::intern(t.data());
+}
+
+// The end of the string or character constant whose opening quote is
+// at begin, found like the string muncher does. They end at the end of
+// the line, terminated or not.
+const char* skip_quoted(const char* begin, const char* end)
+{
+  char quote = *begin;
+  const char* p = begin + 1;
+  for(; p != end && *p != '\n' && *p != '\r'; ++p) {
+    if(*p == quote)
+      return p + 1;
+    if(*p == '\\' && p + 1 != end && p[1] != '\n' && p[1] != '\r')
+      ++p;
+  }
+  return p;
+}
+
+// don't bother with threads for pieces smaller than this
+const std::size_t min_chunk_size = 256 * 1024;
+
+// Find where to cut [begin, end) into about n pieces: right after a
+// \n outside of a comment. Comments, strings and character constants
+// are skipped like the munchers do, so a quote or a /* inside of them
+// isn't taken for the start of another one.
+std::vector<const char*> find_chunk_starts(const char* begin, const char* end,
+                                           std::size_t n)
+{
+  std::vector<const char*> starts;
+  std::size_t size = static_cast<std::size_t>(end - begin);
+  const char* target = begin + size / n;
+  for(const char* p = begin; p != end && starts.size() + 1 < n; ) {
+    char c = *p++;
+    if(c == '\n') {
+      if(p >= target) {
+        starts.push_back(p);
+        target = begin + size / n * (starts.size() + 1);
+      }
+    } else if(c == '/' && p != end && *p == '*') {
+      p = c4::scan().find_comment_end(p + 1, end);
+      if(p != end)
+        ++p;
+    } else if(c == '/' && p != end && *p == '/') {
+      p = c4::scan().find_line_end(p + 1, end);
+    } else if(c == '"' || c == '\'') {
+      p = skip_quoted(p - 1, end);
+    }
+  }
+  return starts;
+}
 }
 
 namespace c4 {
 
-void lexer::next_token(std::pair<token, Pos>& tokenarg, const char* end)
+std::size_t lexer::next_token(std::pair<token, SourceLoc>& tokenarg,
+                              lex_diags& errors, const char* end) const
 {
   assert(std::get<0>(tokenarg).type != token_type::COMMENT);
-  // token_ is never a comment, so we don't need to think about advancing the line
-  Pos& current_pos = tokenarg.second;
-  current_pos.column += tokenarg.first.data.size();
-  unsigned int& current_line = current_pos.line;
-  unsigned int& current_col =  current_pos.column;
-
-  // get our own begin, so we don't fiddle with the state
-  const char* begin = std::get<0>(tokenarg).data.data() + std::get<0>(tokenarg).data.size();
-  while(begin != end) {
+  // get our own begin, so we don't fiddle with the state; positions
+  // are just offsets, lines and columns are only computed when printed
+  const token& last = std::get<0>(tokenarg);
+  const char* begin = last.start + last.length;
+  // a string that was cut off goes on to its real end, which is where
+  // find_chunk_starts has it end too
+  if(last.length == max_token_length && (last.type == token_type::STRING_LITERAL
+                                         || last.type == token_type::CHARACTER_CONSTANT))
+    begin = skip_quoted(last.start, end);
+  auto skip_whitespace = scan().skip_whitespace;
+  // skip space, horizontal/vertical tab, form feed and newlines
+  while((begin = skip_whitespace(begin, end)) != end) {
     char c = *begin;
-    if(c == ' ' || c == '\t' || c == '\v' || c == '\f') {
-      // handle space, horizontal/vertical tab, and form feed
-      ++current_col;
-      ++begin;
-    } else if(c == '\n' || c == '\r') {
-      current_col = 1;
-      ++current_line;
-      ++begin;
-      if(begin != end && ((c == '\n' && *begin == '\r')
-			  || (c == '\r' && *begin == '\n'))) {
-	++begin;
-      }
-    } else if(c == '\\') {
-      ++current_col;
+    if(c == '\\') {
       ++begin;
-      if(begin == end || (*begin == '\n'))  {
-        current_col = 1;
-        ++current_line;
-        continue;
-      } else {
-        --current_col;
-        errorf(current_pos, "stray '\\' in program"); // emit the error for the column before
-        ++current_col;
-      }
-    } else if(std::iscntrl(c)) {
+      if(begin != end && *begin != '\n')
+        errors.push_back(lex_diag{lex_error::STRAY_BACKSLASH, c, loc(begin - 1)});
+    } else if(static_cast<unsigned char>(c) < ' ' || c == 0x7f) {
       // a stray control code!
+      errors.push_back(lex_diag{lex_error::STRAY_CONTROL, c, loc(begin)});
       ++begin;
-      errorf(current_pos, "stray '\\%d' in program", // TODO this will panic
-             static_cast<int>(c));
     } else {
-      punctuator_muncher pm;
-      identifier_muncher im;
-      decimal_muncher dm;
-      string_muncher sm;
-      comment_muncher cm;
-
       // this is not whitespace, send the marines
+      std::size_t own = errors.size();
       tokenarg.first = token{token_type::INVALID, llvm::StringRef{}};
-      call_muncher(begin, end, tokenarg.first, pm);
-      call_muncher(begin, end, tokenarg.first, im);
-      call_muncher(begin, end, tokenarg.first, dm);
-      call_muncher(begin, end, tokenarg.first, sm);
-      call_muncher(begin, end, tokenarg.first, cm);
-      
-      std::for_each(std::get<0>(tokenarg).errors.begin(), std::get<0>(tokenarg).errors.end(),
-                    [&tokenarg](const std::string& x) { errorf(std::get<1>(tokenarg), x.c_str()); });
+      tokenarg.second = loc(begin);
+      // no token may be longer than max_token_length, so the munchers
+      // see no more than that
+      const char* munch_end = static_cast<std::size_t>(end - begin) > max_token_length
+        ? begin + max_token_length : end;
+      munch(begin, munch_end, tokenarg.first, strategy_, errors);
+
+      // the munchers don't know where they are
+      for(auto i = own; i < errors.size(); ++i)
+        errors[i].loc = tokenarg.second;
+      if(munch_end != end
+         && tokenarg.first.start + tokenarg.first.length == munch_end) {
+        // what they found about the cut off token is of no use
+        errors.erase(errors.begin() + own, errors.end());
+        errors.push_back(lex_diag{lex_error::TOKEN_TOO_LONG, 0, tokenarg.second});
+        if(std::get<0>(tokenarg).type == token_type::COMMENT) {
+          // comments aren't kept, so this one is skipped whole; the
+          // rest of it is no code
+          const char* rest = begin + 2;
+          if(begin[1] == '/') {
+            begin = scan().find_line_end(rest, end);
+          } else if((begin = scan().find_comment_end(rest, end)) != end) {
+            ++begin;
+          } else {
+            errors.push_back(lex_diag{lex_error::UNTERMINATED_COMMENT, 0, tokenarg.second});
+          }
+          continue;
+        }
+      }
 
       if(std::get<0>(tokenarg).type == token_type::INVALID) {
-	errorf(current_pos, "stray '%c' in program", c);
-	++current_col;
+        errors.push_back(lex_diag{lex_error::STRAY_CHARACTER, c, tokenarg.second});
 	++begin;
 	continue;
       } else if(std::get<0>(tokenarg).type != token_type::COMMENT) {
-        return ;
+        return own;
       } else {
-        // we do not ever store those tokens, but we need to look at
-        // how many lines and columns they could have swallowed
-	if(cm.lines > 0)
-	  current_col = 1;
-       	current_line += cm.lines;
-	current_col += cm.cols;
-
         // skip the token
-        begin = std::get<0>(tokenarg).data.data() + std::get<0>(tokenarg).data.size();
+        begin = std::get<0>(tokenarg).start + std::get<0>(tokenarg).length;
       }
     }
   }
-  tokenarg.first = token{token_type::T_EOF, llvm::StringRef{end, 0}};
-  return ;
+  tokenarg = std::make_pair(token{token_type::T_EOF, llvm::StringRef{end, 0}}, loc(end));
+  return errors.size();
+}
+
+lexer::lexer(const lexer& l, std::size_t first, std::size_t last)
+  : begin_(l.begin_), end_(l.end_), strategy_(l.strategy_), base_(l.base_),
+    token_(l.at(first)), buffered_(true),
+    buffer_(l.buffer_.begin() + first, l.buffer_.begin() + last)
+{
+  assert(l.buffered_ && first < last && last <= l.reached_ && "lexer: bad range");
+  const char* eof = l.buffer_[last].start;
+  buffer_.push_back(token{token_type::T_EOF, llvm::StringRef{eof, 0}});
+  reached_ = buffer_.size() - 1;
+}
+
+const std::pair<token, SourceLoc>& lexer::advance_token()
+{
+  if(!buffered_) {
+    errors_.clear();
+    own_errors_ = next_token(token_, errors_, end_);
+    intern(token_.first);
+    std::for_each(errors_.begin(), errors_.end(), report);
+    return token_;
+  }
+
+  if(pos_ + 1 < buffer_.size())
+    ++pos_;
+  if(pos_ > reached_) {
+    // first time here, report what was found while lexing this token
+    reached_ = pos_;
+    for(; next_deferred_ < deferred_.size()
+          && deferred_[next_deferred_].index <= pos_; ++next_deferred_)
+      report(deferred_[next_deferred_].diag);
+  }
+  token_ = at(pos_);
+  return token_;
+}
+
+std::pair<token, SourceLoc> lexer::peek(std::size_t n) const
+{
+  if(buffered_)
+    return at(std::min(pos_ + n, buffer_.size() - 1));
+
+  // advance a copy
+  auto t = token_;
+  for(; n > 0 && t.first.type != token_type::T_EOF; --n) {
+    lex_diags errors;
+    next_token(t, errors, end_);
+    intern(t.first);
+    std::for_each(errors.begin(), errors.end(), report);
+  }
+  return t;
+}
+
+bool lexer::token_has_errors() const
+{
+  if(!buffered_)
+    return own_errors_ != errors_.size();
+
+  auto it = std::lower_bound(deferred_.begin(), deferred_.end(), pos_,
+                             [](const deferred_diag& d, std::size_t i) { return d.index < i; });
+  for(; it != deferred_.end() && it->index == pos_; ++it)
+    if(it->own)
+      return true;
+  return false;
+}
+
+void lexer::lex_range(std::pair<token, SourceLoc> t, const char* end,
+                      std::vector<token>& tokens,
+                      std::vector<deferred_diag>& deferred,
+                      std::uint32_t first_index, bool intern_names) const
+{
+  lex_diags errors;
+  auto index = first_index;
+  do {
+    errors.clear();
+    auto own = next_token(t, errors, end);
+    for(std::size_t i = 0; i < errors.size(); ++i)
+      deferred.push_back(deferred_diag{index, i >= own, errors[i]});
+    if(intern_names)
+      intern(t.first);
+    tokens.push_back(t.first);
+    ++index;
+  } while(t.first.type != token_type::T_EOF);
+}
+
+void lexer::adopt_buffer(std::vector<token>&& tokens,
+                         std::vector<deferred_diag>&& deferred)
+{
+  assert(!buffered_ && !tokens.empty());
+  buffer_ = std::move(tokens);
+  deferred_ = std::move(deferred);
+  // the errors of the current token are out already
+  next_deferred_ = 0;
+  while(next_deferred_ < deferred_.size() && deferred_[next_deferred_].index == 0)
+    ++next_deferred_;
+  pos_ = reached_ = 0;
+  buffered_ = true;
+}
+
+void lexer::buffer_tokens(unsigned threads)
+{
+  if(buffered_)
+    return;
+
+  // the current token becomes the first one, its errors are out already
+  buffer_.assign(1, token_.first);
+  deferred_.clear();
+  for(auto i = own_errors_; i < errors_.size(); ++i)
+    deferred_.push_back(deferred_diag{0, true, errors_[i]});
+  next_deferred_ = deferred_.size();
+
+  if(token_.first.type != token_type::T_EOF) {
+    const char* rest = token_.first.start + token_.first.length;
+    std::size_t chunks = 1;
+    if(strategy_ == DISPATCH)
+      chunks = std::min<std::size_t>(threads, (end_ - rest) / min_chunk_size);
+    std::vector<const char*> starts;
+    if(chunks > 1)
+      starts = find_chunk_starts(rest, end_, chunks);
+
+    if(starts.empty()) {
+      lex_range(token_, end_, buffer_, deferred_, 1, true);
+    } else {
+      // every piece but the last ends with an EOF token, which stands
+      // in for the first token of the next piece; the locations are
+      // offsets into the whole input and need no fixing up
+      starts.insert(starts.begin(), rest);
+      starts.push_back(end_);
+      std::vector<std::vector<token>> tokens(starts.size() - 1);
+      std::vector<std::vector<deferred_diag>> deferred(starts.size() - 1);
+      auto lex_piece = [&](std::size_t i) {
+        auto first = i == 0 ? token_
+          : std::make_pair(token{token_type::INVALID, llvm::StringRef{starts[i], 0}},
+                           loc(starts[i]));
+        lex_range(first, starts[i + 1], tokens[i], deferred[i], 0, false);
+      };
+      std::vector<std::thread> workers;
+      for(std::size_t i = 1; i < tokens.size(); ++i)
+        workers.emplace_back(lex_piece, i);
+      lex_piece(0);
+      for(auto& w : workers)
+        w.join();
+
+      std::size_t total = 1;
+      for(auto& t : tokens)
+        total += t.size() - 1;
+      buffer_.reserve(total + 1);
+      for(std::size_t i = 0; i < tokens.size(); ++i) {
+        auto index = static_cast<std::uint32_t>(buffer_.size());
+        for(auto d : deferred[i]) {
+          d.index += index;
+          deferred_.push_back(d);
+        }
+        // the pieces couldn't intern on their threads
+        bool last = i + 1 == tokens.size();
+        auto piece_end = last ? tokens[i].end() : tokens[i].end() - 1;
+        for(auto t = tokens[i].begin(); t != piece_end; ++t) {
+          intern(*t);
+          buffer_.push_back(*t);
+        }
+      }
+    }
+  }
+
+  pos_ = reached_ = 0;
+  buffered_ = true;
 }
 
 }
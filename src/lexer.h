@@ -1,10 +1,14 @@
 #ifndef C4_LEXER_H_
 #define C4_LEXER_H_
 
+#include <cassert>
+#include <cstdint>
 #include <utility>
 #include <tuple>
+#include <vector>
 
 #include "pos.h"
+#include "source_manager.h"
 #include "token.h"
 #include "diagnostic.h"
 
@@ -12,30 +16,127 @@ namespace c4 {
 
 class lexer
 {
-  static void next_token(std::pair<token, Pos>&, const char*);
 public:
-  lexer(const char* begin, const char* end, const char* filename) 
-    : end_(end),
-      token_(token{token_type::INVALID, llvm::StringRef{begin, 0}}, Pos{filename, 1, 1})
+  //! How a token is found. DISPATCH runs the one muncher that can
+  //! match the first character, LONGEST_MATCH runs all of them and
+  //! keeps the longest token.
+  enum strategy { DISPATCH, LONGEST_MATCH };
+
+private:
+  //! Find the token after tokenarg, before end. Every error found on
+  //! the way goes to the sink; returns the index of the first one that
+  //! belongs to the new token itself.
+  std::size_t next_token(std::pair<token, SourceLoc>&, lex_diags&,
+                         const char* end) const;
+
+  //! The location of a byte in the input.
+  SourceLoc loc(const char* p) const
+  { return SourceLoc{base_.offset + static_cast<std::uint32_t>(p - begin_)}; }
+public:
+  lexer(const char* begin, const char* end, const char* filename,
+        strategy s = DISPATCH)
+    : begin_(begin), end_(end), strategy_(s),
+      base_(source_manager::get().add_buffer(filename, begin, end)),
+      token_(token{token_type::INVALID, llvm::StringRef{begin, 0}}, base_)
   {
-    next_token(token_,end);
+    advance_token();
   }
 
-  //! Get the current token.
-  std::pair<token, Pos> get_token() const
+  //! Lex the rest of the input into a buffer. From then on the lexer
+  //! only moves an index: getting, advancing and peeking are O(1),
+  //! mark() and reset() allow backtracking, and the errors of a token
+  //! are reported when the lexer first advances to it, just like
+  //! without the buffer.
+  //! With more than one thread a large input is cut at line breaks
+  //! outside of comments and the pieces are lexed in parallel; the
+  //! tokens and errors are the same.
+  void buffer_tokens(unsigned threads = 1);
+
+  bool buffered() const { return buffered_; }
+
+  //! The input and the location of its first byte.
+  const char* begin() const { return begin_; }
+  const char* end() const { return end_; }
+  SourceLoc base() const { return base_; }
+
+  //! A buffered lexer over the tokens [first, last) of l, followed by
+  //! an EOF token. Their errors must have been reported by l already.
+  //! It shares nothing with l that changes, so it may be used on
+  //! another thread.
+  lexer(const lexer& l, std::size_t first, std::size_t last);
+
+  //! Get the current token. The reference stays valid, it always
+  //! refers to the current token.
+  const std::pair<token, SourceLoc>& get_token() const
   { return token_; }
 
   //! Advance to the next token and return it.
-  std::pair<token, Pos> advance_token()
-  { next_token(token_, end_); return get_token(); }
+  const std::pair<token, SourceLoc>& advance_token();
+
+  //! Look at the nth next token without changing the current token.
+  std::pair<token, SourceLoc> peek(std::size_t n = 1) const;
+
+  //! Whether errors were reported for the current token itself.
+  bool token_has_errors() const;
+
+  //! Remember the current token; needs the buffer.
+  std::size_t mark() const
+  { assert(buffered_ && "lexer::mark: tokens are not buffered"); return pos_; }
 
-  //! Look at the next token without changing the current token.
-  std::pair<token, Pos> peek() const // advance a copy
-  { auto t = token_; next_token(t, end_); return t; }
+  //! Go back to a token returned by mark().
+  void reset(std::size_t m)
+  {
+    assert(buffered_ && m <= reached_ && "lexer::reset: bad mark");
+    pos_ = m;
+    token_ = at(pos_);
+  }
 
 private:
+  //! An error of the buffered token with the given index.
+  struct deferred_diag
+  {
+    std::uint32_t index;
+    bool own;
+    lex_diag diag;
+  };
+
+  std::pair<token, SourceLoc> at(std::size_t i) const
+  { return std::make_pair(buffer_[i], loc(buffer_[i].start)); }
+
+  //! Take over tokens and errors lexed earlier. The first token must
+  //! be the current one.
+  void adopt_buffer(std::vector<token>&& tokens,
+                    std::vector<deferred_diag>&& deferred);
+
+  //! Lex from the end of t up to end, appending the tokens and the
+  //! EOF token at end; the errors get indices from first_index on.
+  //! Interning is only safe on the lexer's own thread.
+  void lex_range(std::pair<token, SourceLoc> t, const char* end,
+                 std::vector<token>& tokens,
+                 std::vector<deferred_diag>& deferred,
+                 std::uint32_t first_index, bool intern_names) const;
+
+  const char* begin_;
   const char* end_;
-  std::pair<token, Pos> token_;
+  strategy strategy_;
+  SourceLoc base_;
+
+  // the current token, with the buffer too
+  std::pair<token, SourceLoc> token_;
+
+  // without the buffer
+  lex_diags errors_;
+  std::size_t own_errors_ = 0;
+
+  // with the buffer
+  bool buffered_ = false;
+  std::vector<token> buffer_;          // ends with the EOF token
+  std::vector<deferred_diag> deferred_; // ordered by index
+  std::size_t pos_ = 0;
+  std::size_t reached_ = 0;  // the furthest token reported so far
+  std::size_t next_deferred_ = 0;
+
+  friend class token_cache;
 };
 
 } // c4
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <algorithm>
 
+#include <unistd.h>
+
 #include "llvm/Config/config.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/Module.h"
@@ -10,9 +12,14 @@
 #include "input.h"
 #include "util.h"
 #include "lexer.h"
+#include "token_writer.h"
+#include "token_cache.h"
 #include "parser.h"
 #include "compile.h"
+#include "ast_context.h"
 #include "ast.h"
+#include "ast_file.h"
+#include "hash_visitor.h"
 #include "print_visitor.h"
 #include "sema_visitor.h"
 #include "optimize.h"
@@ -28,15 +35,20 @@
 enum class Mode {
   TOKENIZE,
   PARSE,
+  PARSE_DECLS,
   PRINT_AST,
+  PRINT_AST_HASHES,
   COMPILE,
   OPTIMIZE
 };
 
 static void tokenize(c4::lexer& l);
-static std::unique_ptr<c4::ast_node> parse(c4::lexer& l);
-static void print_ast(c4::lexer& l);
-static std::unique_ptr<llvm::Module> build_module(c4::lexer& l, const char* name);
+static c4::ast_node* parse(c4::lexer& l, c4::ast_context& ctx, bool lazy_bodies,
+                           unsigned body_threads);
+static void print_ast(c4::ast_node* tu);
+static void print_ast_hashes(c4::ast_node* tu);
+static std::unique_ptr<llvm::Module> build_module(c4::ast_node* tu, const char* name);
+static void finish(Mode mode, c4::ast_node* tu, const char* name);
 static void write_module(const llvm::Module& m, const char* name);
 static void optimize(llvm::Module& m);
 
@@ -46,6 +58,14 @@ int main(int, char** const argv)
     char** i = argv + 1;
 
     Mode mode = Mode::COMPILE;
+    c4::input_policy policy;
+    bool input_stats = false;
+    bool lazy_bodies = false;
+    unsigned body_threads = 0; // parse bodies right away
+    unsigned lex_threads = 1;
+    std::unique_ptr<c4::token_cache> cache;
+    const char* emit_ast = nullptr;
+    const char* load_ast = nullptr;
     for (; auto const arg = *i; ++i) {
       if (arg[0] != '-') {
         break;
@@ -53,12 +73,53 @@ int main(int, char** const argv)
         mode = Mode::TOKENIZE;
       } else if (strEq(arg, "--parse")) {
         mode = Mode::PARSE;
+      } else if (strEq(arg, "--parse-decls")) {
+        mode = Mode::PARSE_DECLS;
       } else if (strEq(arg, "--print-ast")) {
         mode = Mode::PRINT_AST;
+      } else if (strEq(arg, "--print-ast-hashes")) {
+        mode = Mode::PRINT_AST_HASHES;
       } else if (strEq(arg, "--compile")) {
         mode = Mode::COMPILE;
       } else if (strEq(arg, "--optimize")) {
         mode = Mode::OPTIMIZE;
+      } else if (strEq(arg, "--lazy-bodies")) {
+        lazy_bodies = true;
+      } else if (strEq(arg, "--parse-threads")) {
+        int n = i[1] ? std::atoi(i[1]) : 0;
+        if (n < 1)
+          errorf("--parse-threads needs a positive number");
+        else
+          body_threads = static_cast<unsigned>(n);
+        if (i[1])
+          ++i;
+      } else if (strEq(arg, "--map-populate")) {
+        policy.populate = true;
+      } else if (strEq(arg, "--input-stats")) {
+        input_stats = true;
+      } else if (strEq(arg, "--lex-threads")) {
+        int n = i[1] ? std::atoi(i[1]) : 0;
+        if (n < 1)
+          errorf("--lex-threads needs a positive number");
+        else
+          lex_threads = static_cast<unsigned>(n);
+        if (i[1])
+          ++i;
+      } else if (strncmp(arg, "--token-cache=", 14) == 0) {
+        if (!arg[14])
+          errorf("--token-cache needs a directory");
+        else
+          cache = make_unique<c4::token_cache>(arg + 14);
+      } else if (strncmp(arg, "--emit-ast=", 11) == 0) {
+        if (!arg[11])
+          errorf("--emit-ast needs a file");
+        else
+          emit_ast = arg + 11;
+      } else if (strncmp(arg, "--load-ast=", 11) == 0) {
+        if (!arg[11])
+          errorf("--load-ast needs a file");
+        else
+          load_ast = arg + 11;
       } else if (strEq(arg, "-")) {
         break;
       } else if (strEq(arg, "--")) {
@@ -69,52 +130,78 @@ int main(int, char** const argv)
       }
     }
 
-    if (!*i)
+    bool checks = mode == Mode::PRINT_AST || mode == Mode::PRINT_AST_HASHES
+      || mode == Mode::COMPILE || mode == Mode::OPTIMIZE;
+    if (load_ast) {
+      if (*i)
+        errorf("--load-ast takes no input files");
+      if (!checks)
+        errorf("--load-ast only goes with --print-ast, --print-ast-hashes, --compile and --optimize");
+      if (emit_ast)
+        errorf("--emit-ast needs a source file, not --load-ast");
+    } else if (!*i) {
       errorf("no input files specified");
+    } else if (emit_ast) {
+      if (i[1])
+        errorf("--emit-ast takes a single input file");
+      if (!checks)
+        errorf("--emit-ast only goes with --print-ast, --print-ast-hashes, --compile and --optimize");
+    }
 
-    if (!hasNewErrors()) {
+    if (!hasNewErrors() && load_ast) {
+      // the tree was checked when it was saved, it goes straight on
+      try {
+        c4::input in{load_ast, policy};
+        c4::ast_context ast_ctx;
+        auto ast = c4::read_ast(in, ast_ctx);
+        if (ast.tu)
+          finish(mode, ast.tu, ast.name);
+      } catch(c4::input_error& ex) {
+        errorErrno(c4::Pos{load_ast});
+      }
+    } else if (!hasNewErrors()) {
       for (; char const *name = *i; ++i) {
         try {
-          c4::input in{name};
+          c4::input in{name, policy};
 	  c4::lexer l{in.begin(), in.end(), in.name()};
+	  // --tokenize streams the tokens unless the threads or the
+	  // cache need them buffered
+	  bool stream = mode == Mode::TOKENIZE && lex_threads == 1 && !cache;
+	  if (!stream && (!cache || !cache->load(l))) {
+	    l.buffer_tokens(lex_threads);
+	    if (cache)
+	      cache->store(l);
+	  }
           switch (mode) {
           case Mode::TOKENIZE: { 
 	    tokenize(l);  
 	    break;
           }
           case Mode::PARSE: {
-	    parse(l);
+	    c4::ast_context ast_ctx;
+	    parse(l, ast_ctx, lazy_bodies, body_threads);
             break;
           }
-          case Mode::PRINT_AST: {
-	    print_ast(l);
+          case Mode::PARSE_DECLS: {
+	    // bodies are skipped and never asked for
+	    c4::ast_context ast_ctx;
+	    c4::parser p{&l, &ast_ctx, true};
+	    p.get_ast_node();
             break;
           }
-	  case Mode::COMPILE: {
-            auto m = build_module(l, name);
-            if(m)
-              write_module(*m, name);
-	    break;
-	  }
+          case Mode::PRINT_AST:
+          case Mode::PRINT_AST_HASHES:
+	  case Mode::COMPILE:
 	  case Mode::OPTIMIZE: {
-            auto m = build_module(l, name);
-            if(m) {
-              write_module(*m, name);
-              optimize(*m);
-              // append _opt to the name
-              std::string opt_name = name;
-              if(opt_name == "-") {
-                write_module(*m, opt_name.c_str());
-              } else {
-                auto pos = opt_name.find('.');
-                if(pos == std::string::npos) {
-                  opt_name.append("_opt"); // no . in filename just append the extension
-                } else {
-                  opt_name.replace(pos, std::string::npos, "_opt");
-                }
-                write_module(*m, opt_name.c_str());
-              }
-            }
+	    c4::ast_context ast_ctx;
+	    auto tu = parse(l, ast_ctx, lazy_bodies, body_threads);
+	    // Only go on when we are syntactically error-free.
+	    if (hasErrors())
+	      break;
+	    if (emit_ast && !c4::write_ast(emit_ast, static_cast<c4::translation_unit*>(tu),
+	                                   l, name))
+	      break;
+	    finish(mode, tu, name);
 	    break;
 	  }
           }
@@ -123,6 +210,15 @@ int main(int, char** const argv)
         }
       }
     }
+
+    if (input_stats) {
+      auto const& s = c4::input::stats();
+      fprintf(stderr, "inputs: %zu mapped (%zu bytes), %zu read (%zu bytes)\n",
+              s.mapped_files, s.mapped_bytes, s.read_files, s.read_bytes);
+      if (cache)
+        fprintf(stderr, "token cache: %zu hits, %zu misses\n",
+                cache->hits(), cache->misses());
+    }
   } catch (std::exception const& e) {
     errorf("caught exception: %s", e.what());
   } catch (...) {
@@ -134,47 +230,69 @@ int main(int, char** const argv)
 
 
 void tokenize(c4::lexer& l) {
+  c4::token_writer out{STDOUT_FILENO};
   auto token = l.get_token();
-  std::cout.sync_with_stdio(false);
   while (token.first.type != c4::token_type::T_EOF) {
     if (token.first.type != c4::token_type::COMMENT 
 	&& token.first.type != c4::token_type::INVALID
-	&& token.first.errors.empty()) {
-      std::cout << token.second << ' ' << token.first << '\n';
+	&& !l.token_has_errors()) {
+      out.write(token.first, token.second);
     }
     token = l.advance_token();
   }
-  std::cout.sync_with_stdio(true);
-  std::cout.flush();
 }
 
-std::unique_ptr<c4::ast_node> parse(c4::lexer& l) {
-  c4::parser p{&l};
-  std::unique_ptr<c4::ast_node> tu{p.get_ast_node()};
+// With lazy_bodies, each body is parsed when sema first gets to it,
+// with body_threads all of them are parsed on that many threads after
+// the declarations. Either way the errors come in source order, except
+// that sema may find some before the parser finds those of a later body.
+c4::ast_node* parse(c4::lexer& l, c4::ast_context& ctx, bool lazy_bodies,
+                    unsigned body_threads) {
+  // the errors of the declarations are kept back, to be reported
+  // between those of the bodies
+  bool skip = lazy_bodies || body_threads != 0;
+  DiagnosticBuffer decl_diags;
+  c4::parser p{&l, &ctx, skip, skip ? &decl_diags : nullptr};
+  auto tu = static_cast<c4::translation_unit*>(p.get_ast_node());
+  // with errors in the declarations sema doesn't run, the bodies are
+  // only parsed for their errors
+  if(body_threads != 0 || !decl_diags.empty())
+    c4::parse_bodies(*tu, std::max(body_threads, 1u), &decl_diags);
   if(!hasErrors()) {
     c4::sema_visitor sv;
-    sv.visit(tu.get());
+    sv.visit(tu);
   }
-  return std::move(tu);
+  return tu;
 }
 
-void print_ast(c4::lexer& l) {
-  auto tu = parse(l);   
-  // Only print the AST when we are syntactically error-free.
-  if(!hasErrors()) {
-    c4::print_visitor pv{std::cout};
-    pv.visit(tu.get());
+void print_ast(c4::ast_node* tu) {
+  c4::print_visitor pv{std::cout};
+  pv.visit(tu);
+}
+
+// a line for every declaration: its hash, the one of its body and its name
+void print_ast_hashes(c4::ast_node* tu) {
+  for(auto& h : c4::hash_decls(static_cast<c4::translation_unit*>(tu))) {
+    char body[17] = "-";
+    if(h.d->has_body())
+      snprintf(body, sizeof(body), "%016llx", static_cast<unsigned long long>(h.body));
+    std::string name;
+    if(!h.d->get_name().empty()) {
+      name = h.d->get_name().c_str();
+    } else if(auto ss = c4::ast_cast<c4::struct_specifier>(h.d->get_type_specifier())) {
+      name = "struct ";
+      name += ss->get_tag().c_str();
+    }
+    printf("%016llx %-16s %s\n", static_cast<unsigned long long>(h.hash), body,
+           name.c_str());
   }
 }
 
-std::unique_ptr<llvm::Module> build_module(c4::lexer& l, const char* name) {
+std::unique_ptr<llvm::Module> build_module(c4::ast_node* tu, const char* name) {
   using namespace llvm;
-  auto tu = parse(l); // TODO this shouldn't do the parsing itself, composing stuff is cooler
-  if(hasErrors()) return nullptr;
-
   LLVMContext &ctx = getGlobalContext();
   auto m = make_unique<Module>(name, ctx);
-  if(!c4::compile(tu.get(), *m, ctx)) {
+  if(!c4::compile(tu, *m, ctx)) {
     errorf("Error during code generation!");
     return nullptr;
   }
@@ -183,6 +301,38 @@ std::unique_ptr<llvm::Module> build_module(c4::lexer& l, const char* name) {
 }
 
 
+void finish(Mode mode, c4::ast_node* tu, const char* name) {
+  if(mode == Mode::PRINT_AST) {
+    print_ast(tu);
+    return;
+  }
+  if(mode == Mode::PRINT_AST_HASHES) {
+    print_ast_hashes(tu);
+    return;
+  }
+
+  auto m = build_module(tu, name);
+  if(!m)
+    return;
+  write_module(*m, name);
+  if(mode == Mode::OPTIMIZE) {
+    optimize(*m);
+    // append _opt to the name
+    std::string opt_name = name;
+    if(opt_name == "-") {
+      write_module(*m, opt_name.c_str());
+    } else {
+      auto pos = opt_name.find('.');
+      if(pos == std::string::npos) {
+        opt_name.append("_opt"); // no . in filename just append the extension
+      } else {
+        opt_name.replace(pos, std::string::npos, "_opt");
+      }
+      write_module(*m, opt_name.c_str());
+    }
+  }
+}
+
 void write_module(const llvm::Module& m, const char* name) {
   if(strcmp(name, "-") == 0) {
     m.dump();
@@ -1,12 +1,302 @@
 #include "munchers.h"
+#include "scan.h"
+#include <array>
+#include <cstring>
 #include <vector>
 #include <algorithm>
-#include <unordered_map>
-#include <cctype>
-#include "llvm/ADT/Hashing.h"
+#include "util.h"
+
+namespace {
+
+struct keyword
+{
+  const char* text;
+  std::size_t length;
+  c4::token_type type;
+};
+
+template<std::size_t N>
+constexpr keyword kwd(const char (&text)[N], c4::token_type type)
+{ return keyword{text, N - 1, type}; }
+
+using c4::token_type;
+
+constexpr keyword keywords[] = {
+  kwd("auto", token_type::KWD_AUTO), kwd("break", token_type::KWD_BREAK), kwd("case", token_type::KWD_CASE),
+  kwd("char", token_type::KWD_CHAR), kwd("const", token_type::KWD_CONST), kwd("continue", token_type::KWD_CONTINUE),
+  kwd("default", token_type::KWD_DEFAULT), kwd("do", token_type::KWD_DO), kwd("double", token_type::KWD_DOUBLE),
+  kwd("else", token_type::KWD_ELSE), kwd("enum", token_type::KWD_ENUM), kwd("extern", token_type::KWD_EXTERN),
+  kwd("float", token_type::KWD_FLOAT), kwd("for", token_type::KWD_FOR), kwd("goto", token_type::KWD_GOTO),
+  kwd("if", token_type::KWD_IF), kwd("inline", token_type::KWD_INLINE), kwd("int", token_type::KWD_INT),
+  kwd("long", token_type::KWD_LONG), kwd("register", token_type::KWD_REGISTER),
+  kwd("restrict", token_type::KWD_RESTRICT), kwd("return", token_type::KWD_RETURN), kwd("short", token_type::KWD_SHORT),
+  kwd("signed", token_type::KWD_SIGNED), kwd("sizeof", token_type::KWD_SIZEOF), kwd("static", token_type::KWD_STATIC),
+  kwd("struct", token_type::KWD_STRUCT), kwd("switch", token_type::KWD_SWITCH), kwd("typedef", token_type::KWD_TYPEDEF),
+  kwd("union", token_type::KWD_UNION), kwd("unsigned", token_type::KWD_UNSIGNED), kwd("void", token_type::KWD_VOID),
+  kwd("volatile", token_type::KWD_VOLATILE), kwd("while", token_type::KWD_WHILE), kwd("_Alignas", token_type::KWD__ALIGNAS),
+  kwd("_Alignof", token_type::KWD__ALIGNOF), kwd("_Atomic", token_type::KWD__ATOMIC), kwd("_Bool", token_type::KWD__BOOL),
+  kwd("_Complex", token_type::KWD__COMPLEX), kwd("_Generic", token_type::KWD__GENERIC),
+  kwd("_Imaginary", token_type::KWD__IMAGINARY), kwd("_Noreturn", token_type::KWD__NORETURN),
+  kwd("_Static_assert", token_type::KWD__STATIC_ASSERT), kwd("_Thread_local", token_type::KWD__THREAD_LOCAL)
+};
+
+constexpr std::size_t num_keywords = sizeof(keywords) / sizeof(keywords[0]);
+static_assert(num_keywords == static_cast<std::size_t>(token_type::KWD__THREAD_LOCAL)
+              - static_cast<std::size_t>(token_type::KWD_AUTO) + 1,
+              "every keyword token needs an entry in keywords");
+
+constexpr std::size_t min_keyword_length = 2;  // do, if
+constexpr std::size_t max_keyword_length = 14; // _Static_assert
+constexpr std::size_t keyword_table_size = 128;
+
+// length and first character alone collide, the last character
+// separates them
+constexpr std::size_t keyword_hash(std::size_t length, unsigned char first,
+                                   unsigned char last)
+{ return (length + first * 10 + last * 3) % keyword_table_size; }
+
+constexpr std::size_t keyword_hash(const keyword& k)
+{ return keyword_hash(k.length, k.text[0], k.text[k.length - 1]); }
+
+constexpr std::size_t count_hash(std::size_t h, std::size_t i = 0)
+{ return i == num_keywords ? 0 : (keyword_hash(keywords[i]) == h) + count_hash(h, i + 1); }
+
+constexpr bool collision_free(std::size_t i = 0)
+{ return i == num_keywords || (count_hash(keyword_hash(keywords[i])) == 1 && collision_free(i + 1)); }
+
+static_assert(collision_free(), "keyword_hash maps two keywords to the same slot");
+
+// the index of the keyword in slot h plus one, 0 for an empty slot
+constexpr unsigned char find_slot(std::size_t h, std::size_t i = 0)
+{
+  return i == num_keywords ? 0
+    : keyword_hash(keywords[i]) == h ? static_cast<unsigned char>(i + 1)
+    : find_slot(h, i + 1);
+}
+
+template<std::size_t... Hs>
+constexpr std::array<unsigned char, sizeof...(Hs)>
+make_keyword_table(index_list<Hs...>)
+{ return {{ find_slot(Hs)... }}; }
+
+constexpr std::array<unsigned char, keyword_table_size> keyword_table
+  = make_keyword_table(make_index_list<keyword_table_size>::type{});
+
+
+// The punctuators and digraphs, sorted by spelling. That keeps all
+// spellings with a common prefix next to each other, which the DFA
+// below is built on.
+struct punctuator
+{
+  const char* text;
+  std::size_t length;
+  c4::token_type type;
+};
+
+template<std::size_t N>
+constexpr punctuator pct(const char (&text)[N], c4::token_type type)
+{ return punctuator{text, N - 1, type}; }
+
+constexpr punctuator punctuators[] = {
+  pct("!", token_type::PCTR_BANG), pct("!=", token_type::PCTR_NOT_EQUAL),
+  pct("#", token_type::PCTR_HASH), pct("##", token_type::PCTR_HASHASH),
+  pct("%", token_type::PCTR_MOD), pct("%:", token_type::PCTR_HASH),
+  pct("%:%:", token_type::PCTR_HASHASH), pct("%=", token_type::PCTR_MOD_ASSIGN),
+  pct("%>", token_type::PCTR_RBRACE),
+  pct("&", token_type::PCTR_BIT_AND), pct("&&", token_type::PCTR_AND),
+  pct("&=", token_type::PCTR_BIT_AND_ASSIGN),
+  pct("(", token_type::PCTR_LPAREN), pct(")", token_type::PCTR_RPAREN),
+  pct("*", token_type::PCTR_STAR), pct("*=", token_type::PCTR_MULT_ASSIGN),
+  pct("+", token_type::PCTR_PLUS), pct("++", token_type::PCTR_INCREMENT),
+  pct("+=", token_type::PCTR_PLUS_ASSIGN),
+  pct(",", token_type::PCTR_COMMA),
+  pct("-", token_type::PCTR_MINUS), pct("--", token_type::PCTR_DECREMENT),
+  pct("-=", token_type::PCTR_MINUS_ASSIGN), pct("->", token_type::PCTR_DEREF),
+  pct(".", token_type::PCTR_DOT), pct("...", token_type::PCTR_VARARGS),
+  pct("/", token_type::PCTR_SLASH), pct("/=", token_type::PCTR_DIV_ASSIGN),
+  pct(":", token_type::PCTR_COLON), pct(":>", token_type::PCTR_RBRACKET),
+  pct(";", token_type::PCTR_SEMICOLON),
+  pct("<", token_type::PCTR_LESS), pct("<%", token_type::PCTR_LBRACE),
+  pct("<:", token_type::PCTR_LBRACKET), pct("<<", token_type::PCTR_SHIFT_LEFT),
+  pct("<<=", token_type::PCTR_SHIFT_LEFT_ASSIGN), pct("<=", token_type::PCTR_LESS_THAN),
+  pct("=", token_type::PCTR_ASSIGN), pct("==", token_type::PCTR_EQUAL),
+  pct(">", token_type::PCTR_GREATER), pct(">=", token_type::PCTR_GREATER_THAN),
+  pct(">>", token_type::PCTR_SHIFT_RIGHT), pct(">>=", token_type::PCTR_SHIFT_RIGHT_ASSIGN),
+  pct("?", token_type::PCTR_QUESTIONMARK),
+  pct("[", token_type::PCTR_LBRACKET), pct("]", token_type::PCTR_RBRACKET),
+  pct("^", token_type::PCTR_POWER), pct("^=", token_type::PCTR_POWER_ASSIGN),
+  pct("{", token_type::PCTR_LBRACE),
+  pct("|", token_type::PCTR_BIT_OR), pct("|=", token_type::PCTR_BIT_OR_ASSIGN),
+  pct("||", token_type::PCTR_OR),
+  pct("}", token_type::PCTR_RBRACE), pct("~", token_type::PCTR_TILDE)
+};
+
+constexpr std::size_t num_punctuators = sizeof(punctuators) / sizeof(punctuators[0]);
+constexpr std::size_t max_punctuator_length = 4; // %:%:
+
+constexpr bool spelled_before(const punctuator& a, const punctuator& b, std::size_t i = 0)
+{
+  return i == b.length ? false
+    : i == a.length ? true
+    : a.text[i] != b.text[i] ? static_cast<unsigned char>(a.text[i]) < static_cast<unsigned char>(b.text[i])
+    : spelled_before(a, b, i + 1);
+}
+
+constexpr bool sorted(std::size_t i = 1)
+{ return i >= num_punctuators || (spelled_before(punctuators[i - 1], punctuators[i]) && sorted(i + 1)); }
+
+static_assert(sorted(), "punctuators must be sorted by spelling");
+
+constexpr bool has_spelling(token_type t, std::size_t i = 0)
+{ return i != num_punctuators && (punctuators[i].type == t || has_spelling(t, i + 1)); }
+
+constexpr bool all_spelled(int t = static_cast<int>(token_type::PCTR_LBRACKET))
+{
+  return t > static_cast<int>(token_type::PCTR_SHIFT_RIGHT_ASSIGN)
+    || (has_spelling(static_cast<token_type>(t)) && all_spelled(t + 1));
+}
+
+static_assert(all_spelled(), "every punctuator token needs an entry in punctuators");
+
+// The DFA runs on character classes: 0 for anything that is in no
+// punctuator, the index in punctuator_chars plus one otherwise.
+constexpr char punctuator_chars[] = "!#%&()*+,-./:;<=>?[]^{|}~";
+constexpr std::size_t num_classes = sizeof(punctuator_chars); // with class 0
+
+constexpr unsigned char char_class(unsigned char c, std::size_t i = 0)
+{
+  return i + 1 == sizeof(punctuator_chars) ? 0
+    : static_cast<unsigned char>(punctuator_chars[i]) == c ? static_cast<unsigned char>(i + 1)
+    : char_class(c, i + 1);
+}
+
+constexpr bool classified(const punctuator& p, std::size_t i = 0)
+{ return i == p.length || (char_class(p.text[i]) != 0 && classified(p, i + 1)); }
+
+constexpr bool all_classified(std::size_t i = 0)
+{ return i == num_punctuators || (classified(punctuators[i]) && all_classified(i + 1)); }
+
+static_assert(all_classified(), "punctuator_chars misses a character");
+
+// A state is a prefix of a spelling: the first n characters of
+// spelling i, where i is the first spelling starting with them. State
+// 0 is dead, 1 is the start, the prefixes follow ordered by (i, n).
+constexpr unsigned dead_state = 0;
+constexpr unsigned start_state = 1;
+
+constexpr bool same_prefix(std::size_t i, std::size_t j, std::size_t n, std::size_t k = 0)
+{ return k == n || (punctuators[i].text[k] == punctuators[j].text[k] && same_prefix(i, j, n, k + 1)); }
+
+constexpr bool is_state(std::size_t i, std::size_t n)
+{
+  return n >= 1 && n <= punctuators[i].length
+    && (i == 0 || punctuators[i - 1].length < n || !same_prefix(i - 1, i, n));
+}
+
+// prefixes are keyed by i * max_punctuator_length + n - 1
+constexpr std::size_t num_keys = num_punctuators * max_punctuator_length;
+
+constexpr bool key_is_state(std::size_t k)
+{ return is_state(k / max_punctuator_length, k % max_punctuator_length + 1); }
+
+constexpr std::size_t states_before(std::size_t k)
+{ return k == 0 ? 0 : key_is_state(k - 1) + states_before(k - 1); }
+
+constexpr std::size_t num_states = 2 + states_before(num_keys);
+static_assert(num_states <= 256, "punctuator states don't fit a byte");
+
+template<typename T, std::size_t N>
+struct const_table
+{
+  T values[N];
+  constexpr T operator[](std::size_t i) const { return values[i]; }
+};
+
+template<std::size_t... Ks>
+constexpr const_table<unsigned char, sizeof...(Ks)> make_state_ids(index_list<Ks...>)
+{ return {{ static_cast<unsigned char>(key_is_state(Ks) ? 2 + states_before(Ks) : dead_state)... }}; }
+
+constexpr const_table<unsigned char, num_keys> state_ids
+  = make_state_ids(make_index_list<num_keys>::type{});
+
+constexpr unsigned state_of(std::size_t i, std::size_t n)
+{ return state_ids[i * max_punctuator_length + n - 1]; }
+
+// the key of state s
+constexpr std::size_t key_of(unsigned s, std::size_t k = 0)
+{ return k == num_keys || state_ids[k] == s ? k : key_of(s, k + 1); }
+
+// Follow class c from the prefix (i, n). The spellings sharing it start
+// at i; the first one going on with c is the state for the longer
+// prefix.
+constexpr unsigned next_state(std::size_t i, std::size_t n, unsigned char c, std::size_t j)
+{
+  return j == num_punctuators || !same_prefix(i, j, n) ? dead_state
+    : punctuators[j].length > n && char_class(punctuators[j].text[n]) == c ? state_of(j, n + 1)
+    : next_state(i, n, c, j + 1);
+}
+
+constexpr unsigned char transition(unsigned s, unsigned char c)
+{
+  return static_cast<unsigned char>(
+    s == dead_state || c == 0 ? dead_state
+    : s == start_state ? next_state(0, 0, c, 0)
+    : next_state(key_of(s) / max_punctuator_length, key_of(s) % max_punctuator_length + 1,
+                 c, key_of(s) / max_punctuator_length));
+}
+
+// the sorting puts a spelling before everything it is a prefix of
+constexpr token_type accept(unsigned s)
+{
+  return s < 2 || punctuators[key_of(s) / max_punctuator_length].length
+                  != key_of(s) % max_punctuator_length + 1
+    ? token_type::INVALID
+    : punctuators[key_of(s) / max_punctuator_length].type;
+}
+
+template<std::size_t... Es>
+constexpr std::array<unsigned char, sizeof...(Es)> make_transitions(index_list<Es...>)
+{ return {{ transition(Es / num_classes, Es % num_classes)... }}; }
+
+template<std::size_t... Ss>
+constexpr std::array<token_type, sizeof...(Ss)> make_accepts(index_list<Ss...>)
+{ return {{ accept(Ss)... }}; }
+
+template<std::size_t... Cs>
+constexpr std::array<unsigned char, sizeof...(Cs)> make_char_classes(index_list<Cs...>)
+{ return {{ char_class(Cs)... }}; }
+
+// the next state for a state and a character class
+constexpr std::array<unsigned char, num_states * num_classes> transitions
+  = make_transitions(make_index_list<num_states * num_classes>::type{});
+
+// the punctuator a state has matched, or INVALID
+constexpr std::array<token_type, num_states> accepts
+  = make_accepts(make_index_list<num_states>::type{});
+
+constexpr std::array<unsigned char, 256> char_classes
+  = make_char_classes(make_index_list<256>::type{});
+
+}
 
 namespace c4 {
 
+token_type
+keyword_or_identifier(const llvm::StringRef& s)
+{
+  if(s.size() < min_keyword_length || s.size() > max_keyword_length)
+    return token_type::IDENTIFIER;
+
+  auto slot = keyword_table[keyword_hash(s.size(), s.front(), s.back())];
+  if(slot == 0)
+    return token_type::IDENTIFIER;
+
+  const keyword& k = keywords[slot - 1];
+  if(k.length == s.size() && std::memcmp(k.text, s.data(), s.size()) == 0)
+    return k.type;
+  return token_type::IDENTIFIER;
+}
+
 token
 string_muncher::operator()(const char* begin, const char* end) const
 {
@@ -22,7 +312,6 @@ string_muncher::operator()(const char* begin, const char* end) const
 
   const char* backup = begin;
   bool terminated = false;
-  std::vector<std::string> errs;
   char delim = *begin++;
   std::size_t length = 0;
   while(begin != end) {
@@ -45,10 +334,8 @@ string_muncher::operator()(const char* begin, const char* end) const
         break;
       }
 
-      if(!is_escape(*begin)) {
-        errs.push_back("unknown escape sequence \\");
-        errs.back().push_back(*begin);
-      }
+      if(!is_escape(*begin))
+        errors->push_back(lex_diag{lex_error::UNKNOWN_ESCAPE, *begin});
     }
     ++begin;
     ++length;
@@ -56,61 +343,39 @@ string_muncher::operator()(const char* begin, const char* end) const
 
   if(!terminated) {
     if(delim == '\'')
-      errs.emplace_back("missing terminating ' character");
+      errors->push_back(lex_diag{lex_error::MISSING_TERMINATING_QUOTE, 0});
     else
-      errs.emplace_back("missing terminating \" character");
+      errors->push_back(lex_diag{lex_error::MISSING_TERMINATING_DQUOTE, 0});
   }
 
   if(delim == '\'' && length != 1) {
-    errs.emplace_back("invalid length character constant");
+    errors->push_back(lex_diag{lex_error::INVALID_CHAR_LENGTH, 0});
   }
 
   if(delim == '\'')
-    return token{token_type::CHARACTER_CONSTANT, llvm::StringRef{backup, static_cast<std::size_t>(begin - backup)},
-        std::move(errs)};
+    return token{token_type::CHARACTER_CONSTANT, llvm::StringRef{backup, static_cast<std::size_t>(begin - backup)}};
   else
-    return token{token_type::STRING_LITERAL, llvm::StringRef{backup, static_cast<std::size_t>(begin - backup)},
-        std::move(errs)};
+    return token{token_type::STRING_LITERAL, llvm::StringRef{backup, static_cast<std::size_t>(begin - backup)}};
 }
 
 token
-comment_muncher::impl(const char* begin, const char* end)
+comment_muncher::impl(const char* begin, const char* end) const
 {
   const char* start = begin;
   ++begin;
   bool fcstyle = (*begin == '*');
   ++begin;
-  cols = 2;
 
   if(!fcstyle) {
-    while(begin != end && *begin != '\n' && *begin != '\r')
-      ++begin;
+    begin = scan().find_line_end(begin, end);
     return token{token_type::COMMENT, llvm::StringRef{start, static_cast<std::size_t>(begin - start)}};
   } else {
-    bool star = (*begin == '*');
-    while(begin != end && !(star && *begin == '/')) {
-      star = (*begin == '*');
-      if(*begin == '\n' || *begin == '\r') {
-        ++lines; cols = 0;
-        auto it = std::next(begin);
-        if(it != end && ((*begin == '\n' && *it == '\r') || (*begin == '\r' && *it == '\n')))
-          begin = ++it;
-        else
-          ++begin;
-      } else {
-        ++begin;
-        ++cols;
-      }
-    }
-
+    begin = scan().find_comment_end(begin, end);
     if(begin != end) { // this comment is terminated
-      auto t = token{token_type::COMMENT, llvm::StringRef{start, static_cast<std::size_t>(begin - start + 1)}};
-      ++cols;
-      return t;
+      return token{token_type::COMMENT, llvm::StringRef{start, static_cast<std::size_t>(begin - start + 1)}};
     } else { // this comment is unterminated
-      auto t = token{token_type::COMMENT, llvm::StringRef{start, static_cast<std::size_t>(begin - start)}};
-      t.errors.emplace_back("unterminated comment");
-      return t;
+      errors->push_back(lex_diag{lex_error::UNTERMINATED_COMMENT, 0});
+      return token{token_type::COMMENT, llvm::StringRef{start, static_cast<std::size_t>(begin - start)}};
     }
   }
 }
@@ -121,17 +386,12 @@ decimal_muncher::operator()(const char* b, const char* end) const
   if(b == end) return token{token_type::INVALID, llvm::StringRef{}};
 
   char ch = *b;
-  if (!std::isdigit(ch))
+  if(first_char_muncher(ch) != muncher_kind::DECIMAL)
     return token{token_type::INVALID, llvm::StringRef{}};
   if(ch == '0')
     return token{token_type::INTEGER_CONSTANT, llvm::StringRef{b, 1}};
 
-  const char* begin = b;
-
-  while(++begin != end) {
-    if (!std::isdigit(*begin))
-      break;
-  }
+  const char* begin = scan().skip_digits(b + 1, end);
 
   return token{token_type::INTEGER_CONSTANT, llvm::StringRef{b, static_cast<std::size_t>(begin - b)}};
 }
@@ -139,184 +399,39 @@ decimal_muncher::operator()(const char* b, const char* end) const
 token
 identifier_muncher::operator()(const char* b, const char* end) const
 {
-  auto isnondigit = [](const char& c)
-    { return std::isalpha(c) || c == '_'; };
-  auto isnondigitordigit = [](const char& c)
-    { return std::isalnum(c) || c == '_'; };
-
-  static auto shash = [](const llvm::StringRef& r) -> std::size_t { return llvm::hash_value(r); };
-  static std::unordered_map<llvm::StringRef, token_type, decltype(shash)>
-    kwd_map = {
-    {{"auto", token_type::KWD_AUTO}, {"break", token_type::KWD_BREAK}, {"case", token_type::KWD_CASE},
-     {"char", token_type::KWD_CHAR}, {"const", token_type::KWD_CONST}, {"continue", token_type::KWD_CONTINUE},
-     {"default", token_type::KWD_DEFAULT}, {"do", token_type::KWD_DO}, {"double", token_type::KWD_DOUBLE},
-     {"else", token_type::KWD_ELSE}, {"enum", token_type::KWD_ENUM}, {"extern", token_type::KWD_EXTERN},
-     {"float", token_type::KWD_FLOAT}, {"for", token_type::KWD_FOR}, {"goto", token_type::KWD_GOTO},
-     {"if", token_type::KWD_IF}, {"inline", token_type::KWD_INLINE}, {"int", token_type::KWD_INT},
-     {"long", token_type::KWD_LONG}, {"register", token_type::KWD_REGISTER},
-     {"restrict", token_type::KWD_RESTRICT}, {"return", token_type::KWD_RETURN}, {"short", token_type::KWD_SHORT},
-     {"signed", token_type::KWD_SIGNED}, {"sizeof", token_type::KWD_SIZEOF}, {"static", token_type::KWD_STATIC},
-     {"struct", token_type::KWD_STRUCT}, {"switch", token_type::KWD_SWITCH}, {"typedef", token_type::KWD_TYPEDEF},
-     {"union", token_type::KWD_UNION}, {"unsigned", token_type::KWD_UNSIGNED}, {"void", token_type::KWD_VOID},
-     {"volatile", token_type::KWD_VOLATILE}, {"while", token_type::KWD_WHILE}, {"_Alignas", token_type::KWD__ALIGNAS},
-     {"_Alignof", token_type::KWD__ALIGNOF}, { "_Atomic", token_type::KWD__ATOMIC}, {"_Bool", token_type::KWD__BOOL},
-     {"_Complex", token_type::KWD__COMPLEX}, {"_Generic", token_type::KWD__GENERIC},
-     {"_Imaginary", token_type::KWD__IMAGINARY}, {"_Noreturn", token_type::KWD__NORETURN},
-     {"_Static_assert", token_type::KWD__STATIC_ASSERT}, {"_Thread_local", token_type::KWD__THREAD_LOCAL}},
-    static_cast<int>(token_type::KWD__THREAD_LOCAL) - static_cast<int>(token_type::KWD_AUTO), shash
-  }; // map from keywords to the respective enums
-
-
-  if(b == end || !isnondigit(*b))
+  if(b == end || first_char_muncher(*b) != muncher_kind::IDENTIFIER)
     return token{token_type::INVALID, llvm::StringRef{}};
 
-  const char* begin = b;
+  const char* begin = scan().skip_identifier(b + 1, end);
 
-  while(begin != end) {
-    if(isnondigitordigit(*begin))
-      ++begin;
-    else
+  llvm::StringRef ref{b, static_cast<std::size_t>(begin - b)};
+  return token{keyword_or_identifier(ref), ref};
+}
+
+std::pair<token_type, std::size_t>
+match_punctuator(const char* begin, const char* end)
+{
+  token_type type = token_type::INVALID;
+  std::size_t length = 0;
+  unsigned state = start_state;
+  for(const char* p = begin; p != end; ) {
+    state = transitions[state * num_classes + char_classes[static_cast<unsigned char>(*p)]];
+    if(state == dead_state)
       break;
+    ++p;
+    if(accepts[state] != token_type::INVALID) {
+      type = accepts[state];
+      length = static_cast<std::size_t>(p - begin);
+    }
   }
-
-  llvm::StringRef ref{b, static_cast<std::size_t>(begin - b)};
-  auto it = kwd_map.find(ref);
-  if(it != kwd_map.end())
-    return token{it->second, ref};
-  else
-    return token{token_type::IDENTIFIER, ref};
+  return std::make_pair(type, length);
 }
 
 token
 punctuator_muncher::operator()(const char* begin, const char* end) const
 {
-  const char* start = begin;
-  switch(*begin) {
-  case '[': return token{token_type::PCTR_LBRACKET, llvm::StringRef{start, 1}};
-  case ']': return token{token_type::PCTR_RBRACKET, llvm::StringRef{start, 1}};
-  case '(': return token{token_type::PCTR_LPAREN, llvm::StringRef{start, 1}};
-  case ')': return token{token_type::PCTR_RPAREN, llvm::StringRef{start, 1}};
-  case '{': return token{token_type::PCTR_LBRACE, llvm::StringRef{start, 1}};
-  case '}': return token{token_type::PCTR_RBRACE, llvm::StringRef{start, 1}};
-  case ';': return token{token_type::PCTR_SEMICOLON, llvm::StringRef{start, 1}};
-  case '~': return token{token_type::PCTR_TILDE, llvm::StringRef{start, 1}};
-  case ',': return token{token_type::PCTR_COMMA, llvm::StringRef{start, 1}};
-  case '?': return token{token_type::PCTR_QUESTIONMARK, llvm::StringRef{start, 1}};
-  case '*': ++begin; if(begin != end && *begin == '=') { return token{token_type::PCTR_MULT_ASSIGN, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_STAR, llvm::StringRef{start, 1}};
-  case '=': ++begin; if(begin != end && *begin == '=') { return token{token_type::PCTR_EQUAL, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_ASSIGN, llvm::StringRef{start, 1}};
-  case '#': ++begin; if(begin != end && *begin == '#') { return token{token_type::PCTR_HASHASH, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_HASH, llvm::StringRef{start, 1}};
-  case '!': ++begin; if(begin != end && *begin == '=') { return token{token_type::PCTR_NOT_EQUAL, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_BANG, llvm::StringRef{start, 1}};
-  case '/': ++begin; if(begin != end && *begin == '=') { return token{token_type::PCTR_DIV_ASSIGN, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_SLASH, llvm::StringRef{start, 1}};
-  case '^': ++begin; if(begin != end && *begin == '=') { return token{token_type::PCTR_POWER_ASSIGN, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_POWER, llvm::StringRef{start, 1}};
-  case ':': ++begin; if(begin != end && *begin == '>') { return token{token_type::PCTR_RBRACKET, llvm::StringRef{start, 2}}; }
-    else return token{token_type::PCTR_COLON, llvm::StringRef{start, 1}};
-  case '.': {
-    ++begin;
-    if(begin != end && *begin == '.') {
-      ++begin;
-      if(begin != end && *begin == '.') return token{token_type::PCTR_VARARGS, llvm::StringRef{start, 3}};
-      else return token{token_type::PCTR_DOT, llvm::StringRef{start, 1}};
-    } else {
-      return token{token_type::PCTR_DOT, llvm::StringRef{start, 1}};
-    }
-  }
-  case '&': {
-    ++begin;
-    if(begin != end && *begin == '&')
-      return token{token_type::PCTR_AND, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '=')
-      return token{token_type::PCTR_BIT_AND_ASSIGN, llvm::StringRef{start, 2}};
-    else
-      return token{token_type::PCTR_BIT_AND, llvm::StringRef{start, 1}};
-  }
-  case '+': {
-    ++begin;
-    if(begin != end && *begin == '+')
-      return token{token_type::PCTR_INCREMENT, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '=')
-      return token{token_type::PCTR_PLUS_ASSIGN, llvm::StringRef{start, 2}};
-    else
-      return token{token_type::PCTR_PLUS, llvm::StringRef{start, 1}};
-  }
-  case '-': {
-    ++begin;
-    if(begin != end && *begin == '-')
-      return token{token_type::PCTR_DECREMENT, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '=')
-      return token{token_type::PCTR_MINUS_ASSIGN, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '>')
-      return token{token_type::PCTR_DEREF, llvm::StringRef{start, 2}};
-    else
-      return token{token_type::PCTR_MINUS, llvm::StringRef{start, 1}};
-  }
-  case '%': {
-    ++begin;
-    if(begin != end && *begin == '=') {
-      return token{token_type::PCTR_MOD_ASSIGN, llvm::StringRef{start, 2}};
-    } else if(begin != end && *begin == '>') {
-      return token{token_type::PCTR_RBRACE, llvm::StringRef{start, 2}};
-    } else if(begin != end && *begin == ':') {
-      ++begin;
-      if(begin != end && *begin == '%') {
-        ++begin;
-        if(begin != end && *begin == ':') {
-          return token{token_type::PCTR_HASHASH, llvm::StringRef{start, 4}};
-        } else {
-          return token{token_type::PCTR_HASH, llvm::StringRef{start, 2}};
-        }
-      }
-      return token{token_type::PCTR_HASH, llvm::StringRef{start, 2}};
-    } else {
-      return token{token_type::PCTR_MOD, llvm::StringRef{start, 1}};
-    }
-  }
-  case '<': {
-    ++begin;
-    if(begin != end && *begin == '=')
-      return token{token_type::PCTR_LESS_THAN, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == ':')
-      return token{token_type::PCTR_LBRACKET, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '%')
-      return token{token_type::PCTR_LBRACE, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '<') {
-      ++begin;
-      if(begin != end && *begin == '=') {
-        return token{token_type::PCTR_SHIFT_LEFT_ASSIGN, llvm::StringRef{start, 3}};
-      }
-      return token{token_type::PCTR_SHIFT_LEFT, llvm::StringRef{start, 2}};
-    } else
-      return token{token_type::PCTR_LESS, llvm::StringRef{start, 1}};
-  }
-  case '>': {
-    ++begin;
-    if(begin != end && *begin == '=')
-      return token{token_type::PCTR_GREATER_THAN, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '>') {
-      ++begin;
-      if(begin != end && *begin == '=') {
-        return token{token_type::PCTR_SHIFT_RIGHT_ASSIGN, llvm::StringRef{start, 3}};
-      }
-      return token{token_type::PCTR_SHIFT_RIGHT, llvm::StringRef{start, 2}};
-    } else
-      return token{token_type::PCTR_GREATER, llvm::StringRef{start, 1}};
-  }
-  case '|': {
-    ++begin;
-    if(begin != end && *begin == '|')
-      return token{token_type::PCTR_OR, llvm::StringRef{start, 2}};
-    else if(begin != end && *begin == '=')
-      return token{token_type::PCTR_BIT_OR_ASSIGN, llvm::StringRef{start, 2}};
-    else
-      return token{token_type::PCTR_BIT_OR, llvm::StringRef{start, 1}};
-  }
-  default: return token{token_type::INVALID, llvm::StringRef{start, 0}};
-  }
+  auto m = match_punctuator(begin, end);
+  return token{m.first, llvm::StringRef{begin, m.second}};
 }
 
 }
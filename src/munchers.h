@@ -1,23 +1,32 @@
 #ifndef C4_MUNCHERS_
 #define C4_MUNCHERS_
 
+#include <cstddef>
+#include <utility>
+
 #include "token.h"
 
 namespace c4 {
 
 struct string_muncher
 {
+  explicit string_muncher(lex_diags& errors) : errors(&errors) {}
+
   token
   operator()(const char* begin, const char* end) const;
+
+  lex_diags* errors;
 };
 
 struct comment_muncher
 {
+  explicit comment_muncher(lex_diags& errors) : errors(&errors) {}
+
   token
-  impl(const char* begin, const char* end);
+  impl(const char* begin, const char* end) const;
 
   token
-  operator()(const char* begin, const char* end) 
+  operator()(const char* begin, const char* end) const
   {
     if(begin == end || *begin != '/') return token{token_type::INVALID, llvm::StringRef{}};
     auto next = std::next(begin);
@@ -28,8 +37,7 @@ struct comment_muncher
   }
 
 
-  unsigned int cols = 0;
-  unsigned int lines = 0;
+  lex_diags* errors;
 };
 
 struct decimal_muncher
@@ -50,6 +58,42 @@ struct punctuator_muncher
   operator()(const char* begin, const char* end) const;
 };
 
+//! The longest punctuator, digraphs included, at the start of [begin,
+//! end) as its type and length; INVALID and 0 if there is none. Runs a
+//! DFA whose tables are built at compile time.
+std::pair<token_type, std::size_t>
+match_punctuator(const char* begin, const char* end);
+
+//! The keyword spelled s, or IDENTIFIER. Looks s up in a perfect hash
+//! table built at compile time.
+token_type
+keyword_or_identifier(const llvm::StringRef& s);
+
+//! The muncher that can match a token starting with a given
+//! character. A '/' can start both a comment and a punctuator, the
+//! character after it decides.
+enum class muncher_kind : unsigned char {
+  NONE, PUNCTUATOR, IDENTIFIER, DECIMAL, STRING, SLASH
+};
+
+constexpr bool is_punctuator_start(unsigned char c) {
+  return c == '[' || c == ']' || c == '(' || c == ')' || c == '{'
+    || c == '}' || c == ';' || c == '~' || c == ',' || c == '?'
+    || c == '*' || c == '=' || c == '#' || c == '!' || c == '^'
+    || c == ':' || c == '.' || c == '&' || c == '+' || c == '-'
+    || c == '%' || c == '<' || c == '>' || c == '|';
+}
+
+constexpr muncher_kind first_char_muncher(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'
+    ? muncher_kind::IDENTIFIER
+    : c >= '0' && c <= '9' ? muncher_kind::DECIMAL
+    : c == '\'' || c == '"' ? muncher_kind::STRING
+    : c == '/' ? muncher_kind::SLASH
+    : is_punctuator_start(c) ? muncher_kind::PUNCTUATOR
+    : muncher_kind::NONE;
+}
+
 } // c4
 
 #endif /* C4_MUNCHERS_ */
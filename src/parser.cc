@@ -9,35 +9,144 @@
 #include "decl_parser.h"
 #include "stmt_parser.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <memory>
+#include <thread>
+#include <vector>
 
 c4::ast_node* c4::parser::get_ast_node() {
+  DiagnosticBuffer* old = decl_diags_ ? setDiagnosticBuffer(decl_diags_) : nullptr;
   if(possibly(token_type::T_EOF))
     errorf(t().second, "empty translation unit");
-  std::unique_ptr<translation_unit> tu{new translation_unit{}};
+  translation_unit* tu = make<translation_unit>();
   
   while(!possibly(token_type::T_EOF)) {
-    decl_parser dp{get_lexer()};
+    decl_parser dp{get_lexer(), get_context()};
     decl* declp = dp();
-    tu->add_decl(declp);
+    tu->add_decl(*get_context(), declp);
 
-    if(possibly(token_type::PCTR_LBRACE)) {
+    if(possibly(token_type::PCTR_LBRACE) && lazy_bodies_ && get_lexer()->buffered()) {
+      std::size_t begin = get_lexer()->mark();
+      skip_body();
+      std::size_t diags = decl_diags_ ? decl_diags_->size() : 0;
+      declp->set_lazy_body(make<lazy_body>(lazy_body{get_lexer(), get_context(),
+                                                     begin, get_lexer()->mark(),
+                                                     diags}));
+    } else if(possibly(token_type::PCTR_LBRACE)) {
       // this must be a function definition, but there is still the
       // question of parameter list.
-      stmt_parser sp{get_lexer()};
+      stmt_parser sp{get_lexer(), get_context()};
       stmt* s = sp();
-      comp_stmt* cs = dynamic_cast<comp_stmt*>(s);
+      comp_stmt* cs = ast_cast<comp_stmt>(s);
       if(cs != nullptr) {
         declp->set_body(cs);
       } else {
         errorf("ICE");
       }
-    } else {
-      // this must be a declaration
-      expect(token_type::PCTR_SEMICOLON);
+    } else if(!declp->get_type_specifier()) {
+      // reported already, just step over what ends it
+      if(possibly(token_type::PCTR_SEMICOLON) || possibly(token_type::PCTR_RBRACE))
+        consume();
+    } else if(!expect(token_type::PCTR_SEMICOLON)) {
+      // this must be a declaration, skip the rest of it
+      synchronize(SYNC_DECL);
+      if(possibly(token_type::PCTR_SEMICOLON))
+        consume();
     }
   }
 
-  return tu.release();
+  if(decl_diags_)
+    setDiagnosticBuffer(old);
+  return tu;
+}
+
+// step over a body by counting braces; whatever is inside is for
+// parse_body() to complain about
+void c4::parser::skip_body() {
+  std::size_t depth = 0;
+  do {
+    if(possibly(token_type::PCTR_LBRACE))
+      ++depth;
+    else if(possibly(token_type::PCTR_RBRACE))
+      --depth;
+    consume();
+  } while(depth != 0 && !possibly(token_type::T_EOF));
+}
+
+c4::comp_stmt* c4::parse_body(const lazy_body& b, ast_context& c) {
+  lexer l{*b.l, b.begin, b.end};
+  stmt_parser sp{&l, &c};
+  comp_stmt* cs = ast_cast<comp_stmt>(sp());
+  if(cs == nullptr)
+    errorf("ICE");
+  return cs;
+}
+
+void c4::parse_bodies(translation_unit& tu, unsigned threads,
+                      DiagnosticBuffer* decl_diags) {
+  std::vector<decl*> lazy;
+  for(auto& d : tu.decls())
+    if(d->get_lazy_body())
+      lazy.push_back(d.get());
+  // the errors of the declarations up to each body go before it
+  std::size_t flushed = 0;
+  auto flush_decl_diags = [&](std::size_t upto) {
+    if(decl_diags) {
+      decl_diags->flush(flushed, upto);
+      flushed = upto;
+    }
+  };
+  auto finish = [&] {
+    if(decl_diags) {
+      flush_decl_diags(decl_diags->size());
+      decl_diags->clear();
+    }
+  };
+  if(threads < 2 || lazy.size() < 2) {
+    for(auto d : lazy) {
+      flush_decl_diags(d->get_lazy_body()->diags);
+      d->get_body();
+    }
+    finish();
+    return;
+  }
+
+  // every thread parses into a context of its own and keeps the errors
+  // of each body apart, to be reported in order once all are done
+  struct result
+  {
+    comp_stmt* body;
+    DiagnosticBuffer diags;
+  };
+  std::vector<result> results(lazy.size());
+  std::vector<std::unique_ptr<ast_context>> contexts;
+  std::atomic<std::size_t> next{0};
+  auto work = [&](ast_context* c) {
+    for(std::size_t i; (i = next++) < lazy.size();) {
+      DiagnosticBuffer* old = setDiagnosticBuffer(&results[i].diags);
+      results[i].body = parse_body(*lazy[i]->get_lazy_body(), *c);
+      setDiagnosticBuffer(old);
+    }
+  };
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, lazy.size()));
+  for(unsigned i = 0; i < threads; ++i)
+    contexts.push_back(make_unique<ast_context>());
+  std::vector<std::thread> workers;
+  for(unsigned i = 1; i < threads; ++i)
+    workers.emplace_back(work, contexts[i].get());
+  work(contexts[0].get());
+  for(auto& w : workers)
+    w.join();
+
+  ast_context& c = *lazy.front()->get_lazy_body()->c;
+  for(auto& wc : contexts)
+    c.adopt(*wc);
+  for(std::size_t i = 0; i < lazy.size(); ++i) {
+    flush_decl_diags(lazy[i]->get_lazy_body()->diags);
+    lazy[i]->set_body(results[i].body);
+    results[i].diags.flush();
+  }
+  finish();
 }
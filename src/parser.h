@@ -1,21 +1,63 @@
 #ifndef C4_PARSER_H
 #define C4_PARSER_H
 
+#include <cstddef>
 #include <utility>
 #include "pos.h"
 #include "token.h"
 #include "util.h"
 #include "parser_base.h"
 
+class DiagnosticBuffer;
+
 namespace c4 {
 
 struct ast_node;
+struct comp_stmt;
+struct translation_unit;
+
+//! The tokens of a function body the parser skipped, and the context
+//! its nodes belong in.
+struct lazy_body
+{
+  const lexer* l;
+  ast_context* c;
+  std::size_t begin;
+  std::size_t end;
+  //! The errors of the declarations kept back before this body.
+  std::size_t diags;
+};
+
+//! Parse a skipped body into c; b.l is not touched.
+comp_stmt* parse_body(const lazy_body& b, ast_context& c);
+
+//! Parse every body of the unit that is still skipped. With more than
+//! one thread the bodies are parsed in parallel; they and their errors
+//! still come in source order. Errors of the declarations that were
+//! reported already come before all of these; those kept back in
+//! decl_diags are reported between the bodies, in the order parsing
+//! everything right away has. The lexer's errors in a body were found
+//! when it was skipped, they come before the body's own.
+void parse_bodies(translation_unit& tu, unsigned threads = 1,
+                  DiagnosticBuffer* decl_diags = nullptr);
 
 class parser : parser_base
 {
 public:
-  using parser_base::parser_base;
+  //! With lazy_bodies and buffered tokens, function bodies are only
+  //! brace matched; each is parsed when decl::get_body() first asks.
+  //! The errors of the declarations are kept in decl_diags if it is
+  //! given, for parse_bodies() to report with those of the bodies.
+  parser(lexer* l, ast_context* c, bool lazy_bodies = false,
+         DiagnosticBuffer* decl_diags = nullptr)
+    : parser_base(l, c), lazy_bodies_(lazy_bodies), decl_diags_(decl_diags) {}
   ast_node* get_ast_node();
+
+private:
+  void skip_body();
+
+  bool lazy_bodies_;
+  DiagnosticBuffer* decl_diags_;
 };
 
 } // c4
@@ -1,11 +1,54 @@
 #include "parser_base.h"
 #include "diagnostic.h"
 
-bool c4::parser_base::expect(const token_type& x) {
-  if(x != t().first.type) {
-    errorf(t().second, "expected token '%s', got '%s'", token_to_string(x),
-           token_to_string(t().first.type));
-    if(t().first.type == token_type::PCTR_COMMA)
+#include <array>
+
+namespace {
+
+using c4::token_type;
+using c4::parser_base;
+
+constexpr unsigned char sync_of(token_type t)
+{
+  return t == token_type::T_EOF ? parser_base::SYNC_LIST | parser_base::SYNC_DECL
+                                  | parser_base::SYNC_STMT
+    : t == token_type::PCTR_SEMICOLON || t == token_type::PCTR_RBRACE
+      ? parser_base::SYNC_LIST | parser_base::SYNC_DECL | parser_base::SYNC_STMT
+    : t == token_type::PCTR_LBRACE ? parser_base::SYNC_LIST
+    : t == token_type::KWD_VOID || t == token_type::KWD_CHAR || t == token_type::KWD_INT
+      || t == token_type::KWD_STRUCT || t == token_type::KWD_UNION
+      ? parser_base::SYNC_DECL | parser_base::SYNC_STMT
+    : t == token_type::KWD_IF || t == token_type::KWD_WHILE || t == token_type::KWD_GOTO
+      || t == token_type::KWD_BREAK || t == token_type::KWD_CONTINUE
+      || t == token_type::KWD_RETURN
+      ? parser_base::SYNC_STMT
+    : 0;
+}
+
+template<std::size_t... Ts>
+constexpr std::array<unsigned char, sizeof...(Ts)> make_syncs(index_list<Ts...>)
+{ return {{ sync_of(static_cast<token_type>(Ts))... }}; }
+
+constexpr std::array<unsigned char, c4::num_token_types> syncs
+  = make_syncs(make_index_list<c4::num_token_types>::type{});
+
+} // unnamed
+
+bool c4::parser_base::at_sync(sync_set s) const {
+  return syncs[static_cast<std::size_t>(t().first.type)] & s;
+}
+
+void c4::parser_base::synchronize(sync_set s) {
+  while(!at_sync(s))
+    consume();
+}
+
+bool c4::parser_base::expect(token_type x) {
+  const token_pos_pair& cur = t();
+  if(x != cur.first.type) {
+    errorf(cur.second, "expected token '%s', got '%s'", token_to_string(x),
+           token_to_string(cur.first.type));
+    if(cur.first.type == token_type::PCTR_COMMA)
       consume();
     return false;
   } else {
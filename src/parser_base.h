@@ -6,6 +6,7 @@
 #include "pos.h"
 #include "lexer.h"
 #include "diagnostic.h"
+#include "ast_context.h"
 
 #include <algorithm>
 
@@ -13,17 +14,31 @@ namespace c4 {
 
 struct parser_base
 {
-  parser_base(lexer* l) : l_(nonNull(l)) {}
+  parser_base(lexer* l, ast_context* c) : l_(nonNull(l)), c_(nonNull(c)) {}
+
+  // Panic mode recovery: after an error, tokens are skipped up to one
+  // the enclosing construct can go on from. EOF is in every set.
+  enum sync_set {
+    SYNC_LIST = 1, // ';', '{' and '}', which end any list
+    SYNC_DECL = 2, // ';', '}' and type specifiers
+    SYNC_STMT = 4  // those of SYNC_DECL and the keywords that start a statement
+  };
 protected:
-  using token_pos_pair = std::pair<token, Pos>;
+  using token_pos_pair = std::pair<token, SourceLoc>;
   
   // return if cur_token.first.type equals t. advance the token in
   // case of a match and error otherwise.
-  bool expect(const token_type& t);
+  bool expect(token_type t);
+
+  // whether the current token is in the sync set s
+  bool at_sync(sync_set s) const;
+
+  // skip to the next token in the sync set s; it is not consumed
+  void synchronize(sync_set s);
 
   // return if cur_token.first.type equals t. don't advance the
   // current state in any case.
-  inline bool possibly(const token_type& x) const
+  inline bool possibly(token_type x) const
   { return x == t().first.type; }
 
   inline void consume() 
@@ -32,11 +47,20 @@ protected:
   inline token_pos_pair peek() 
   { return l_->peek(); }
   
-  token_pos_pair t() const { return l_->get_token(); }
+  // the current token; consume() changes what it refers to, so copy
+  // what has to outlive it
+  const token_pos_pair& t() const { return l_->get_token(); }
 
   lexer* get_lexer() { return l_; }
+  ast_context* get_context() { return c_; }
+
+  // allocate a node in the context
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  { return c_->make<T>(std::forward<Args>(args)...); }
 private:
   lexer* l_;
+  ast_context* c_;
 };
 
 } // c4
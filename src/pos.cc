@@ -1,6 +1,10 @@
 #include "pos.h"
+#include "source_manager.h"
 
 #include <ostream>
 
 std::ostream& c4::operator<<(std::ostream& o, const c4::Pos& p)
 { return o << p.name << ":" << p.line << ":" << p.column << ":"; }
+
+std::ostream& c4::operator<<(std::ostream& o, c4::SourceLoc l)
+{ return o << source_manager::get().resolve(l); }
@@ -1,6 +1,7 @@
 #ifndef POS_H
 #define POS_H
 
+#include <cstdint>
 #include <iosfwd>
 
 #include "util.h"
@@ -22,5 +23,20 @@ struct Pos
 
 std::ostream& operator<<(std::ostream&, const Pos&);
 
+//! A position as a byte offset into the buffers registered with the
+//! source_manager. It is resolved to a Pos only when printed.
+struct SourceLoc
+{
+  SourceLoc() : offset(0) {}
+  explicit SourceLoc(std::uint32_t offset) : offset(offset) {}
+
+  //! The default constructed location does not point anywhere.
+  bool valid() const { return offset != 0; }
+
+  std::uint32_t offset;
+};
+
+std::ostream& operator<<(std::ostream&, SourceLoc);
+
 } // c4
 #endif
@@ -11,25 +11,32 @@ void print_visitor::print_tabs() {
     os_ << "\t";
 }
 
-bool print_visitor::stmt_or_comp_printer(stmt* s) {
-  comp_stmt* cs = dynamic_cast<comp_stmt*> (s);
+// the body of a while or an if: a compound statement goes on the line
+// of its head, anything else on a line of its own one tab further in
+bool print_visitor::open_body(stmt* s) {
+  comp_stmt* cs = ast_cast<comp_stmt>(s);
   if(!cs) {
     ++tabs_;
-    visit(s);
-    --tabs_;
   } else {
     os_ << " {";
-    handle_body(cs);
+    opened_ = cs;
   }
   return cs;
 }
 
+bool print_visitor::close_body(stmt* s) {
+  comp_stmt* cs = ast_cast<comp_stmt>(s);
+  if(!cs)
+    --tabs_;
+  return cs;
+}
+
 /////////// DECLARATIONS //////////
 
 bool print_visitor::handle(translation_unit* tu) {
   for(auto it = begin(tu->decls()); it != end(tu->decls()); ++it) {
-    (*it)->visit(this);
-    if(it != --end(tu->decls()))
+    visit(it->get());
+    if(it != std::prev(end(tu->decls())))
       os_ << '\n';
     os_ << '\n';
   }
@@ -39,7 +46,7 @@ bool print_visitor::handle(translation_unit* tu) {
 bool print_visitor::handle(declarator* d) {
   bool p = d->pointer();
   declarator* inner = d->get_declarator();
-  std::string identifier = d->get_identifier();
+  symbol identifier = d->get_identifier();
   bool parens = p || (d->parameter_decls().size() != 0 );
 
   if(parens) 
@@ -69,7 +76,7 @@ bool print_visitor::handle(declarator* d) {
 
 bool print_visitor::handle(parameter_decl* pd) {
   if(pd->get_type_specifier()) {
-    pd->get_type_specifier()->visit(this);
+    visit(pd->get_type_specifier());
   }
 
   if(pd->get_declarator()) {
@@ -84,7 +91,7 @@ bool print_visitor::handle(decl* d) {
   if(tabs_ != 0)
     print_tabs();
 
-  d->get_type_specifier()->visit(this);
+  visit(d->get_type_specifier());
   if(d->get_declarator()) {
     os_ << ' ';
     visit(d->get_declarator());
@@ -92,7 +99,8 @@ bool print_visitor::handle(decl* d) {
 
   if(d->has_body()) {
     os_ << '\n' << '{';
-    handle_body(d->get_body());
+    opened_ = d->get_body();
+    visit(opened_);
   } else
     os_ << ';';
   
@@ -105,11 +113,11 @@ bool print_visitor::handle(type_specifier* ts) {
 }
 
 bool print_visitor::handle(type_name* tn) {
-   tn->get_type_specifier()->visit(this);
+   visit(tn->get_type_specifier());
    if(auto ad = tn->get_declarator()) {
       if (ad->pointer() || ad->get_declarator()) {
 	os_ << ' ';
-	ad->visit(this);
+	visit(ad);
       }
    }
     return false;
@@ -143,20 +151,20 @@ bool print_visitor::handle(stmt*) {
 }
 
 bool print_visitor::handle(comp_stmt* cs) {
-  print_tabs();
-  os_ << '{';
-  return handle_body(cs);
+  if(cs == opened_) {
+    opened_ = nullptr;
+  } else {
+    print_tabs();
+    os_ << '{';
+  }
+  ++tabs_;
+  return true;
 }
 
-bool print_visitor::handle_body(comp_stmt* cs) {
-  ++tabs_;
-  for(auto& x : cs->sub_stmts()) {
-    x->visit(this);
-  }
+void print_visitor::leave(comp_stmt*) {
   --tabs_;
   print_tabs();
   os_ << '}';
-  return false;
 }
 
 bool print_visitor::handle(break_stmt*) {
@@ -174,12 +182,13 @@ bool print_visitor::handle(continue_stmt*) {
 bool print_visitor::handle(return_stmt* rs) {
   print_tabs();
   os_ << "return";
-  if(auto expr = rs->expr()) {
+  if(rs->expr())
     os_ << ' ';
-    expr->visit(this);
-  }
+  return true;
+}
+
+void print_visitor::leave(return_stmt*) {
   os_ << ';';
-  return false;
 }
 
 bool print_visitor::handle(labeled_stmt* ls) {
@@ -193,65 +202,85 @@ bool print_visitor::handle(goto_stmt* gs) {
   return true;
 }
 
-bool print_visitor::handle(while_stmt* ws) {
+bool print_visitor::handle(while_stmt*) {
   print_tabs();
   os_ << "while (";
-  ws->condition()->visit(this);
+  return true;
+}
+
+void print_visitor::between(while_stmt* ws, std::size_t) {
   os_ << ')';
-  stmt_or_comp_printer(ws->body());
-  return false;
+  open_body(ws->body());
 }
 
-bool print_visitor::handle(if_stmt* is) {
-  print_tabs();
-  return handle_impl(is);
+void print_visitor::leave(while_stmt* ws) {
+  close_body(ws->body());
 }
 
-bool print_visitor::handle_impl(if_stmt* is) {
+bool print_visitor::handle(if_stmt* is) {
+  if(is == else_if_)
+    else_if_ = nullptr;
+  else
+    print_tabs();
   os_ << "if (";
-  is->condition()->visit(this);
+  return true;
+}
+
+void print_visitor::between(if_stmt* is, std::size_t) {
   os_ << ')';
-  stmt_or_comp_printer(is->body());
-  return false;
+  open_body(is->body());
 }
 
-bool print_visitor::handle(if_else_stmt* ies) {
-  print_tabs();
-  return handle_impl(ies);
+void print_visitor::leave(if_stmt* is) {
+  close_body(is->body());
 }
 
-bool print_visitor::handle_impl(if_else_stmt* ies) {
+bool print_visitor::handle(if_else_stmt* ies) {
+  if(ies == else_if_)
+    else_if_ = nullptr;
+  else
+    print_tabs();
   os_ << "if (";
-  ies->condition()->visit(this);
-  os_ << ')';
-  bool fcomp = stmt_or_comp_printer(ies->if_body());
-  if(fcomp) {
+  return true;
+}
+
+void print_visitor::between(if_else_stmt* ies, std::size_t i) {
+  if(i == 0) {
+    os_ << ')';
+    open_body(ies->if_body());
+    return;
+  }
+
+  if(close_body(ies->if_body())) {
     os_ << " else";
   } else {
     print_tabs();
     os_ << "else";
   }
 
-  if(if_stmt* eis = dynamic_cast<if_stmt*>(ies->else_body())) {
+  // an else if goes on the line of the else
+  stmt* s = ies->else_body();
+  if(ast_cast<if_stmt>(s) || ast_cast<if_else_stmt>(s)) {
     os_ << ' ';
-    handle_impl(eis);
-    return false;
-  } else if(if_else_stmt* eies =
-	    dynamic_cast<if_else_stmt*> (ies->else_body())) {
-    os_ << ' ';
-    handle_impl(eies);
-    return false;
+    else_if_ = s;
+  } else {
+    open_body(s);
   }
-  stmt_or_comp_printer(ies->else_body());
-  return false;
 }
 
-bool print_visitor::handle(expr_stmt* e) {
+void print_visitor::leave(if_else_stmt* ies) {
+  stmt* s = ies->else_body();
+  if(!ast_cast<if_stmt>(s) && !ast_cast<if_else_stmt>(s))
+    close_body(s);
+}
+
+bool print_visitor::handle(expr_stmt*) {
   print_tabs();
-  if(auto expr = e->expr())
-    expr->visit(this);
+  return true;
+}
+
+void print_visitor::leave(expr_stmt*) {
   os_ << ';';
-  return false;
 }
 
 ////////// EXPRESSIONS //////////
@@ -261,80 +290,98 @@ bool print_visitor::handle(expression*) {
 }
 
 bool print_visitor::handle(primary_expression* pe) {
-  os_ << (pe->value()).data.str();
+  os_ << (pe->value()).data().str();
   return true;
 }
 
-bool print_visitor::handle(sizeof_expr* se) {
+bool print_visitor::handle(sizeof_expr*) {
   os_ << "(sizeof ";
-  se->expr()->visit(this);
+  return true;
+}
+
+void print_visitor::leave(sizeof_expr*) {
   os_ << ')';
-  return false;
 }
 
 bool print_visitor::handle(sizeof_type* st) {
   os_ << "(sizeof(";
-  st->get_type_name()->visit(this);
+  visit(st->get_type_name());
   os_ << "))";
   return false;
 }
 
 bool print_visitor::handle(unary_operator* uo) {
   os_ << '(' << token_to_string(uo->op());
-  uo->operand()->visit(this);
+  return true;
+}
+
+void print_visitor::leave(unary_operator*) {
   os_ << ')';
-  return false;
 }
 
-bool print_visitor::handle(binary_operator* bo) {
+bool print_visitor::handle(binary_operator*) {
   os_ << '(';
-  bo->left()->visit(this);
+  return true;
+}
+
+void print_visitor::between(binary_operator* bo, std::size_t) {
   os_ << ' ' << token_to_string(bo->op()) << ' ';
-  bo->right()->visit(this);
+}
+
+void print_visitor::leave(binary_operator*) {
   os_ << ')';
-  return false;
 }
 
-bool print_visitor::handle(postfix_operator* po) {
+bool print_visitor::handle(postfix_operator*) {
   os_ << '(';
-  po->left()->visit(this);
+  return true;
+}
+
+void print_visitor::leave(postfix_operator* po) {
   os_ << token_to_string(po->op());
-  po->right()->visit(this);
+  visit(po->right());
   os_ << ')';
-  return false;
 }
 
-bool print_visitor::handle(subscript_operator* ao) {
+bool print_visitor::handle(subscript_operator*) {
   os_ << '(';
-  ao->left()->visit(this);
+  return true;
+}
+
+void print_visitor::between(subscript_operator*, std::size_t) {
   os_ << '[';
-  ao->right()->visit(this);
+}
+
+void print_visitor::leave(subscript_operator*) {
   os_ << "])";
-  return false;
 }
 
 bool print_visitor::handle(function_call* fc) {
   os_ << '(';
-  fc->get_name()->visit(this);
+  visit(fc->get_name());
   os_ << '(';
-  for(auto it = begin(fc->params()); it != end(fc->params()); ++it) {
-    (*it)->visit(this);
-    if(it != --end(fc->params()))
-      os_ << ", ";
-  }
+  return true;
+}
+
+void print_visitor::between(function_call*, std::size_t) {
+  os_ << ", ";
+}
+
+void print_visitor::leave(function_call*) {
   os_ << "))";
-  return false;
 }
 
-bool print_visitor::handle(ternary_expr* te) {
+bool print_visitor::handle(ternary_expr*) {
   os_ << '(';
-  te->test()->visit(this);
-  os_ << " ? ";
-  te->true_expr()->visit(this);
-  os_ << " : ";
-  te->false_expr()->visit(this);
+  return true;
+}
+
+void print_visitor::between(ternary_expr*, std::size_t i) {
+  os_ << (i == 0 ? " ? " : " : ");
+}
+
+void print_visitor::leave(ternary_expr*) {
   os_ << ')';
-  return false;
 }
 
 }
@@ -1,54 +1,80 @@
 #ifndef C4_PRINT_VISITOR_H
 #define C4_PRINT_VISITOR_H
 
+#include <cstddef>
 #include <iosfwd>
 
-#include "ast_fwd.h"
 #include "ast_visitor.h"
 
 namespace c4 {
 
-struct print_visitor : ast_visitor {
+struct print_visitor : ast_visitor<print_visitor> {
+  using ast_visitor<print_visitor>::handle;
+  using ast_visitor<print_visitor>::leave;
+  using ast_visitor<print_visitor>::between;
+
   print_visitor(std::ostream& os) : os_(os) {};
 
-  virtual bool handle(translation_unit*);
-  virtual bool handle(declarator*);
-  virtual bool handle(parameter_decl*);
-  virtual bool handle(decl*);
-  virtual bool handle(type_specifier*);
-  virtual bool handle(type_name*);
-  virtual bool handle(struct_specifier*);
-
-  virtual bool handle(stmt*);
-  bool handle_body(comp_stmt*);
-  virtual bool handle(comp_stmt*);
-  virtual bool handle(break_stmt*);
-  virtual bool handle(continue_stmt*);
-  virtual bool handle(return_stmt*);
-  virtual bool handle(labeled_stmt*);
-  virtual bool handle(goto_stmt*);
-  virtual bool handle(while_stmt*);
-  virtual bool handle(if_stmt*);
-  bool handle_impl(if_stmt*);
-  virtual bool handle(if_else_stmt*);
-  bool handle_impl(if_else_stmt*);
-  virtual bool handle(expr_stmt*);
-
-  virtual bool handle(expression*);
-  virtual bool handle(primary_expression*);
-  virtual bool handle(sizeof_expr*);
-  virtual bool handle(sizeof_type*);
-  virtual bool handle(unary_operator*); 
-  virtual bool handle(binary_operator*);
-  virtual bool handle(postfix_operator*);
-  virtual bool handle(subscript_operator*);
-  virtual bool handle(function_call*);
-  virtual bool handle(ternary_expr*);
+  bool handle(translation_unit*);
+  bool handle(declarator*);
+  bool handle(parameter_decl*);
+  bool handle(decl*);
+  bool handle(type_specifier*);
+  bool handle(type_name*);
+  bool handle(struct_specifier*);
+
+  bool handle(stmt*);
+  bool handle(comp_stmt*);
+  void leave(comp_stmt*);
+  bool handle(break_stmt*);
+  bool handle(continue_stmt*);
+  bool handle(return_stmt*);
+  void leave(return_stmt*);
+  bool handle(labeled_stmt*);
+  bool handle(goto_stmt*);
+  bool handle(while_stmt*);
+  void between(while_stmt*, std::size_t);
+  void leave(while_stmt*);
+  bool handle(if_stmt*);
+  void between(if_stmt*, std::size_t);
+  void leave(if_stmt*);
+  bool handle(if_else_stmt*);
+  void between(if_else_stmt*, std::size_t);
+  void leave(if_else_stmt*);
+  bool handle(expr_stmt*);
+  void leave(expr_stmt*);
+
+  bool handle(expression*);
+  bool handle(primary_expression*);
+  bool handle(sizeof_expr*);
+  void leave(sizeof_expr*);
+  bool handle(sizeof_type*);
+  bool handle(unary_operator*); 
+  void leave(unary_operator*);
+  bool handle(binary_operator*);
+  void between(binary_operator*, std::size_t);
+  void leave(binary_operator*);
+  bool handle(postfix_operator*);
+  void leave(postfix_operator*);
+  bool handle(subscript_operator*);
+  void between(subscript_operator*, std::size_t);
+  void leave(subscript_operator*);
+  bool handle(function_call*);
+  void between(function_call*, std::size_t);
+  void leave(function_call*);
+  bool handle(ternary_expr*);
+  void between(ternary_expr*, std::size_t);
+  void leave(ternary_expr*);
  private:
-  bool stmt_or_comp_printer(stmt*);
+  bool open_body(stmt*);
+  bool close_body(stmt*);
   void print_tabs();
   int tabs_ = 0;
   std::ostream& os_;
+  // a compound statement whose brace is printed already, and an if
+  // that goes on the line of its else
+  comp_stmt* opened_ = nullptr;
+  stmt* else_if_ = nullptr;
 };
 
 } // c4
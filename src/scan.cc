@@ -0,0 +1,270 @@
+#include "scan.h"
+#include "util.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define C4_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+////////// SCALAR //////////
+
+inline bool is_whitespace(char c)
+{ return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+inline bool is_digit(char c)
+{ return c >= '0' && c <= '9'; }
+
+inline bool is_identifier(char c)
+{ return is_digit(c) || c == '_' || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z'); }
+
+const char* skip_whitespace_scalar(const char* begin, const char* end)
+{
+  while(begin != end && is_whitespace(*begin))
+    ++begin;
+  return begin;
+}
+
+const char* skip_identifier_scalar(const char* begin, const char* end)
+{
+  while(begin != end && is_identifier(*begin))
+    ++begin;
+  return begin;
+}
+
+const char* skip_digits_scalar(const char* begin, const char* end)
+{
+  while(begin != end && is_digit(*begin))
+    ++begin;
+  return begin;
+}
+
+const char* find_line_end_scalar(const char* begin, const char* end)
+{
+  while(begin != end && *begin != '\n' && *begin != '\r')
+    ++begin;
+  return begin;
+}
+
+const char* find_comment_end_scalar(const char* begin, const char* end)
+{
+  if(begin == end)
+    return end;
+  for(++begin; begin != end; ++begin)
+    if(*begin == '/' && begin[-1] == '*')
+      return begin;
+  return end;
+}
+
+const c4::scan_kernels scalar_kernels = {
+  skip_whitespace_scalar, skip_identifier_scalar, skip_digits_scalar,
+  find_line_end_scalar, find_comment_end_scalar
+};
+
+#ifdef C4_SCAN_X86
+
+////////// SSE2 //////////
+
+// bytes of v in [lo, hi]; only meant for ASCII ranges, since the
+// comparisons are signed
+inline __m128i in_range(__m128i v, char lo, char hi)
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+inline __m128i eq(__m128i v, char c)
+{ return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+inline __m128i load(const char* p)
+{ return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+
+inline unsigned mask(__m128i v)
+{ return static_cast<unsigned>(_mm_movemask_epi8(v)); }
+
+const char* skip_whitespace_sse2(const char* begin, const char* end)
+{
+  for(; end - begin >= 16; begin += 16) {
+    __m128i v = load(begin);
+    unsigned m = ~mask(_mm_or_si128(eq(v, ' '), in_range(v, '\t', '\r'))) & 0xffff;
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_whitespace_scalar(begin, end);
+}
+
+const char* skip_identifier_sse2(const char* begin, const char* end)
+{
+  for(; end - begin >= 16; begin += 16) {
+    __m128i v = load(begin);
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    unsigned m = ~mask(_mm_or_si128(_mm_or_si128(in_range(v, '0', '9'), eq(v, '_')),
+                                    in_range(lower, 'a', 'z'))) & 0xffff;
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_identifier_scalar(begin, end);
+}
+
+const char* skip_digits_sse2(const char* begin, const char* end)
+{
+  for(; end - begin >= 16; begin += 16) {
+    unsigned m = ~mask(in_range(load(begin), '0', '9')) & 0xffff;
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_digits_scalar(begin, end);
+}
+
+const char* find_line_end_sse2(const char* begin, const char* end)
+{
+  for(; end - begin >= 16; begin += 16) {
+    __m128i v = load(begin);
+    unsigned m = mask(_mm_or_si128(eq(v, '\n'), eq(v, '\r')));
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return find_line_end_scalar(begin, end);
+}
+
+const char* find_comment_end_sse2(const char* begin, const char* end)
+{
+  // compare every byte with '*' and the byte after it with '/'
+  for(; end - begin >= 17; begin += 16) {
+    unsigned m = mask(eq(load(begin), '*')) & mask(eq(load(begin + 1), '/'));
+    if(m)
+      return begin + __builtin_ctz(m) + 1;
+  }
+  return find_comment_end_scalar(begin, end);
+}
+
+const c4::scan_kernels sse2_kernels = {
+  skip_whitespace_sse2, skip_identifier_sse2, skip_digits_sse2,
+  find_line_end_sse2, find_comment_end_sse2
+};
+
+////////// AVX2 //////////
+
+#define C4_AVX2 __attribute__((target("avx2")))
+
+C4_AVX2 inline __m256i in_range(__m256i v, char lo, char hi)
+{
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+C4_AVX2 inline __m256i eq(__m256i v, char c)
+{ return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+
+C4_AVX2 inline __m256i load32(const char* p)
+{ return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+
+C4_AVX2 inline unsigned mask(__m256i v)
+{ return static_cast<unsigned>(_mm256_movemask_epi8(v)); }
+
+C4_AVX2 const char* skip_whitespace_avx2(const char* begin, const char* end)
+{
+  for(; end - begin >= 32; begin += 32) {
+    __m256i v = load32(begin);
+    unsigned m = ~mask(_mm256_or_si256(eq(v, ' '), in_range(v, '\t', '\r')));
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_whitespace_sse2(begin, end);
+}
+
+C4_AVX2 const char* skip_identifier_avx2(const char* begin, const char* end)
+{
+  for(; end - begin >= 32; begin += 32) {
+    __m256i v = load32(begin);
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    unsigned m = ~mask(_mm256_or_si256(_mm256_or_si256(in_range(v, '0', '9'), eq(v, '_')),
+                                       in_range(lower, 'a', 'z')));
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_identifier_sse2(begin, end);
+}
+
+C4_AVX2 const char* skip_digits_avx2(const char* begin, const char* end)
+{
+  for(; end - begin >= 32; begin += 32) {
+    unsigned m = ~mask(in_range(load32(begin), '0', '9'));
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return skip_digits_sse2(begin, end);
+}
+
+C4_AVX2 const char* find_line_end_avx2(const char* begin, const char* end)
+{
+  for(; end - begin >= 32; begin += 32) {
+    __m256i v = load32(begin);
+    unsigned m = mask(_mm256_or_si256(eq(v, '\n'), eq(v, '\r')));
+    if(m)
+      return begin + __builtin_ctz(m);
+  }
+  return find_line_end_sse2(begin, end);
+}
+
+C4_AVX2 const char* find_comment_end_avx2(const char* begin, const char* end)
+{
+  for(; end - begin >= 33; begin += 32) {
+    unsigned m = mask(eq(load32(begin), '*')) & mask(eq(load32(begin + 1), '/'));
+    if(m)
+      return begin + __builtin_ctz(m) + 1;
+  }
+  return find_comment_end_sse2(begin, end);
+}
+
+#undef C4_AVX2
+
+const c4::scan_kernels avx2_kernels = {
+  skip_whitespace_avx2, skip_identifier_avx2, skip_digits_avx2,
+  find_line_end_avx2, find_comment_end_avx2
+};
+
+#endif // C4_SCAN_X86
+
+}
+
+namespace c4 {
+
+bool scan_isa_supported(scan_isa isa)
+{
+  switch(isa) {
+  case scan_isa::SCALAR: return true;
+#ifdef C4_SCAN_X86
+  case scan_isa::SSE2: return true;
+  case scan_isa::AVX2: return __builtin_cpu_supports("avx2");
+#else
+  case scan_isa::SSE2: return false;
+  case scan_isa::AVX2: return false;
+#endif
+  }
+  return false;
+}
+
+const scan_kernels& scan_kernels_for(scan_isa isa)
+{
+  assert(scan_isa_supported(isa) && "scan_kernels_for: unsupported isa");
+  switch(isa) {
+#ifdef C4_SCAN_X86
+  case scan_isa::SSE2: return sse2_kernels;
+  case scan_isa::AVX2: return avx2_kernels;
+#endif
+  default: return scalar_kernels;
+  }
+}
+
+const scan_kernels& scan()
+{
+  static const scan_kernels& best =
+    scan_kernels_for(scan_isa_supported(scan_isa::AVX2) ? scan_isa::AVX2
+                     : scan_isa_supported(scan_isa::SSE2) ? scan_isa::SSE2
+                     : scan_isa::SCALAR);
+  return best;
+}
+
+}
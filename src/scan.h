@@ -0,0 +1,38 @@
+#ifndef C4_SCAN_H
+#define C4_SCAN_H
+
+namespace c4 {
+
+//! The instruction sets the scanning kernels are written for.
+enum class scan_isa { SCALAR, SSE2, AVX2 };
+
+//! Kernels that find the end of a run of characters of one class. All
+//! of them take [begin, end) and return end if the run doesn't stop
+//! before it. The character classes are plain ASCII and don't depend
+//! on the locale.
+struct scan_kernels
+{
+  //! Skip ' ', \t, \v, \f, \n and \r.
+  const char* (*skip_whitespace)(const char* begin, const char* end);
+  //! Skip letters, digits and '_'.
+  const char* (*skip_identifier)(const char* begin, const char* end);
+  //! Skip decimal digits.
+  const char* (*skip_digits)(const char* begin, const char* end);
+  //! Find the first \n or \r.
+  const char* (*find_line_end)(const char* begin, const char* end);
+  //! Find the '/' of the first "*/".
+  const char* (*find_comment_end)(const char* begin, const char* end);
+};
+
+//! Whether this build and this CPU can run the kernels for isa.
+bool scan_isa_supported(scan_isa isa);
+
+//! The kernels for isa, which must be supported.
+const scan_kernels& scan_kernels_for(scan_isa isa);
+
+//! The kernels for the best supported instruction set, picked on the
+//! first call.
+const scan_kernels& scan();
+
+} // c4
+#endif /* C4_SCAN_H */
@@ -7,7 +7,6 @@
 
 #include <iosfwd>
 #include <vector>
-#include <string>
 #include <algorithm>
 #include <memory>
 
@@ -69,36 +68,36 @@ struct scope {
   }
 
   //! Retrieve a struct_specifier by tag.
-  std::shared_ptr<struct_type> get_tag(const std::string& tag) {
+  std::shared_ptr<struct_type> get_tag(symbol tag) {
     auto it = std::find_if(tag_scope_.rbegin(), tag_scope_.rend(), 
-                           [&tag](std::shared_ptr<struct_type> d) { 
+                           [tag](std::shared_ptr<struct_type> d) { 
 			     return d ? d->get_tag() == tag : false; });
     return it != tag_scope_.rend() ? *it : nullptr;
   }
 
   //! Only look in the current scope for `tag`.
   std::shared_ptr<struct_type> get_tag_in_current_scope
-  (const std::string& tag) const {
+  (symbol tag) const {
     auto it = std::find_if(tag_scope_.rbegin(), tag_scope_.rend(), 
-                           [&tag](std::shared_ptr<struct_type> d) { 
+                           [tag](std::shared_ptr<struct_type> d) { 
 			     return d ? d->get_tag() == tag : true; });
     return it == tag_scope_.rend() || *it == nullptr ? nullptr : *it;
   }
 
   //! Retrieve a decl by name.
-  base_decl* get(const std::string& name) const
+  base_decl* get(symbol name) const
   { 
     // search backwards, because we want the latest name. account for nullptr.
     auto it = std::find_if(scope_.rbegin(), scope_.rend(), 
-                           [&name](base_decl* d) { 
+                           [name](base_decl* d) { 
 			     return d ? d->get_name() == name : false; });
     return it != scope_.rend() ? *it : nullptr;
   }
 
   //! Only look in the current scope for `name`.
-  base_decl* get_in_current_scope(const std::string& name) const {
+  base_decl* get_in_current_scope(symbol name) const {
     auto it = std::find_if(scope_.rbegin(), scope_.rend(), 
-                           [&name](base_decl* d) { 
+                           [name](base_decl* d) { 
 			     return d ? d->get_name() == name : true; });
     return it == scope_.rend() || *it == nullptr ? nullptr : *it;
   }
@@ -3,30 +3,32 @@
 #include "ast.h"
 #include "type.h"
 #include "pos.h"
+#include <algorithm>
 #include <cassert>
 #include <string>
 
 namespace {
-bool handle_sizeof(c4::expression*, const std::shared_ptr<c4::type>& s_type);
-bool both_arith(c4::binary_operator* bo, 
+void handle_sizeof(c4::ast_context& c, c4::expr_id id,
+		   const std::shared_ptr<c4::type>& s_type);
+bool both_arith(std::shared_ptr<c4::type>& type, 
 		std::shared_ptr<c4::type> ltype, 
 		std::shared_ptr<c4::type> rtype);
-bool ptr_arith(c4::binary_operator* bo, 
+bool ptr_arith(std::shared_ptr<c4::type>& type, 
 	       std::shared_ptr<c4::type> ltype, 
 	       std::shared_ptr<c4::type> rtype);
-bool ptr_null(c4::binary_operator* bo, 
+bool ptr_null(std::shared_ptr<c4::type>& type, 
 	      std::shared_ptr<c4::type> ltype, 
 	      std::shared_ptr<c4::type> rtype);
-bool equal_comp_ptrs(c4::binary_operator* bo, 
+bool equal_comp_ptrs(std::shared_ptr<c4::type>& type, 
 		     std::shared_ptr<c4::type> ltype, 
 		     std::shared_ptr<c4::type> rtype);
-bool equal_obj_ptrs(c4::binary_operator* bo, 
+bool equal_obj_ptrs(std::shared_ptr<c4::type>& type, 
 		    std::shared_ptr<c4::type> ltype, 
 		    std::shared_ptr<c4::type> rtype);
-bool ptr_obj_ptr_void(c4::binary_operator* bo, 
+bool ptr_obj_ptr_void(std::shared_ptr<c4::type>& type, 
 		      std::shared_ptr<c4::type> ltype, 
 		      std::shared_ptr<c4::type> rtype);
-bool both_scalar(c4::binary_operator* bo, 
+bool both_scalar(std::shared_ptr<c4::type>& type, 
 		 std::shared_ptr<c4::type> ltype, 
 		 std::shared_ptr<c4::type> rtype);
 bool assign_compatible(const std::shared_ptr<c4::type>& ltype,
@@ -35,7 +37,8 @@ bool ternary_lcompatible(const std::shared_ptr<c4::type>& ltype,
 		       const std::shared_ptr<c4::type>& rtype);
 bool ternary_rcompatible(const std::shared_ptr<c4::type>& ltype,
 		       const std::shared_ptr<c4::type>& rtype);
-bool is_lvalue(c4::expression* left);
+bool is_lvalue(const c4::ast_context& c, c4::expr_id id);
+std::shared_ptr<c4::function_type> called_type(const std::shared_ptr<c4::type>& name);
 }
 
 namespace c4 {
@@ -50,6 +53,11 @@ bool sema_visitor::handle(parameter_decl*) {
   return true;
 }
 bool sema_visitor::handle(decl* d) {
+  if(stopped_) {
+    // only the errors of the bodies that are left still count
+    d->get_body();
+    return false;
+  }
    if(!d->has_type())
      analyze_type(d);
 
@@ -67,7 +75,7 @@ bool sema_visitor::handle(decl* d) {
       errorf(d->position(), "'%s' redeclared",
 	     d->get_name().c_str());
 
-    if(auto otherf = dynamic_cast<decl*>(other)) {
+    if(auto otherf = ast_cast<decl>(other)) {
       if(otherf->has_body() && d->has_body())
         errorf(d->position(), "'%s' redefined",
                d->get_name().c_str());
@@ -117,8 +125,16 @@ void sema_visitor::handle_functions(decl* d) {
   }
 
   if(d->has_body()) {
-    d->get_body()->visit(this);
-    check_gotos();
+    // a body the parser skipped is parsed now; with errors in it the
+    // tree is no good for checking, here or after it
+    unsigned errors = errorCount();
+    comp_stmt* body = d->get_body();
+    if(errorCount() != errors)
+      stopped_ = true;
+    if(!stopped_) {
+      visit(body);
+      check_gotos();
+    }
     assert(!function_scope_.empty());
     function_scope_.pop();
   }
@@ -127,7 +143,7 @@ void sema_visitor::handle_functions(decl* d) {
  
 void sema_visitor::check_gotos() {
   for(auto& gs : gotos_) {
-    auto it = labels_.find(&(gs->get_label()));
+    auto it = labels_.find(gs->get_label());
     if(it == labels_.end())
       errorf(gs->position(), "label '%s' used but not defined",
 	     gs->get_label().c_str());
@@ -147,13 +163,13 @@ bool sema_visitor::handle(stmt*) {
   return true;
 }
 
-bool sema_visitor::handle(comp_stmt* cs) {
+bool sema_visitor::handle(comp_stmt*) {
   scope_.enter_scope();
-  for(auto& x : cs->sub_stmts()) {
-    x->visit(this);
-  }
+  return true;
+}
+
+void sema_visitor::leave(comp_stmt*) {
   scope_.leave_scope();
-  return false;
 }
 
 bool sema_visitor::handle(break_stmt* bs) {
@@ -172,11 +188,14 @@ bool sema_visitor::handle(return_stmt* rs) {
   assert(!function_scope_.empty());
   auto ftype = as_function_type(function_scope_.top()->get_type());
   rs->exp_rtype() = ftype->return_type();
+  return true;
+}
+
+void sema_visitor::leave(return_stmt* rs) {
   if(auto rexpr = rs->expr()) {
-    rexpr->visit(this);
     auto rtype = rexpr->e_type();
     if(rtype->is_error())
-      return false;
+      return;
     else if(rs->exp_rtype()->is_void())
      errorf(rs->position(),
 	   "'return' with an expression in function returning void");
@@ -186,11 +205,10 @@ bool sema_visitor::handle(return_stmt* rs) {
   } else if(!(rs->exp_rtype()->is_void()))
     errorf(rs->position(),
 	   "'return' with no value in function returning non-void");
-  return false;
 }
 
 bool sema_visitor::handle(labeled_stmt* ls) {
-  if(!labels_.insert(std::make_pair(&(ls->get_label()), ls)).second)
+  if(!labels_.insert(std::make_pair(ls->get_label(), ls)).second)
     errorf(ls->position(), "duplicate label '%s'", ls->get_label().c_str());
   return true;
 }
@@ -200,34 +218,42 @@ bool sema_visitor::handle(goto_stmt* gs) {
   return true;
 }
 
-void sema_visitor::check_condition(expression* condition, const Pos& pos) {
-  condition->visit(this);
+void sema_visitor::check_condition(expression* condition, SourceLoc pos) {
   auto cond = condition->e_type();
   if(!(cond->is_scalar()) && !(cond->is_error()))
     errorf(pos, "used non-scalar type where scalar is required");
 }
 
-bool sema_visitor::handle(while_stmt* ws) {
+bool sema_visitor::handle(while_stmt*) {
   ++loop_count;
   scope_.enter_scope();
+  return true;
+}
+
+void sema_visitor::between(while_stmt* ws, std::size_t) {
   check_condition(ws->condition(), ws->position());
-  ws->body()->visit(this);
+}
+
+void sema_visitor::leave(while_stmt*) {
   scope_.leave_scope();
   --loop_count;
-  return false;
 }
 
-bool sema_visitor::handle(if_stmt* is) {
+bool sema_visitor::handle(if_stmt*) {
+  return true;
+}
+
+void sema_visitor::between(if_stmt* is, std::size_t) {
   check_condition(is->condition(), is->position());
-  is->body()->visit(this);
-  return false;
 }
 
-bool sema_visitor::handle(if_else_stmt* ies) {
-  check_condition(ies->condition(), ies->position());
-  ies->if_body()->visit(this);
-  ies->else_body()->visit(this);
-  return false;
+bool sema_visitor::handle(if_else_stmt*) {
+  return true;
+}
+
+void sema_visitor::between(if_else_stmt* ies, std::size_t i) {
+  if(i == 0)
+    check_condition(ies->condition(), ies->position());
 }
 
 bool sema_visitor::handle(expr_stmt*) {
@@ -236,314 +262,380 @@ bool sema_visitor::handle(expr_stmt*) {
 
 
 
-bool sema_visitor::handle(expression*) {
-  return true;
+// The run of an expression in the table is everything below it, in the
+// order the parser made it, so one pass in id order gets to every operand
+// before the expression that takes it. Only primaries and sizeof types
+// need their nodes. A call goes in two steps: its callee right after the
+// called expression, so that the arguments of a bad call are skipped,
+// and its arguments when the scan gets to the call.
+bool sema_visitor::check(expression* root) {
+  ast_context& c = root->context();
+  expr_id first = c.first_of(root->id());
+  expr_id last = root->id();
+  calls_.clear();
+  for(expr_id id = first; id <= last; ++id) {
+    if(c.entry(id).kind == ast_kind::FUNCTION_CALL)
+      calls_.emplace_back(c.operand(id, 0), id);
+  }
+  std::sort(calls_.begin(), calls_.end());
+
+  auto call = calls_.begin();
+  for(expr_id id = first; id <= last; ++id) {
+    check(c, id);
+    // a bad callee ends its call here, and that call may in turn be
+    // the callee of another one
+    while(call != calls_.end() && call->first == id) {
+      expr_id fc = call->second;
+      ++call;
+      if(check_callee(c, fc))
+        break;
+      id = fc;
+      while(call != calls_.end() && call->first < id)
+        ++call;
+    }
+  }
+  return false;
 }
 
-bool sema_visitor::handle(primary_expression* pe) {
-  switch(pe->value().type) {
+void sema_visitor::check(ast_context& c, expr_id id) {
+  switch(c.entry(id).kind) {
+  case ast_kind::PRIMARY_EXPRESSION:
+    check_primary(c, id);
+    break;
+  case ast_kind::SIZEOF_EXPR: {
+    auto otype = c.type_of(c.operand(id, 0));
+    handle_sizeof(c, id, otype);
+    break;
+  }
+  case ast_kind::SIZEOF_TYPE: {
+    auto s = static_cast<sizeof_type*>(c.expression_at(id));
+    handle_sizeof(c, id, analyze_type(s->get_type_name()));
+    break;
+  }
+  case ast_kind::UNARY_OPERATOR:
+    check_unary(c, id);
+    break;
+  case ast_kind::BINARY_OPERATOR:
+    check_binary(c, id);
+    break;
+  case ast_kind::POSTFIX_OPERATOR:
+    check_postfix(c, id);
+    break;
+  case ast_kind::SUBSCRIPT_OPERATOR:
+    check_subscript(c, id);
+    break;
+  case ast_kind::FUNCTION_CALL:
+    check_call(c, id);
+    break;
+  case ast_kind::TERNARY_EXPR:
+    check_ternary(c, id);
+    break;
+  default: // ERROR_EXPR, never seen by sema
+    break;
+  }
+}
+
+void sema_visitor::check_primary(ast_context& c, expr_id id) {
+  // the member name of a postfix operator comes right before it
+  if(id + 1 < c.expressions()
+     && c.entry(id + 1).kind == ast_kind::POSTFIX_OPERATOR
+     && c.operand(id + 1, 1) == id)
+    return;
+
+  auto& type = c.type_of(id);
+  switch(c.entry(id).op) {
   case token_type::INTEGER_CONSTANT: {
-    if(pe->value().data == "0")
-      pe->e_type() = arithmetic_type::get_zero();
+    auto pe = static_cast<primary_expression*>(c.expression_at(id));
+    if(pe->value().data() == "0")
+      type = arithmetic_type::get_zero();
     else
-      pe->e_type() = arithmetic_type::get_int();
+      type = arithmetic_type::get_int();
     break;
   }
   case token_type::CHARACTER_CONSTANT: {
-    pe->e_type() = arithmetic_type::get_int();
+    type = arithmetic_type::get_int();
     break;
   }
   case token_type::STRING_LITERAL: {
-    pe->e_type().reset(new pointer_type{arithmetic_type::get_char()});
+    type.reset(new pointer_type{arithmetic_type::get_char()});
     break;
   }
   default: { // identifier
-    auto iden_decl = scope_.get(pe->value().data);
+    auto pe = static_cast<primary_expression*>(c.expression_at(id));
+    auto iden_decl = scope_.get(pe->value().name);
     if(!iden_decl) {
-      errorf(pe->position(), "'%s' undeclared",
-	     pe->value().data.str().c_str());
-      pe->e_type() = error_type::get_error();
+      errorf(c.position_of(id), "'%s' undeclared",
+	     pe->value().data().str().c_str());
+      type = error_type::get_error();
     } else {
       assert(iden_decl->has_type());
-      pe->e_type() = iden_decl->get_type();
+      type = iden_decl->get_type();
     }
   }
   }
-  return false;
 }
 
-bool sema_visitor::handle(sizeof_expr* s) {
-  s->expr()->visit(this);
-  return handle_sizeof(s, s->expr()->e_type());
-}
-
-bool sema_visitor::handle(sizeof_type* s) {
-  return handle_sizeof(s, analyze_type(s->get_type_name()));
-}
-
-bool sema_visitor::handle(unary_operator* uo) {
-  uo->operand()->visit(this);
-  auto& otype = uo->operand()->e_type();
+void sema_visitor::check_unary(ast_context& c, expr_id id) {
+  expr_id operand = c.operand(id, 0);
+  auto& otype = c.type_of(operand);
+  auto& type = c.type_of(id);
+  token_type op = c.entry(id).op;
 
   if(otype->is_error()) {
-    uo->e_type() = otype;
-    return false;
+    type = otype;
+    return;
   }
 
-  switch(uo->op()) {
+  switch(op) {
   case token_type::PCTR_BANG:
     if(otype->is_scalar())
-      uo->e_type() = arithmetic_type::get_int();
+      type = arithmetic_type::get_int();
     break;
   case token_type::PCTR_MINUS:
     if(otype->is_arithmetic())
-      uo->e_type() = arithmetic_type::get_int();
+      type = arithmetic_type::get_int();
     break;
   case token_type::PCTR_STAR:
     if(auto ptype = as_pointer_type(otype))
-      uo->e_type() = ptype->underlying();
+      type = ptype->underlying();
     break;
   default: // PCTR_BIT_AND
-    assert(uo->op() == token_type::PCTR_BIT_AND);
-    if(otype->is_function() || is_lvalue(uo->operand()))
-      uo->e_type().reset(new pointer_type{otype});
+    assert(op == token_type::PCTR_BIT_AND);
+    if(otype->is_function() || is_lvalue(c, operand))
+      type.reset(new pointer_type{otype});
   }
 
-  if(!(uo->e_type()))  {
-    uo->e_type() = error_type::get_error();
-    errorf(uo->position(), "invalid type argument to unary '%s'",
-	   token_to_string(uo->op()));
+  if(!type)  {
+    type = error_type::get_error();
+    errorf(c.position_of(id), "invalid type argument to unary '%s'",
+	   token_to_string(op));
   }
-  return false;
 }
 
 std::pair<std::shared_ptr<type>, std::shared_ptr<type>> 
-  sema_visitor::visit_operands(expression* e, 
-			       expression* left, expression* right ) {
-  left->visit(this);
-  auto ltype = left->e_type();
-  right->visit(this);
-  auto rtype = right->e_type();
+  sema_visitor::operand_types(ast_context& c, expr_id id) {
+  auto ltype = c.type_of(c.operand(id, 0));
+  auto rtype = c.type_of(c.operand(id, 1));
 
   // ensure that subexpressions do not contain errors
   if(ltype->is_error() || rtype->is_error())
-    e->e_type() = error_type::get_error();
+    c.type_of(id) = error_type::get_error();
 
   return std::make_pair(ltype, rtype);
 }
 
-bool sema_visitor::handle(binary_operator* bo) {
+void sema_visitor::check_binary(ast_context& c, expr_id id) {
   std::shared_ptr<type> ltype, rtype;
-  std::tie(ltype, rtype) = visit_operands(bo, bo->left(), bo->right());
-  if(bo->e_type()) return false;
+  std::tie(ltype, rtype) = operand_types(c, id);
+  auto& type = c.type_of(id);
+  if(type) return;
 
-  switch(bo->op()) {
+  token_type op = c.entry(id).op;
+  switch(op) {
   case token_type::PCTR_PLUS: {
-    ptr_arith(bo, ltype, rtype) ||
-      ptr_arith(bo, rtype, ltype) ||
-      both_arith(bo, ltype, rtype);
+    ptr_arith(type, ltype, rtype) ||
+      ptr_arith(type, rtype, ltype) ||
+      both_arith(type, ltype, rtype);
     break;
   }
   case token_type::PCTR_STAR: {
-    both_arith(bo, ltype, rtype);
+    both_arith(type, ltype, rtype);
     break;
   }
   case token_type::PCTR_MINUS: {
-    both_arith(bo, ltype, rtype) ||
-      ptr_arith(bo, ltype, rtype) ||
-      equal_comp_ptrs(bo, ltype, rtype);
+    both_arith(type, ltype, rtype) ||
+      ptr_arith(type, ltype, rtype) ||
+      equal_comp_ptrs(type, ltype, rtype);
     break;
   }
   case token_type::PCTR_EQUAL:
   case token_type::PCTR_NOT_EQUAL: {
-    ptr_obj_ptr_void(bo, ltype, rtype) ||
-      ptr_null(bo, ltype, rtype) ||
-      both_arith(bo, ltype, rtype) ||
-      equal_obj_ptrs(bo, ltype, rtype);
+    ptr_obj_ptr_void(type, ltype, rtype) ||
+      ptr_null(type, ltype, rtype) ||
+      both_arith(type, ltype, rtype) ||
+      equal_obj_ptrs(type, ltype, rtype);
     break;
   }
   case token_type::PCTR_LESS: {
-    both_arith(bo, ltype, rtype) ||
-      equal_obj_ptrs(bo, ltype, rtype);
+    both_arith(type, ltype, rtype) ||
+      equal_obj_ptrs(type, ltype, rtype);
     break;
   }
   case token_type::PCTR_AND:
   case token_type::PCTR_OR: {
-    both_scalar(bo, ltype, rtype);
+    both_scalar(type, ltype, rtype);
     break;
   }
   default: { // case token_type::PCTR_ASSIGN:
-    if(ltype->is_complete() && is_lvalue(bo->left())) {
+    if(ltype->is_complete() && is_lvalue(c, c.operand(id, 0))) {
       if(assign_compatible(ltype, rtype)) {
-	bo->e_type() = ltype;
+	type = ltype;
       } else { // incompatible types
-	bo->e_type() = error_type::get_error();
-	errorf(bo->position(), "incompatible types for assignment");
+	type = error_type::get_error();
+	errorf(c.position_of(id), "incompatible types for assignment");
       }
     } else { // left operand isn't an lvalue
-      bo->e_type() = error_type::get_error();
-      errorf(bo->position(),
+      type = error_type::get_error();
+      errorf(c.position_of(id),
 	     "modifiable lvalue required as left operand of assignment");
     }
   }
   }
 
-  if(!(bo->e_type()))  {
-    bo->e_type() = error_type::get_error();
-    errorf(bo->position(), "invalid operands to binary '%s'",
-	   token_to_string(bo->op()));
+  if(!type)  {
+    type = error_type::get_error();
+    errorf(c.position_of(id), "invalid operands to binary '%s'",
+	   token_to_string(op));
   }
-  return false;
 }
 
+void sema_visitor::check_postfix(ast_context& c, expr_id id) {
+  auto ltype = c.type_of(c.operand(id, 0));
+  auto& type = c.type_of(id);
+  bool deref = c.entry(id).op == token_type::PCTR_DEREF;
+  if(ltype->is_error()) {
+    type = ltype;
+    return;
+  } 
 
-
-bool sema_visitor::handle(postfix_operator* po) {
-   po->left()->visit(this);
-   auto ltype = po->left()->e_type();
-   if(ltype->is_error()) {
-     po->e_type() = ltype;
-     return false;
-   } 
-
-  if(po->op() == token_type::PCTR_DEREF) {
+  if(deref) {
     if(!(ltype->is_pointer())) {
-      po->e_type() = error_type::get_error();
-      errorf(po->position(),
+      type = error_type::get_error();
+      errorf(c.position_of(id),
 	     "invalid type argument of '->', expected pointer to struct");
-      return false;
+      return;
     }
     ltype = as_pointer_type(ltype)->underlying();
   }
 
   if(auto lstruct = as_struct_type(ltype)) {
-    auto right = dynamic_cast<primary_expression*> (po->right());
-    auto& iden = right->value().data;
+    auto right = static_cast<primary_expression*>(c.expression_at(c.operand(id, 1)));
+    auto iden = right->value().name;
     if(auto mtype = lstruct->lookup(iden)) {
-      po->e_type() = mtype;
+      type = mtype;
     } else {
-      po->e_type() = error_type::get_error();
-      errorf(po->position(), "no member '%s' in given struct", iden.str().c_str());
+      type = error_type::get_error();
+      errorf(c.position_of(id), "no member '%s' in given struct", iden.c_str());
     }
   } else {
-    po->e_type() = error_type::get_error();
-    if(po->op() == token_type::PCTR_DEREF)
-      errorf(po->position(),
+    type = error_type::get_error();
+    if(deref)
+      errorf(c.position_of(id),
 	     "invalid type argument of '->', expected pointer to struct");
     else
-      errorf(po->position(),
+      errorf(c.position_of(id),
 	     "invalid type argument of '.', expected struct");
   }
-
-  return false;
 }
 
-bool sema_visitor::handle(subscript_operator* so) {
+void sema_visitor::check_subscript(ast_context& c, expr_id id) {
   std::shared_ptr<type> ltype, rtype;
-  std::tie(ltype, rtype) = visit_operands(so, so->left(), so->right());
-  if(so->e_type()) return false;
+  std::tie(ltype, rtype) = operand_types(c, id);
+  auto& type = c.type_of(id);
+  if(type) return;
 
   if(ltype->is_arithmetic() && rtype->pointer_to_complete()) {
-    so->e_type() = as_pointer_type(rtype)->underlying();
+    type = as_pointer_type(rtype)->underlying();
   } else if(rtype->is_arithmetic() && ltype->pointer_to_complete()) {
-    so->e_type() = as_pointer_type(ltype)->underlying();
+    type = as_pointer_type(ltype)->underlying();
   } else {
-    so->e_type() = error_type::get_error();
-    errorf(so->position(), "invalid operands for array subscripting");
+    type = error_type::get_error();
+    errorf(c.position_of(id), "invalid operands for array subscripting");
   }
-
-  return false;
 }
 
-bool sema_visitor::handle(function_call* fc) {
-  fc->get_name()->visit(this);
-  auto& name = fc->get_name()->e_type();
+// whether the called expression of call id goes to a function that takes
+// as many arguments as it gets; if not the call is done with
+bool sema_visitor::check_callee(ast_context& c, expr_id id) {
+  auto& name = c.type_of(c.operand(id, 0));
+  auto& type = c.type_of(id);
   if(name->is_error()) {
-    fc->e_type() = name;
+    type = name;
     return false;
   }
 
-  std::shared_ptr<function_type> func_name = as_function_type(name);
-  if(!func_name)
-    if(std::shared_ptr<pointer_type> ptr_func = as_pointer_type(name))
-      func_name = as_function_type(ptr_func->underlying());
-
-  if(func_name) {
-    auto& params = fc->params();
-    auto& args = func_name->arguments();
+  if(auto func_name = called_type(name)) {
+    std::size_t args = c.operand_count(id) - 1;
 
     // check that number of arguments match
-    if(params.size() != func_name->argument_size()) {
-      errorf(fc->position(),
+    if(args != func_name->argument_size()) {
+      errorf(c.position_of(id),
 	     "passed %s argument(s) to function expecting %s",
-             std::to_string(params.size()).c_str(), 
+             std::to_string(args).c_str(), 
 	     std::to_string(func_name->argument_size()).c_str());
-      fc->e_type() = error_type::get_error();
+      type = error_type::get_error();
       return false;
     }
+    return true;
+  }
 
-    bool error = false;
-    auto pit = begin(params);
-    auto ait = begin(args);
-    for(int i = 0; pit != end(params); ++pit, ++ait, ++i) {
-      (*pit)->visit(this);
-      auto& param_type = (*pit)->e_type();
-      if(param_type->is_error()) {
-	error = true;
-      } else if(!assign_compatible(*ait, param_type)) {
-	error = true;
-	errorf(fc->position(),
-	       "argument at position %s does not have expected type", 
-	       std::to_string(i).c_str());
-      }
-    }
+  type = error_type::get_error();
+  errorf(c.position_of(id),
+	 "called object that is not a function or pointer to a function");
+  return false;
+}
 
-    // set type to return type
-    fc->e_type() = error ? error_type::get_error() : func_name->return_type();
+void sema_visitor::check_call(ast_context& c, expr_id id) {
+  // only calls whose callee passed check_callee get here
+  auto func_name = called_type(c.type_of(c.operand(id, 0)));
+  assert(func_name);
+  auto& args = func_name->arguments();
 
-  } else {
-    fc->e_type() = error_type::get_error();
-    errorf(fc->position(),
-	   "called object that is not a function or pointer to a function");
+  bool error = false;
+  auto ait = begin(args);
+  for(std::size_t i = 1, n = c.operand_count(id); i != n; ++i, ++ait) {
+    auto& param_type = c.type_of(c.operand(id, i));
+    if(param_type->is_error()) {
+      error = true;
+    } else if(!assign_compatible(*ait, param_type)) {
+      error = true;
+      errorf(c.position_of(id),
+	     "argument at position %s does not have expected type", 
+	     std::to_string(i - 1).c_str());
+    }
   }
-  return false;
+
+  // set type to return type
+  c.type_of(id) = error ? error_type::get_error() : func_name->return_type();
 }
 
-bool sema_visitor::handle(ternary_expr* te) {
-  te->test()->visit(this);
-  auto& cond = te->test()->e_type();
-  std::shared_ptr<type> ltype, rtype;
-  std::tie(ltype, rtype) = visit_operands(te, te->true_expr(), te->false_expr());
+void sema_visitor::check_ternary(ast_context& c, expr_id id) {
+  auto cond = c.type_of(c.operand(id, 0));
+  auto ltype = c.type_of(c.operand(id, 1));
+  auto rtype = c.type_of(c.operand(id, 2));
+  auto& type = c.type_of(id);
   bool error = false;
 
+  // ensure that subexpressions do not contain errors
+  if(ltype->is_error() || rtype->is_error())
+    type = error_type::get_error();
+
   if(!(cond->is_scalar())) {
     error = true;
     if(!(cond->is_error()))
-      errorf(te->position(),
+      errorf(c.position_of(id),
  	     "used non-scalar type where scalar is required");
   }
   
-  if(te->e_type()) return false;
+  if(type) return;
 
   if(ltype->is_arithmetic() && rtype->is_arithmetic()) {
-    te->e_type() = arithmetic_type::get_int(); // set type to int
+    type = arithmetic_type::get_int(); // set type to int
   } else if(ternary_lcompatible(ltype, rtype)) {
-    te->e_type() = ltype; // set type to ltype
+    type = ltype; // set type to ltype
   } else if(ternary_rcompatible(ltype, rtype)) {
-    te->e_type() = rtype; // set type to rtype
+    type = rtype; // set type to rtype
   } else {
     error = true;
-    errorf(te->position(), "type mismatch in conditional expression");
+    errorf(c.position_of(id), "type mismatch in conditional expression");
   }
 
   if(error)
-    te->e_type() = error_type::get_error();
-
-  return false;
+    type = error_type::get_error();
 }
 
 linkage sema_visitor::determine_linkage(base_decl* d) {
-  if(dynamic_cast<parameter_decl*>(d)) {
+  if(ast_cast<parameter_decl>(d)) {
     return linkage::NONE;
   }
   if(function_scope_.empty()) {
@@ -556,8 +648,8 @@ std::shared_ptr<type> sema_visitor::analyze_type(base_decl* d) {
   auto ts = d->get_type_specifier();
   std::shared_ptr<type> from_ts;
 
-  if(auto ss = dynamic_cast<struct_specifier*>(ts)) {
-    bool named = !d->get_name().empty() || dynamic_cast<type_name*>(d);
+  if(auto ss = ast_cast<struct_specifier>(ts)) {
+    bool named = !d->get_name().empty() || ast_cast<type_name>(d);
     from_ts = analyze_struct(ss, named);
   } else {
     switch(ts->token) {
@@ -637,7 +729,7 @@ std::shared_ptr<type> sema_visitor::add_struct(struct_specifier* ss,
   function_scope_.push(nullptr);
   scope_.enter_scope();
   for(auto& d : ss->decls()) {
-    d->visit(this);
+    visit(d.get());
   }
   scope_.leave_scope();
   function_scope_.pop();
@@ -650,24 +742,25 @@ std::shared_ptr<type> sema_visitor::add_struct(struct_specifier* ss,
 
 namespace {
 
-bool handle_sizeof(c4::expression* s, const std::shared_ptr<c4::type>& s_type) {
+void handle_sizeof(c4::ast_context& c, c4::expr_id id,
+		   const std::shared_ptr<c4::type>& s_type) {
+  auto& type = c.type_of(id);
   if(s_type->is_error())
-    s->e_type() = s_type;
+    type = s_type;
   else if(s_type->is_function())
-    errorf(s->position(),
+    errorf(c.position_of(id),
 	   "invalid application of 'sizeof' to a function type");
   else if(!s_type->is_complete())
-    errorf(s->position(),
+    errorf(c.position_of(id),
 	   "invalid application of 'sizeof' to an incomplete type");
   else
-    s->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
 
-  if(!(s->e_type()))
-    s->e_type() = c4::error_type::get_error();
-  return false;
+  if(!type)
+    type = c4::error_type::get_error();
 }
 
-bool ptr_obj_ptr_void(c4::binary_operator* bo, 
+bool ptr_obj_ptr_void(std::shared_ptr<c4::type>& type, 
 		      std::shared_ptr<c4::type> ltype, 
 		      std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->is_pointer() && rtype->is_pointer() &&
@@ -676,66 +769,66 @@ bool ptr_obj_ptr_void(c4::binary_operator* bo,
 		(rtype->pointer_to_object() && 
 		 as_pointer_type(ltype)->underlying()->is_void())));
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int(); 
+    type = c4::arithmetic_type::get_int(); 
   return cond;
 }
 
-bool both_arith(c4::binary_operator* bo, 
+bool both_arith(std::shared_ptr<c4::type>& type, 
 		std::shared_ptr<c4::type> ltype, 
 		std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->is_arithmetic() && rtype->is_arithmetic());
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
   return cond;
 }
 
-bool both_scalar(c4::binary_operator* bo, 
+bool both_scalar(std::shared_ptr<c4::type>& type, 
 		 std::shared_ptr<c4::type> ltype, 
 		 std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->is_scalar() && rtype->is_scalar());
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
   return cond;
 }
 
-bool ptr_arith(c4::binary_operator* bo, 
+bool ptr_arith(std::shared_ptr<c4::type>& type, 
 	       std::shared_ptr<c4::type> ltype, 
 	       std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->pointer_to_complete() && rtype->is_arithmetic());
   if(cond)
-    bo->e_type() = ltype;
+    type = ltype;
   return cond;
 }
 
-bool equal_comp_ptrs(c4::binary_operator* bo, 
+bool equal_comp_ptrs(std::shared_ptr<c4::type>& type, 
 		     std::shared_ptr<c4::type> ltype, 
 		     std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->pointer_to_complete() && rtype->pointer_to_complete()
 	       && (*(as_pointer_type(ltype)->underlying())
 		   == *(as_pointer_type(rtype)->underlying())));
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
   return cond;
 }
 
-bool equal_obj_ptrs(c4::binary_operator* bo, 
+bool equal_obj_ptrs(std::shared_ptr<c4::type>& type, 
 		    std::shared_ptr<c4::type> ltype, 
 		    std::shared_ptr<c4::type> rtype) {
   bool cond = (ltype->pointer_to_object() && rtype->pointer_to_object()
 	       && (*(as_pointer_type(ltype)->underlying())
 		   == *(as_pointer_type(rtype)->underlying())));
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
   return cond;
 }
   
-bool ptr_null(c4::binary_operator* bo, 
+bool ptr_null(std::shared_ptr<c4::type>& type, 
 	      std::shared_ptr<c4::type> ltype, 
 	      std::shared_ptr<c4::type> rtype) {
   bool cond = ((ltype->is_pointer() && rtype->is_zero()) ||
 	       (rtype->is_pointer() && ltype->is_zero()));
   if(cond)
-    bo->e_type() = c4::arithmetic_type::get_int();
+    type = c4::arithmetic_type::get_int();
   return cond;
 }
 
@@ -783,20 +876,28 @@ bool assign_compatible
      lpoint && lpoint->underlying()->is_void());
 }
 
-bool is_lvalue(c4::expression* left) {
-  c4::unary_operator* uleft;
-  c4::primary_expression* pleft;
-  return
-    // is identifer
-    ((pleft = dynamic_cast<c4::primary_expression*> (left)) &&
-     pleft->value().type == c4::token_type::IDENTIFIER) ||
-    // or postfix operator
-    dynamic_cast<c4::postfix_operator*> (left) ||
-    // or array access
-    dynamic_cast<c4::subscript_operator*> (left) ||
-    // or pointer dereference
-    ((uleft = dynamic_cast<c4::unary_operator*> (left)) &&
-     uleft->op() == c4::token_type::PCTR_STAR);
+bool is_lvalue(const c4::ast_context& c, c4::expr_id id) {
+  const c4::expr_entry& e = c.entry(id);
+  switch(e.kind) {
+  case c4::ast_kind::PRIMARY_EXPRESSION: // is identifer
+    return e.op == c4::token_type::IDENTIFIER;
+  case c4::ast_kind::POSTFIX_OPERATOR: // or postfix operator
+  case c4::ast_kind::SUBSCRIPT_OPERATOR: // or array access
+    return true;
+  case c4::ast_kind::UNARY_OPERATOR: // or pointer dereference
+    return e.op == c4::token_type::PCTR_STAR;
+  default:
+    return false;
+  }
+}
+
+// the function a call goes to, directly or through a pointer
+std::shared_ptr<c4::function_type> called_type(const std::shared_ptr<c4::type>& name) {
+  std::shared_ptr<c4::function_type> func_name = c4::as_function_type(name);
+  if(!func_name)
+    if(std::shared_ptr<c4::pointer_type> ptr_func = c4::as_pointer_type(name))
+      func_name = c4::as_function_type(ptr_func->underlying());
+  return func_name;
 }
 
 
@@ -1,69 +1,91 @@
 #ifndef C4_SEMA_VISITOR_H
 #define C4_SEMA_VISITOR_H
 
-#include "ast_fwd.h"
 #include "ast_visitor.h"
 #include "scope.h"
 
 #include <memory>
 #include <string>
 #include <stack>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 struct type;
 
 namespace c4 {
 
-struct sema_visitor : ast_visitor {
-  virtual bool handle(translation_unit*);
-  virtual bool handle(declarator*);
-  virtual bool handle(parameter_decl*);
-  virtual bool handle(decl*);
-  virtual bool handle(type_specifier*);
-  virtual bool handle(struct_specifier*);
-
-  virtual bool handle(stmt*);
-  virtual bool handle(comp_stmt*);
-  virtual bool handle(break_stmt*);
-  virtual bool handle(continue_stmt*);
-  virtual bool handle(return_stmt*);
-  virtual bool handle(labeled_stmt*);
-  virtual bool handle(goto_stmt*);
-  virtual bool handle(while_stmt*);
-  virtual bool handle(if_stmt*);
-  virtual bool handle(if_else_stmt*);
-  virtual bool handle(expr_stmt*);
-
-  virtual bool handle(expression*);
-  virtual bool handle(primary_expression*);
-  virtual bool handle(sizeof_expr*);
-  virtual bool handle(sizeof_type*);
-  virtual bool handle(unary_operator*); 
-  virtual bool handle(binary_operator*);
-  virtual bool handle(postfix_operator*);
-  virtual bool handle(subscript_operator*);
-  virtual bool handle(function_call*);
-  virtual bool handle(ternary_expr*);
+struct sema_visitor : ast_visitor<sema_visitor> {
+  using ast_visitor<sema_visitor>::handle;
+  using ast_visitor<sema_visitor>::leave;
+  using ast_visitor<sema_visitor>::between;
+
+  bool handle(translation_unit*);
+  bool handle(declarator*);
+  bool handle(parameter_decl*);
+  bool handle(decl*);
+  bool handle(type_specifier*);
+  bool handle(struct_specifier*);
+
+  bool handle(stmt*);
+  bool handle(comp_stmt*);
+  bool handle(break_stmt*);
+  bool handle(continue_stmt*);
+  bool handle(return_stmt*);
+  bool handle(labeled_stmt*);
+  bool handle(goto_stmt*);
+  bool handle(while_stmt*);
+  bool handle(if_stmt*);
+  bool handle(if_else_stmt*);
+  bool handle(expr_stmt*);
+
+  // an expression is checked whole where the walk gets to it, by a scan
+  // over its run in the table of its context
+  bool handle(primary_expression* e) { return check(e); }
+  bool handle(sizeof_expr* e) { return check(e); }
+  bool handle(sizeof_type* e) { return check(e); }
+  bool handle(unary_operator* e) { return check(e); }
+  bool handle(binary_operator* e) { return check(e); }
+  bool handle(postfix_operator* e) { return check(e); }
+  bool handle(subscript_operator* e) { return check(e); }
+  bool handle(function_call* e) { return check(e); }
+  bool handle(ternary_expr* e) { return check(e); }
+
+  // the parts are checked first, these go on after them
+  void leave(comp_stmt*);
+  void leave(return_stmt*);
+  void leave(while_stmt*);
+  void between(while_stmt*, std::size_t);
+  void between(if_stmt*, std::size_t);
+  void between(if_else_stmt*, std::size_t);
 
 private:
   // context methods
   scope scope_;
   std::stack<decl*> function_scope_;
   int loop_count = 0;
+  // a body had syntax errors, nothing more is checked
+  bool stopped_ = false;
 
-  struct label_compare {
-    bool operator() (const std::string* lhs, const std::string* rhs) const {
-      return *lhs < *rhs;
-    }
-  };
-
-  std::map<const std::string*, labeled_stmt*, label_compare> labels_;
+  std::unordered_map<symbol, labeled_stmt*> labels_;
   std::vector<goto_stmt*> gotos_;
 
+  // the calls of the expression being checked, by the id of the
+  // called expression
+  std::vector<std::pair<expr_id, expr_id>> calls_;
+
+  bool check(expression* root);
+  void check(ast_context& c, expr_id id);
+  void check_primary(ast_context& c, expr_id id);
+  void check_unary(ast_context& c, expr_id id);
+  void check_binary(ast_context& c, expr_id id);
+  void check_postfix(ast_context& c, expr_id id);
+  void check_subscript(ast_context& c, expr_id id);
+  bool check_callee(ast_context& c, expr_id id);
+  void check_call(ast_context& c, expr_id id);
+  void check_ternary(ast_context& c, expr_id id);
   std::pair<std::shared_ptr<type>, std::shared_ptr<type>> 
-    visit_operands(expression*, expression*, expression*);
-  void check_condition(expression* condition, const Pos& pos);
+    operand_types(ast_context& c, expr_id id);
+  void check_condition(expression* condition, SourceLoc pos);
   void check_gotos();
   void handle_functions(decl* d);
 
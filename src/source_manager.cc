@@ -0,0 +1,128 @@
+#include "source_manager.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// record the line that starts after the line break at p and return
+// its first byte
+inline const char* line_break(const char* begin, const char* p,
+                              const char* end, std::vector<std::uint32_t>& starts)
+{
+  char c = *p++;
+  if(p != end && ((c == '\n' && *p == '\r') || (c == '\r' && *p == '\n')))
+    ++p;
+  starts.push_back(static_cast<std::uint32_t>(p - begin));
+  return p;
+}
+
+}
+
+namespace c4 {
+
+void scan_line_starts(const char* begin, const char* end,
+                      std::vector<std::uint32_t>& starts)
+{
+  auto find_line_end = scan().find_line_end;
+  const char* p = begin;
+  while((p = find_line_end(p, end)) != end)
+    p = line_break(begin, p, end, starts);
+}
+
+source_manager& source_manager::get()
+{
+  static source_manager sm;
+  return sm;
+}
+
+SourceLoc source_manager::add_buffer(const char* name, const char* begin,
+                                     const char* end)
+{
+  auto size = static_cast<std::uint64_t>(end - begin);
+  // one past the end is a valid location as well
+  if(size >= std::numeric_limits<std::uint32_t>::max() - next_base_)
+    throw std::length_error("more than 4 GiB of input");
+
+  buffers_.push_back(buffer{name, begin, end, next_base_, {}});
+  SourceLoc loc{next_base_};
+  next_base_ += static_cast<std::uint32_t>(size) + 1;
+  return loc;
+}
+
+const source_manager::buffer* source_manager::find(SourceLoc loc) const
+{
+  if(!loc.valid())
+    return nullptr;
+  auto it = std::upper_bound(buffers_.begin(), buffers_.end(), loc.offset,
+                             [](std::uint32_t o, const buffer& b) { return o < b.base; });
+  if(it == buffers_.begin())
+    return nullptr;
+  --it;
+  if(loc.offset - it->base > static_cast<std::uint32_t>(it->end - it->begin))
+    return nullptr;
+  return &*it;
+}
+
+const std::vector<std::uint32_t>& source_manager::line_starts(const buffer& b)
+{
+  auto& starts = b.line_starts;
+  if(starts.empty()) {
+    starts.push_back(0);
+    scan_line_starts(b.begin, b.end, starts);
+  }
+  return starts;
+}
+
+Pos source_manager::resolve(SourceLoc loc) const
+{
+  const buffer* b = find(loc);
+  if(!b)
+    return Pos{"<unknown>"};
+
+  auto& starts = line_starts(*b);
+  std::uint32_t offset = loc.offset - b->base;
+  auto line = std::upper_bound(starts.begin(), starts.end(), offset);
+  return Pos{b->name, static_cast<unsigned>(line - starts.begin()),
+             offset - *std::prev(line) + 1};
+}
+
+Pos source_manager::sequential_resolver::resolve(SourceLoc loc)
+{
+  auto& buffers = get().buffers_;
+  if(buffer_ == no_buffer || loc.offset < buffers[buffer_].base
+     || loc.offset - buffers[buffer_].base
+        > static_cast<std::uint32_t>(buffers[buffer_].end - buffers[buffer_].begin)) {
+    const buffer* b = get().find(loc);
+    if(!b) {
+      buffer_ = no_buffer;
+      return Pos{"<unknown>"};
+    }
+    buffer_ = static_cast<std::size_t>(b - buffers.data());
+    line_ = 0;
+  }
+
+  const buffer& b = buffers[buffer_];
+  auto& starts = line_starts(b);
+  std::uint32_t offset = loc.offset - b.base;
+  if(offset < starts[line_]) {
+    // went backwards
+    line_ = std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1;
+  } else {
+    // a few steps forward, or a search in the rest after that
+    std::size_t steps = 0;
+    while(line_ + 1 < starts.size() && starts[line_ + 1] <= offset) {
+      if(++steps == 8) {
+        line_ = std::upper_bound(starts.begin() + line_, starts.end(), offset) - starts.begin() - 1;
+        break;
+      }
+      ++line_;
+    }
+  }
+  return Pos{b.name, static_cast<unsigned>(line_ + 1), offset - starts[line_] + 1};
+}
+
+}
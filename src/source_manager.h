@@ -0,0 +1,70 @@
+#ifndef C4_SOURCE_MANAGER_H
+#define C4_SOURCE_MANAGER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "pos.h"
+
+namespace c4 {
+
+//! Owns the mapping from SourceLoc offsets to file, line and column.
+//! Every buffer gets its own range of offsets; the line starts of a
+//! buffer are only computed the first time a location in it is
+//! resolved.
+class source_manager
+{
+public:
+  //! The instance used by the lexer and the diagnostics.
+  static source_manager& get();
+
+  //! Register [begin, end) under name and return the location of its
+  //! first byte. The buffer and name must outlive every resolve of a
+  //! location in it.
+  SourceLoc add_buffer(const char* name, const char* begin, const char* end);
+
+  //! Turn a location into file, line and column. Line breaks are \n,
+  //! \r, \r\n and \n\r, like in the lexer.
+  Pos resolve(SourceLoc loc) const;
+
+private:
+  struct buffer
+  {
+    const char* name;
+    const char* begin;
+    const char* end;
+    std::uint32_t base;
+    mutable std::vector<std::uint32_t> line_starts; // empty until resolved
+  };
+
+  static constexpr std::size_t no_buffer = static_cast<std::size_t>(-1);
+
+public:
+  //! Resolves locations that mostly come in increasing order, like the
+  //! tokens of a file, by walking forward from the line of the
+  //! previous one instead of searching the whole line table.
+  class sequential_resolver
+  {
+  public:
+    Pos resolve(SourceLoc loc);
+  private:
+    // indices, since registering a buffer moves the others
+    std::size_t buffer_ = no_buffer;
+    std::size_t line_ = 0; // of the previous line in line_starts
+  };
+
+private:
+  const buffer* find(SourceLoc loc) const;
+  static const std::vector<std::uint32_t>& line_starts(const buffer& b);
+
+  std::vector<buffer> buffers_;
+  std::uint32_t next_base_ = 1; // 0 is the invalid location
+};
+
+//! Append the offset of every line start in [begin, end) after the
+//! first one to starts.
+void scan_line_starts(const char* begin, const char* end,
+                      std::vector<std::uint32_t>& starts);
+
+} // c4
+#endif /* C4_SOURCE_MANAGER_H */
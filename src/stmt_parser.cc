@@ -17,6 +17,38 @@ bool is_jump_statement(const c4::token& t) {
 
 namespace c4 {
 
+namespace {
+const unsigned max_errors = 20;
+}
+
+// the ';' that ends a statement; without it the rest of the statement
+// is skipped
+void stmt_parser::end_statement() {
+  if(!expect(token_type::PCTR_SEMICOLON)) {
+    synchronize(SYNC_STMT);
+    if(possibly(token_type::PCTR_SEMICOLON))
+      consume();
+  }
+}
+
+// skip to the '}' of the innermost compound statement; the enclosing
+// ones see the error count too and skip the rest of theirs
+void stmt_parser::give_up() {
+  if(!gave_up_) {
+    errorf(t().second, "too many errors, skipping the rest of the function");
+    gave_up_ = true;
+  }
+  std::size_t depth = 0;
+  while(!possibly(token_type::T_EOF)
+        && !(depth == 0 && possibly(token_type::PCTR_RBRACE))) {
+    if(possibly(token_type::PCTR_LBRACE))
+      ++depth;
+    else if(possibly(token_type::PCTR_RBRACE))
+      --depth;
+    consume();
+  }
+}
+
 stmt* stmt_parser::operator()() {
   if(possibly(token_type::PCTR_LBRACE)) 
     return match_compound();
@@ -35,16 +67,20 @@ stmt* stmt_parser::operator()() {
 
 comp_stmt* stmt_parser::match_compound() {
   expect(token_type::PCTR_LBRACE);
-  comp_stmt* cs = new comp_stmt;
+  comp_stmt* cs = make<comp_stmt>();
   while(!possibly(token_type::PCTR_RBRACE) && !possibly(token_type::T_EOF)) {
+    if(errorCount() - first_error_ >= max_errors) {
+      give_up();
+      break;
+    }
     if(is_type_specifier(t().first)) {
-      decl_parser declp{get_lexer()};
+      decl_parser declp{get_lexer(), get_context()};
       decl* dp = declp();
-      cs->add_stmt(dp);
-      expect(token_type::PCTR_SEMICOLON);
+      cs->add_stmt(*get_context(), dp);
+      end_statement();
     } else {
       stmt* st = (*this)();
-      cs->add_stmt(st);
+      cs->add_stmt(*get_context(), st);
     }
   }
   expect(token_type::PCTR_RBRACE);
@@ -52,38 +88,38 @@ comp_stmt* stmt_parser::match_compound() {
 }
 
 labeled_stmt* stmt_parser::match_labeled() {
-  std::string label = t().first.data;
+  symbol label = t().first.name;
   consume();
   auto pos = t().second;
   expect(token_type::PCTR_COLON);
   stmt* stmt = (*this)();
-  return new labeled_stmt{label, stmt, pos};
+  return make<labeled_stmt>(label, stmt, pos);
 }
 
 stmt* stmt_parser::match_if() {
   auto pos = t().second;
   expect(token_type::KWD_IF);
   expect(token_type::PCTR_LPAREN);
-  expr_parser ep{get_lexer()};
+  expr_parser ep{get_lexer(), get_context()};
   expression* cond = ep();
   expect(token_type::PCTR_RPAREN);
   stmt* if_body = (*this)();
   if(possibly(token_type::KWD_ELSE)) {
     consume();
-    return new if_else_stmt{cond, if_body, (*this)(), pos};
+    return make<if_else_stmt>(cond, if_body, (*this)(), pos);
   }
-  return new if_stmt{cond, if_body, pos};
+  return make<if_stmt>(cond, if_body, pos);
 }
 
 while_stmt* stmt_parser::match_while() {
   auto pos = t().second;
   expect(token_type::KWD_WHILE);
   expect(token_type::PCTR_LPAREN);
-  expr_parser ep{get_lexer()};
+  expr_parser ep{get_lexer(), get_context()};
   expression* cond = ep();
   expect(token_type::PCTR_RPAREN);
   stmt* body = (*this)();
-  return new while_stmt{cond, body, pos};
+  return make<while_stmt>(cond, body, pos);
 }
 
 stmt* stmt_parser::match_jump() {
@@ -92,24 +128,24 @@ stmt* stmt_parser::match_jump() {
     auto pos = t().second;
     consume();
     if(possibly(token_type::IDENTIFIER))
-      jump = new goto_stmt{t().first.data, pos};
+      jump = make<goto_stmt>(t().first.name, pos);
     expect(token_type::IDENTIFIER);
   } else if(possibly(token_type::KWD_RETURN)) {
     auto ret_pos = t().second;
     consume();
     if(!possibly(token_type::PCTR_SEMICOLON)) {
-      expr_parser ep{get_lexer()};
-      jump = new return_stmt{ep(), ret_pos};
+      expr_parser ep{get_lexer(), get_context()};
+      jump = make<return_stmt>(ep(), ret_pos);
     } else
-      jump = new return_stmt{ret_pos};
+      jump = make<return_stmt>(ret_pos);
   } else if(possibly(token_type::KWD_CONTINUE)) {
-    jump = new continue_stmt{t().second};
+    jump = make<continue_stmt>(t().second);
     consume();
   } else {
-    jump = new break_stmt{t().second};
+    jump = make<break_stmt>(t().second);
     consume();
   }
-  expect(token_type::PCTR_SEMICOLON);
+  end_statement();
   return jump;
 }
 
@@ -117,13 +153,12 @@ expr_stmt* stmt_parser::match_expression_statement() {
   if(possibly(token_type::PCTR_SEMICOLON)) {
     consume();
   } else {
-    expr_parser ep{get_lexer()};
+    expr_parser ep{get_lexer(), get_context()};
     expression* expr = ep();
-    if(!expect(token_type::PCTR_SEMICOLON) && possibly(token_type::PCTR_RPAREN))
-      consume();
-    return new expr_stmt{expr};
+    end_statement();
+    return make<expr_stmt>(expr);
   }
-  return new expr_stmt;
+  return make<expr_stmt>();
 }
 
 }
@@ -17,17 +17,26 @@ struct if_stmt;
 struct if_else_stmt;
 struct comp_stmt;
 
+//! Parses the statements of one function; after too many errors in it
+//! the rest of the function is skipped.
 struct stmt_parser : parser_base {
-  using parser_base::parser_base;
+  stmt_parser(lexer* l, ast_context* c)
+    : parser_base(l, c), first_error_(errorCount()) {}
   stmt* operator()();
 
 private:
+  void end_statement();
+  void give_up();
+
   comp_stmt* match_compound();
   labeled_stmt* match_labeled();
   while_stmt* match_while();
   stmt* match_if();
   stmt* match_jump();
   expr_stmt* match_expression_statement();
+
+  unsigned first_error_;
+  bool gave_up_ = false;
 };
 
 } // c4
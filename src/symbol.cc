@@ -0,0 +1,113 @@
+#include "symbol.h"
+
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "llvm/ADT/Hashing.h"
+
+namespace {
+
+// Open addressing over the ids. The spellings are copied into blocks
+// that never move, so the names handed out stay valid.
+class symbol_table
+{
+public:
+  symbol_table() : names_(1, llvm::StringRef{"", 0}), hashes_(1, 0), slots_(1024, 0) {}
+
+  std::uint32_t intern(llvm::StringRef name);
+  llvm::StringRef name(std::uint32_t id) const { return names_[id]; }
+
+private:
+  static const std::size_t block_size = 64 * 1024;
+
+  const char* copy(llvm::StringRef name);
+  void grow();
+
+  std::vector<llvm::StringRef> names_; // by id
+  std::vector<std::size_t> hashes_;    // by id
+  std::vector<std::uint32_t> slots_;   // ids, 0 is a free slot
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* free_ = nullptr;
+  std::size_t left_ = 0;
+};
+
+const std::size_t symbol_table::block_size;
+
+symbol_table& table()
+{
+  static symbol_table t;
+  return t;
+}
+
+std::uint32_t symbol_table::intern(llvm::StringRef name)
+{
+  if(name.empty())
+    return 0;
+
+  std::size_t hash = llvm::hash_value(name);
+  std::size_t mask = slots_.size() - 1;
+  for(std::size_t i = hash & mask; ; i = (i + 1) & mask) {
+    std::uint32_t id = slots_[i];
+    if(id == 0) {
+      id = static_cast<std::uint32_t>(names_.size());
+      names_.push_back(llvm::StringRef{copy(name), name.size()});
+      hashes_.push_back(hash);
+      slots_[i] = id;
+      if(names_.size() * 2 > slots_.size())
+        grow();
+      return id;
+    }
+    if(hashes_[id] == hash && names_[id] == name)
+      return id;
+  }
+}
+
+const char* symbol_table::copy(llvm::StringRef name)
+{
+  // keep a terminating zero for c_str()
+  std::size_t n = name.size() + 1;
+  if(left_ < n) {
+    std::size_t size = std::max(block_size, n);
+    blocks_.emplace_back(new char[size]);
+    free_ = blocks_.back().get();
+    left_ = size;
+  }
+  char* p = free_;
+  std::copy(name.begin(), name.end(), p);
+  p[name.size()] = 0;
+  free_ += n;
+  left_ -= n;
+  return p;
+}
+
+void symbol_table::grow()
+{
+  slots_.assign(slots_.size() * 2, 0);
+  std::size_t mask = slots_.size() - 1;
+  for(std::uint32_t id = 1; id < names_.size(); ++id) {
+    std::size_t i = hashes_[id] & mask;
+    while(slots_[i] != 0)
+      i = (i + 1) & mask;
+    slots_[i] = id;
+  }
+}
+
+}
+
+namespace c4 {
+
+symbol symbol::intern(llvm::StringRef name)
+{ return symbol{table().intern(name)}; }
+
+llvm::StringRef symbol::str() const
+{ return table().name(id_); }
+
+std::ostream& operator<<(std::ostream& o, symbol s)
+{
+  auto name = s.str();
+  return o.write(name.data(), static_cast<std::streamsize>(name.size()));
+}
+
+} // c4
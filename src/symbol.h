@@ -0,0 +1,56 @@
+#ifndef C4_SYMBOL_H
+#define C4_SYMBOL_H
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace c4 {
+
+//! An interned identifier. The lexer interns every identifier it
+//! finds, so equal names have equal ids and everything after it
+//! compares and hashes 32 bit ids instead of strings. The default
+//! symbol is the empty name.
+//! Interning is not thread safe; the lexer only does it on the thread
+//! that owns it.
+class symbol
+{
+public:
+  symbol() = default;
+
+  //! The symbol for name; the characters are copied, so name doesn't
+  //! need to outlive it.
+  static symbol intern(llvm::StringRef name);
+
+  llvm::StringRef str() const;
+  //! The name, null terminated.
+  const char* c_str() const { return str().data(); }
+
+  std::uint32_t id() const { return id_; }
+  bool empty() const { return id_ == 0; }
+
+  friend bool operator==(symbol a, symbol b) { return a.id_ == b.id_; }
+  friend bool operator!=(symbol a, symbol b) { return a.id_ != b.id_; }
+  //! By id, not alphabetical.
+  friend bool operator<(symbol a, symbol b) { return a.id_ < b.id_; }
+
+private:
+  explicit symbol(std::uint32_t id) : id_(id) {}
+
+  std::uint32_t id_ = 0;
+};
+
+std::ostream& operator<<(std::ostream& o, symbol s);
+
+} // c4
+
+namespace std {
+template<> struct hash<c4::symbol>
+{
+  std::size_t operator()(c4::symbol s) const { return s.id(); }
+};
+}
+
+#endif /* C4_SYMBOL_H */
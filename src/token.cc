@@ -1,4 +1,5 @@
 #include "token.h"
+#include "diagnostic.h"
 #include <ostream>
 #include <cassert>
 
@@ -50,6 +51,25 @@ const char* token_to_string(const token_type& t) {
   return token_str_map[static_cast<int>(t)].second;
 }
 
+const char* lex_error_format(lex_error e) {
+  switch(e) {
+  case lex_error::UNKNOWN_ESCAPE: return "unknown escape sequence \\%c";
+  case lex_error::MISSING_TERMINATING_QUOTE: return "missing terminating ' character";
+  case lex_error::MISSING_TERMINATING_DQUOTE: return "missing terminating \" character";
+  case lex_error::INVALID_CHAR_LENGTH: return "invalid length character constant";
+  case lex_error::UNTERMINATED_COMMENT: return "unterminated comment";
+  case lex_error::STRAY_BACKSLASH: return "stray '\\' in program";
+  case lex_error::STRAY_CONTROL: return "stray '\\%d' in program"; // TODO this will panic
+  case lex_error::STRAY_CHARACTER: return "stray '%c' in program";
+  case lex_error::TOKEN_TOO_LONG: return "token too long, tokens are cut off at 16 MiB";
+  }
+  return "";
+}
+
+void report(const lex_diag& d) {
+  errorf(d.loc, lex_error_format(d.error), d.arg);
+}
+
 // internal
 namespace {
 
@@ -71,27 +91,21 @@ const char* kwd_to_string(const token_type& t)
 
 }
 
-std::ostream& operator<<(std::ostream& o, const token& t) {
+token_text describe(const token& t) {
   switch(t.type) {
   case token_type::INVALID:
-    o.write(t.data.data(), t.data.size());
-    break;
+    return token_text{"", t.data()};
   case token_type::INTEGER_CONSTANT:
   case token_type::CHARACTER_CONSTANT:
-    o << "constant "; o.write(t.data.data(), t.data.size());
-    break;
+    return token_text{"constant", t.data()};
   case token_type::STRING_LITERAL:
-    o << "string-literal "; o.write(t.data.data(), t.data.size());
-    break;
+    return token_text{"string-literal", t.data()};
   case token_type::COMMENT:
-    o << "comment";
-    break;
+    return token_text{"comment", llvm::StringRef{}};
   case token_type::T_EOF:
-    o << "EOF";
-    break;
+    return token_text{"EOF", llvm::StringRef{}};
   case token_type::IDENTIFIER:
-    o << "identifier "; o.write(t.data.data(), t.data.size());
-    break;
+    return token_text{"identifier", t.data()};
     // handle digraph punctuators
   case token_type::PCTR_LBRACKET:
   case token_type::PCTR_RBRACKET:
@@ -99,8 +113,7 @@ std::ostream& operator<<(std::ostream& o, const token& t) {
   case token_type::PCTR_RBRACE:
   case token_type::PCTR_HASH:
   case token_type::PCTR_HASHASH:
-    o << "punctuator "; o.write(t.data.data(), t.data.size());
-    break;
+    return token_text{"punctuator", t.data()};
     //handle punctuators generically
   case token_type::PCTR_LPAREN:
   case token_type::PCTR_RPAREN:
@@ -144,8 +157,7 @@ std::ostream& operator<<(std::ostream& o, const token& t) {
   case token_type::PCTR_VARARGS:
   case token_type::PCTR_SHIFT_LEFT_ASSIGN:
   case token_type::PCTR_SHIFT_RIGHT_ASSIGN:
-    o << "punctuator " << pctr_to_string(t.type);
-    break;
+    return token_text{"punctuator", pctr_to_string(t.type)};
   // handle keywords generically
   case token_type::KWD_AUTO:
   case token_type::KWD_BREAK:
@@ -191,11 +203,18 @@ std::ostream& operator<<(std::ostream& o, const token& t) {
   case token_type::KWD__NORETURN:
   case token_type::KWD__STATIC_ASSERT:
   case token_type::KWD__THREAD_LOCAL:
-    o << "keyword " << kwd_to_string(t.type);
-    break;
+    return token_text{"keyword", kwd_to_string(t.type)};
   }
 
-  return o;
+  return token_text{"", llvm::StringRef{}};
+}
+
+std::ostream& operator<<(std::ostream& o, const token& t) {
+  auto text = describe(t);
+  o << text.kind;
+  if(*text.kind && !text.text.empty())
+    o << ' ';
+  return o.write(text.text.data(), text.text.size());
 }
 
 }
@@ -2,8 +2,13 @@
 #define C4_TOKEN_H
 
 #include "llvm/ADT/StringRef.h"
+#include "pos.h"
+#include "symbol.h"
 
-#include <string>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <iosfwd>
 
@@ -11,7 +16,7 @@ namespace c4 {
 
 // If you ever consider reordering those, remember to also reorder the
 // token.cc table. Really.
-enum class token_type : int {
+enum class token_type : std::uint8_t {
     T_EOF = 0, /* EOF macro is around */
     INVALID, INTEGER_CONSTANT, CHARACTER_CONSTANT, 
     STRING_LITERAL, COMMENT, IDENTIFIER, 
@@ -37,29 +42,74 @@ enum class token_type : int {
     KWD__IMAGINARY, KWD__NORETURN, KWD__STATIC_ASSERT, KWD__THREAD_LOCAL
 };
 
+//! For tables indexed by token type.
+constexpr std::size_t num_token_types
+  = static_cast<std::size_t>(token_type::KWD__THREAD_LOCAL) + 1;
+
 } // c4
 
 namespace c4 {
 
 const char* token_to_string(const token_type&);
 
+//! The length of a token shares a word with its type, so it is 24
+//! bits. The lexer reports longer ones and cuts them off.
+constexpr std::uint32_t max_token_length = (1u << 24) - 1;
+
+//! A token is a plain (type, length, start) triple into the source
+//! buffer, plus the interned name of an identifier. It is copied
+//! around a lot, so keep it trivially copyable and at 16 bytes.
 struct token
 {
   token(token_type type, const llvm::StringRef& data)
-    : type(type), data(data) {}
-  token(token_type type, const llvm::StringRef& data, std::vector<std::string> errors)
-    : type(type), data(data), errors(std::move(errors)) {}
+    : start(data.data()), type(type), length(static_cast<std::uint32_t>(data.size()))
+  { assert(data.size() <= max_token_length && "token: too long"); }
 
-  token(token&&) = default;
-  token& operator=(token&&) = default;
-  token(const token&) = default;
-  token& operator=(const token&) = default;
+  llvm::StringRef data() const { return llvm::StringRef{start, length}; }
 
+  const char* start;
+  symbol name; // set by the lexer for identifiers
   token_type type;
-  llvm::StringRef data;
-  std::vector<std::string> errors;
+  std::uint32_t length : 24;
+};
+
+static_assert(std::is_trivially_copyable<token>::value, "token must stay a POD");
+static_assert(sizeof(token) == 16, "token grew");
+
+//! Errors found while lexing. They are kept out of the token and
+//! handed to a side table the lexer owns.
+enum class lex_error : unsigned char {
+  UNKNOWN_ESCAPE, MISSING_TERMINATING_QUOTE, MISSING_TERMINATING_DQUOTE,
+  INVALID_CHAR_LENGTH, UNTERMINATED_COMMENT, STRAY_BACKSLASH,
+  STRAY_CONTROL, STRAY_CHARACTER, TOKEN_TOO_LONG
+};
+
+struct lex_diag {
+  lex_diag(lex_error error, char arg, SourceLoc loc = SourceLoc{})
+    : loc(loc), error(error), arg(arg) {}
+
+  SourceLoc loc; // filled in by the lexer for errors of the munchers
+  lex_error error;
+  char arg; // the offending character, if the message needs one
 };
 
+typedef std::vector<lex_diag> lex_diags;
+
+//! Return the errorf format for `e`. It takes the diag's arg as '%c'.
+const char* lex_error_format(lex_error e);
+
+//! Emit `d` through errorf.
+void report(const lex_diag& d);
+
+//! A token as --tokenize prints it: a kind like "keyword", then the
+//! spelling. Either one may be empty.
+struct token_text {
+  const char* kind;
+  llvm::StringRef text;
+};
+
+token_text describe(const token& t);
+
 std::ostream& operator<<(std::ostream& o, const token& t);
 
 } // c4
@@ -0,0 +1,251 @@
+#include "token_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "lexer.h"
+
+namespace {
+
+using c4::token_type;
+
+// An entry is a header, the token records, the error records and a
+// copy of the input, all in host byte order; another byte order just
+// fails the magic check. The input is compared with the one being
+// lexed, so an entry whose name collides with another input's is a
+// miss, not a hit with the wrong tokens.
+struct header
+{
+  char magic[4];
+  std::uint32_t version;
+  std::uint64_t content_hash;
+  std::uint64_t content_size;
+  std::uint32_t tokens;
+  std::uint32_t diags;
+  std::uint32_t strategy;
+  std::uint32_t reserved;
+  std::uint64_t checksum; // of the records
+};
+
+// offsets are relative to the start of the input; a token has no more
+// than 24 bits of length
+struct token_record
+{
+  std::uint32_t offset;
+  std::uint32_t length_type; // length << 8 | type
+};
+
+struct diag_record
+{
+  std::uint32_t index;
+  std::uint32_t offset;
+  std::uint8_t error;
+  std::uint8_t own;
+  char arg;
+  std::uint8_t pad;
+};
+
+static_assert(sizeof(header) == 48, "the cache format changed");
+static_assert(sizeof(token_record) == 8, "the cache format changed");
+static_assert(sizeof(diag_record) == 12, "the cache format changed");
+
+const char magic[4] = {'C', '4', 'T', 'K'};
+
+const unsigned lex_errors = static_cast<unsigned>(c4::lex_error::TOKEN_TOO_LONG) + 1;
+
+template<typename T>
+T read(const char* p)
+{
+  T t;
+  std::memcpy(&t, p, sizeof(t));
+  return t;
+}
+
+// An entry mapped read only. Entries aren't inputs, so they don't go
+// through c4::input and don't count in its stats; a missing or empty
+// file leaves it empty.
+class mapped_entry
+{
+public:
+  explicit mapped_entry(const char* path)
+  {
+    int fd = ::open(path, O_RDONLY);
+    if(fd == -1)
+      return;
+    struct stat sb;
+    if(::fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+      std::size_t size = static_cast<std::size_t>(sb.st_size);
+      void* m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(m != MAP_FAILED) {
+        begin_ = static_cast<const char*>(m);
+        size_ = size;
+      }
+    }
+    ::close(fd);
+  }
+  mapped_entry(const mapped_entry&) = delete;
+  mapped_entry& operator=(const mapped_entry&) = delete;
+  ~mapped_entry()
+  {
+    if(begin_)
+      ::munmap(const_cast<char*>(begin_), size_);
+  }
+
+  const char* begin() const { return begin_; }
+  const char* end() const { return begin_ + size_; }
+  std::size_t size() const { return size_; }
+
+private:
+  const char* begin_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+bool write_all(int fd, const char* p, std::size_t n)
+{
+  while(n != 0) {
+    ssize_t w = ::write(fd, p, n);
+    if(w == -1) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    p += w;
+    n -= static_cast<std::size_t>(w);
+  }
+  return true;
+}
+
+}
+
+namespace c4 {
+
+std::string token_cache::path(std::uint64_t hash) const
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.tokens",
+                static_cast<unsigned long long>(hash));
+  return dir_ + name;
+}
+
+bool token_cache::load(lexer& l)
+{
+  assert(!l.buffered());
+  std::uint64_t size = static_cast<std::uint64_t>(l.end_ - l.begin_);
+  std::uint64_t hash = content_hash(l.begin_, l.end_);
+  std::string file = path(hash);
+
+  auto miss = [this] { ++misses_; return false; };
+  mapped_entry entry{file.c_str()};
+  const char* p = entry.begin();
+  if(entry.size() < sizeof(header))
+    return miss();
+  auto h = read<header>(p);
+  std::uint64_t records = std::uint64_t{h.tokens} * sizeof(token_record)
+    + std::uint64_t{h.diags} * sizeof(diag_record);
+  if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != format_version
+     || h.content_hash != hash || h.content_size != size
+     || h.strategy != static_cast<std::uint32_t>(l.strategy_) || h.tokens == 0
+     || entry.size() != sizeof(header) + records + size)
+    return miss();
+  const char* source = p + sizeof(header) + records;
+  if(std::memcmp(source, l.begin_, size) != 0
+     || content_hash(p + sizeof(header), source) != h.checksum)
+    return miss();
+
+  // the checksum only catches accidents, the records get checked
+  // before they turn into pointers
+  std::vector<token> tokens;
+  tokens.reserve(h.tokens);
+  p += sizeof(header);
+  for(std::uint32_t i = 0; i < h.tokens; ++i, p += sizeof(token_record)) {
+    auto r = read<token_record>(p);
+    std::uint32_t type = r.length_type & 0xff;
+    std::uint32_t length = r.length_type >> 8;
+    if(type >= num_token_types || r.offset > size || length > size - r.offset)
+      return miss();
+    token t{static_cast<token_type>(type), llvm::StringRef{l.begin_ + r.offset, length}};
+    if(t.type == token_type::IDENTIFIER)
+      t.name = symbol::intern(t.data());
+    tokens.push_back(t);
+  }
+  if(tokens.back().type != token_type::T_EOF
+     || tokens.front().type != l.token_.first.type
+     || tokens.front().start != l.token_.first.start
+     || tokens.front().length != l.token_.first.length)
+    return miss();
+
+  std::vector<lexer::deferred_diag> deferred;
+  deferred.reserve(h.diags);
+  for(std::uint32_t i = 0; i < h.diags; ++i, p += sizeof(diag_record)) {
+    auto r = read<diag_record>(p);
+    if(r.index >= h.tokens || (!deferred.empty() && r.index < deferred.back().index)
+       || r.error >= lex_errors || r.offset > size)
+      return miss();
+    lex_diag d{static_cast<lex_error>(r.error), r.arg, l.loc(l.begin_ + r.offset)};
+    deferred.push_back(lexer::deferred_diag{r.index, r.own != 0, d});
+  }
+
+  l.adopt_buffer(std::move(tokens), std::move(deferred));
+  ++hits_;
+  return true;
+}
+
+void token_cache::store(const lexer& l)
+{
+  assert(l.buffered());
+  header h;
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = format_version;
+  h.content_hash = content_hash(l.begin_, l.end_);
+  h.content_size = static_cast<std::uint64_t>(l.end_ - l.begin_);
+  h.tokens = static_cast<std::uint32_t>(l.buffer_.size());
+  h.diags = static_cast<std::uint32_t>(l.deferred_.size());
+  h.strategy = static_cast<std::uint32_t>(l.strategy_);
+  h.reserved = 0;
+
+  std::vector<char> data(sizeof(header) + l.buffer_.size() * sizeof(token_record)
+                         + l.deferred_.size() * sizeof(diag_record) + h.content_size);
+  char* p = data.data() + sizeof(header);
+  for(auto& t : l.buffer_) {
+    token_record r{static_cast<std::uint32_t>(t.start - l.begin_),
+                   std::uint32_t{t.length} << 8 | static_cast<std::uint32_t>(t.type)};
+    std::memcpy(p, &r, sizeof(r));
+    p += sizeof(r);
+  }
+  for(auto& d : l.deferred_) {
+    diag_record r{d.index, d.diag.loc.offset - l.base_.offset,
+                  static_cast<std::uint8_t>(d.diag.error), d.own, d.diag.arg, 0};
+    std::memcpy(p, &r, sizeof(r));
+    p += sizeof(r);
+  }
+  h.checksum = content_hash(data.data() + sizeof(header), p);
+  std::copy(l.begin_, l.end_, p);
+  std::memcpy(data.data(), &h, sizeof(h));
+
+  // write a temporary and rename it, so nobody maps half an entry
+  std::string file = path(h.content_hash);
+  std::string tmp = file + ".XXXXXX";
+  int fd = mkstemp(&tmp[0]);
+  if(fd == -1)
+    return;
+  // mkstemp makes it private, the entry should be like any other file
+  mode_t mask = ::umask(0);
+  ::umask(mask);
+  bool ok = ::fchmod(fd, 0666 & ~mask) == 0
+    && write_all(fd, data.data(), data.size());
+  ok = ::close(fd) == 0 && ok;
+  if(!ok || std::rename(tmp.c_str(), file.c_str()) != 0)
+    ::unlink(tmp.c_str());
+}
+
+} // c4
@@ -0,0 +1,47 @@
+#ifndef C4_TOKEN_CACHE_H
+#define C4_TOKEN_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace c4 {
+
+class lexer;
+
+//! Keeps the buffered tokens and lexer errors of inputs in a directory,
+//! one file per input named after a hash of its contents. An entry is
+//! a header followed by fixed size token and error records, so it is
+//! used straight from the mapping, and a copy of the input. Entries of
+//! another format version, failing their checksum or holding other
+//! contents than the input are ignored and replaced.
+class token_cache
+{
+public:
+  //! Bump this whenever the records or the token types change.
+  static const std::uint32_t format_version = 2;
+
+  explicit token_cache(std::string dir) : dir_(std::move(dir)) {}
+
+  //! Buffer the tokens of l from its entry, if it has a valid one.
+  bool load(lexer& l);
+
+  //! Write the entry for l, whose tokens must be buffered. The cache is
+  //! only an optimization, so an entry that can't be written is
+  //! skipped.
+  void store(const lexer& l);
+
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+private:
+  std::string path(std::uint64_t hash) const;
+
+  std::string dir_;
+  std::size_t hits_ = 0;
+  std::size_t misses_ = 0;
+};
+
+} // c4
+#endif /* C4_TOKEN_CACHE_H */
@@ -0,0 +1,93 @@
+#include "token_writer.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "diagnostic.h"
+
+namespace {
+
+void flush_writer(void* w)
+{ static_cast<c4::token_writer*>(w)->flush(); }
+
+}
+
+namespace c4 {
+
+token_writer::token_writer(int fd, std::size_t capacity)
+  : buf_(capacity), fd_(fd)
+{
+  setDiagnosticFlushHook(flush_writer, this);
+}
+
+token_writer::~token_writer()
+{
+  flush();
+  setDiagnosticFlushHook(nullptr, nullptr);
+}
+
+void token_writer::write(const token& t, SourceLoc loc)
+{
+  Pos p = resolver_.resolve(loc);
+  if(p.name != name_) {
+    name_ = p.name;
+    name_length_ = std::strlen(p.name);
+  }
+  put(name_, name_length_);
+  put(':');
+  put_unsigned(p.line);
+  put(':');
+  put_unsigned(p.column);
+  put(':');
+  put(' ');
+
+  auto text = describe(t);
+  std::size_t kind_length = std::strlen(text.kind);
+  put(text.kind, kind_length);
+  if(kind_length != 0 && !text.text.empty())
+    put(' ');
+  put(text.text.data(), text.text.size());
+  put('\n');
+}
+
+void token_writer::put_unsigned(unsigned n)
+{
+  // digits come out backwards, fill a small buffer from the end
+  char digits[10];
+  char* d = digits + sizeof(digits);
+  do {
+    *--d = static_cast<char>('0' + n % 10);
+    n /= 10;
+  } while(n != 0);
+  put(d, static_cast<std::size_t>(digits + sizeof(digits) - d));
+}
+
+void token_writer::make_room(std::size_t n)
+{
+  flush();
+  if(buf_.size() < n)
+    buf_.resize(n);
+}
+
+void token_writer::flush()
+{
+  const char* p = buf_.data();
+  while(size_ != 0 && fd_ != -1) {
+    ssize_t n = ::write(fd_, p, size_);
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+      // stop writing, but don't recurse through the flush hook
+      fd_ = -1;
+      errorf("could not write tokens: %s", std::strerror(errno));
+      break;
+    }
+    p += n;
+    size_ -= static_cast<std::size_t>(n);
+  }
+  size_ = 0;
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef C4_TOKEN_WRITER_H
+#define C4_TOKEN_WRITER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "pos.h"
+#include "source_manager.h"
+#include "token.h"
+
+namespace c4 {
+
+//! Writes tokens the way --tokenize prints them, "file:line:column: "
+//! followed by the token, into a buffer that goes out with one write()
+//! whenever it fills up. Diagnostics flush it first, so they stay in
+//! order with the tokens.
+class token_writer
+{
+public:
+  explicit token_writer(int fd, std::size_t capacity = 64 * 1024);
+  token_writer(const token_writer&) = delete;
+  token_writer& operator=(const token_writer&) = delete;
+  ~token_writer();
+
+  void write(const token& t, SourceLoc loc);
+
+  //! Write out everything buffered.
+  void flush();
+
+private:
+  void put(const char* s, std::size_t n)
+  {
+    if(buf_.size() - size_ < n)
+      make_room(n);
+    std::copy(s, s + n, buf_.data() + size_);
+    size_ += n;
+  }
+
+  void put(char c)
+  { put(&c, 1); }
+
+  void put_unsigned(unsigned n);
+  void make_room(std::size_t n);
+
+  std::vector<char> buf_;
+  std::size_t size_ = 0;
+  int fd_;
+  source_manager::sequential_resolver resolver_;
+
+  // the file name is the same for long runs of tokens
+  const char* name_ = nullptr;
+  std::size_t name_length_ = 0;
+};
+
+} // c4
+#endif /* C4_TOKEN_WRITER_H */
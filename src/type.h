@@ -186,11 +186,11 @@ private:
 };
 
 struct struct_type : object_type {
-  typedef std::vector< std::pair< std::string, std::shared_ptr<type> > > member_list;
+  typedef std::vector< std::pair< symbol, std::shared_ptr<type> > > member_list;
   typedef member_list::value_type value_type;
 
   template<typename... Members>
-  struct_type(const std::string& tag, Members... mems)
+  struct_type(symbol tag, Members... mems)
     : members_{mems...}, tag_{tag} {}
   
   bool is_struct() const override final { return true; }
@@ -203,10 +203,10 @@ struct struct_type : object_type {
 
   // Return a std::shared_ptr<type> for the identifier `s`. The
   // shared_ptr will be null if there is no such identifier.
-  value_type::second_type lookup(const value_type::first_type& s)
+  value_type::second_type lookup(value_type::first_type s)
   { 
     auto it = std::find_if(begin(members_), end(members_),
-                           [&s](const value_type& v) { return s == v.first; });
+                           [s](const value_type& v) { return s == v.first; });
     if(it != end(members_)) {
       return it->second;
     } else {
@@ -214,15 +214,15 @@ struct struct_type : object_type {
     }
   }
 
-  int index_of(const value_type::first_type& s)
+  int index_of(value_type::first_type s)
   {
     auto it = std::find_if(begin(members_), end(members_),
-                           [&s](const value_type& v) { return s == v.first; });
+                           [s](const value_type& v) { return s == v.first; });
     assert(it != end(members_));
     return std::distance(members_.begin(), it);
   }
 
-  const std::string& get_tag() const { return tag_; }
+  symbol get_tag() const { return tag_; }
 
   void add_member(const value_type& th) 
   { members_.emplace_back(th); }
@@ -242,8 +242,8 @@ struct struct_type : object_type {
     if(llvm_type_)
       return llvm_type_;
     auto struct_type = llvm::StructType::create(b.getContext(), 
-                                                std::string{"struct."} + 
-						get_tag());
+                                                std::string{"struct."} +
+						get_tag().c_str());
     std::vector<llvm::Type*> member_types;
     member_types.reserve(members().size());
     for(auto& t : members()) {
@@ -256,7 +256,7 @@ struct struct_type : object_type {
 private: 
   llvm::Type* llvm_type_ = nullptr;
   member_list members_;
-  std::string tag_;
+  symbol tag_;
 };
 
 struct function_type : type {
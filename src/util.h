@@ -21,6 +21,23 @@ std::unique_ptr<T> make_unique(Args&&... args)
     return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
 }
 
+// C++14 has std::index_sequence; we need it to build constexpr lookup
+// tables. The list is built by halving, so a table of a few thousand
+// entries stays well within the template instantiation depth.
+template<std::size_t... Is> struct index_list {};
+
+template<typename, typename> struct concat_index_list;
+
+template<std::size_t... As, std::size_t... Bs>
+struct concat_index_list<index_list<As...>, index_list<Bs...>>
+{ typedef index_list<As..., (sizeof...(As) + Bs)...> type; };
+
+template<std::size_t N> struct make_index_list
+  : concat_index_list<typename make_index_list<N / 2>::type,
+                      typename make_index_list<N - N / 2>::type> {};
+template<> struct make_index_list<0> { typedef index_list<> type; };
+template<> struct make_index_list<1> { typedef index_list<0> type; };
+
 [[noreturn]] static inline void panic(char const* const file, int const line, char const* const msg)
 {
 	fprintf(stderr, "%s:%d: %s\n", file, line, msg);
@@ -0,0 +1,101 @@
+// Allocation test of the parser. Parses every input with its tokens
+// buffered and counts the heap allocations made while parsing: only
+// the blocks of the ast_context, the list that holds them and the
+// arrays of its expression table, which grow by doubling, may
+// allocate, nothing may happen per token. Every input is parsed once
+// before it is counted, so what is set up on first use, like the line
+// table the first error of an input resolves its position with,
+// doesn't count.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "ast_context.h"
+#include "input.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace {
+
+std::size_t allocations = 0;
+
+}
+
+void* operator new(std::size_t n)
+{
+  ++allocations;
+  if(void* p = std::malloc(n != 0 ? n : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{ std::free(p); }
+
+namespace {
+
+struct counts {
+  std::size_t tokens;
+  std::size_t allocations;
+  std::size_t blocks;
+};
+
+// parse twice from the same tokens and count the second time
+counts parse(const c4::input& in)
+{
+  c4::lexer l{in.begin(), in.end(), in.name()};
+  l.buffer_tokens();
+  {
+    c4::ast_context ctx;
+    c4::parser p{&l, &ctx};
+    p.get_ast_node();
+  }
+  std::size_t tokens = l.mark();
+
+  l.reset(0);
+  c4::ast_context ctx;
+  std::size_t before = allocations;
+  c4::parser p{&l, &ctx};
+  p.get_ast_node();
+  return counts{tokens, allocations - before, ctx.blocks()};
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+
+  // the parser tests are full of errors, which aren't the point here
+  if(!std::freopen("/dev/null", "w", stderr))
+    return 1;
+
+  std::size_t failures = 0;
+  std::size_t tokens = 0;
+  std::size_t total = 0;
+  for(int i = 1; i < argc; ++i) {
+    try {
+      c4::input in{argv[i]};
+      auto c = parse(in);
+      tokens += c.tokens;
+      total += c.allocations;
+      // a block each, and at most as many for growing the list of them
+      if(c.allocations > 2 * c.blocks) {
+        ++failures;
+        printf("%s: %zu allocations for %zu tokens and %zu blocks\n",
+               argv[i], c.allocations, c.tokens, c.blocks);
+      }
+    } catch(c4::input_error& e) {
+      printf("%s: %s\n", argv[i], e.what());
+      ++failures;
+    }
+  }
+
+  printf("alloc_test: %d inputs, %zu tokens, %zu allocations, %zu failures\n",
+         argc - 1, tokens, total, failures);
+  return failures != 0;
+}
@@ -0,0 +1,171 @@
+// Round trip test of saved trees. Parses and checks every input, saves
+// the tree, reads it back and compares the two: every node with its
+// kind, line and column, and every expression with its type, in the
+// order a walk meets them. A copy of the file with a byte flipped and
+// one cut short must be refused. Inputs with errors are skipped, there
+// is nothing to save.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "ast.h"
+#include "ast_context.h"
+#include "ast_file.h"
+#include "ast_visitor.h"
+#include "diagnostic.h"
+#include "input.h"
+#include "lexer.h"
+#include "parser.h"
+#include "sema_visitor.h"
+#include "source_manager.h"
+#include "type.h"
+
+namespace {
+
+// one line for every node
+struct describer : c4::ast_visitor<describer> {
+  std::ostringstream out;
+
+  template<typename T>
+  bool handle(T* n)
+  {
+    c4::Pos pos = c4::source_manager::get().resolve(n->position());
+    out << static_cast<unsigned>(n->kind()) << ' ' << pos.line << ':' << pos.column;
+    if(n->is_expression()) {
+      auto& t = static_cast<c4::expression*>(static_cast<c4::ast_node*>(n))->e_type();
+      out << ' ';
+      if(t)
+        out << *t;
+    }
+    out << '\n';
+    return true;
+  }
+};
+
+std::string describe(c4::ast_node* n)
+{
+  describer d;
+  d.visit(n);
+  return d.out.str();
+}
+
+std::string slurp(const std::string& path)
+{
+  std::ifstream in{path, std::ios::binary};
+  return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+void spill(const std::string& path, const std::string& data)
+{
+  std::ofstream out{path, std::ios::binary};
+  out << data;
+}
+
+bool refused(const std::string& path)
+{
+  c4::input in{path.c_str()};
+  c4::ast_context ctx;
+  return !c4::read_ast(in, ctx).tu;
+}
+
+enum class result { SKIPPED, PASSED, FAILED };
+
+result round_trip(const char* name, const std::string& path)
+{
+  hasNewErrors(); // the errors of the inputs before
+  c4::input in{name};
+  c4::lexer l{in.begin(), in.end(), name};
+  c4::ast_context ctx;
+  c4::parser p{&l, &ctx};
+  auto tu = p.get_ast_node();
+  if(hasErrors())
+    return result::SKIPPED;
+  c4::sema_visitor sv;
+  sv.visit(tu);
+  if(hasErrors())
+    return result::SKIPPED;
+
+  if(!c4::write_ast(path.c_str(), static_cast<c4::translation_unit*>(tu), l, name)) {
+    printf("%s: can't be saved\n", name);
+    return result::FAILED;
+  }
+  std::string expected = describe(tu);
+  {
+    c4::input saved{path.c_str()};
+    c4::ast_context loaded_ctx;
+    auto loaded = c4::read_ast(saved, loaded_ctx);
+    if(!loaded.tu) {
+      printf("%s: can't be read back\n", name);
+      return result::FAILED;
+    }
+    if(describe(loaded.tu) != expected) {
+      printf("%s: the tree read back differs\n", name);
+      return result::FAILED;
+    }
+  }
+
+  std::string data = slurp(path);
+  std::string damaged = data;
+  damaged[damaged.size() / 2] ^= 0x10;
+  spill(path, damaged);
+  if(!refused(path)) {
+    printf("%s: a flipped byte goes unnoticed\n", name);
+    return result::FAILED;
+  }
+  spill(path, data.substr(0, data.size() - 1));
+  if(!refused(path)) {
+    printf("%s: a short file goes unnoticed\n", name);
+    return result::FAILED;
+  }
+  return result::PASSED;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+
+  // inputs with errors and the damaged files report plenty
+  if(!std::freopen("/dev/null", "w", stderr))
+    return 1;
+
+  // the saved trees go to a file of our own in the temp directory
+  const char* tmp = std::getenv("TMPDIR");
+  std::string path = std::string{tmp && *tmp ? tmp : "/tmp"} + "/c4_ast_file_XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if(fd < 0) {
+    printf("ast_file_test: can't make %s\n", path.c_str());
+    return 1;
+  }
+  close(fd);
+
+  std::size_t passed = 0;
+  std::size_t failures = 0;
+  for(int i = 1; i < argc; ++i) {
+    try {
+      switch(round_trip(argv[i], path)) {
+      case result::SKIPPED: break;
+      case result::PASSED: ++passed; break;
+      case result::FAILED: ++failures; break;
+      }
+    } catch(c4::input_error& e) {
+      printf("%s: %s\n", argv[i], e.what());
+      ++failures;
+    }
+  }
+  std::remove(path.c_str());
+
+  printf("ast_file_test: %d inputs, %zu saved and read back, %zu failures\n",
+         argc - 1, passed, failures);
+  return failures != 0;
+}
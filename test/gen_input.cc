@@ -0,0 +1,247 @@
+// Writes generated test inputs to stdout, for the tests that need
+// inputs too large to keep in the tree. Every run writes the same.
+//
+//   lex SIZE   about SIZE bytes (k and m suffixes) of every kind of
+//              token, with comments, strings and lines longer than the
+//              pieces the parallel lexer cuts the input into, and a few
+//              errors
+//   long SIZE  a block comment and a string of SIZE bytes each, for
+//              SIZE above the longest token the lexer keeps, between
+//              ordinary lines
+//   blocks SIZE  a function whose body nests compound statements in
+//              about SIZE bytes
+//   calls SIZE   a function that returns f(f(f(...))) of about SIZE
+//              bytes
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "util.h"
+
+namespace {
+
+// a fixed linear congruential generator, so every run writes the same
+struct random {
+  unsigned long state = 12345;
+  unsigned next(unsigned n)
+  {
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    return static_cast<unsigned>(state >> 33) % n;
+  }
+  template<std::size_t N>
+  const char* pick(const char* const (&words)[N]) { return words[next(N)]; }
+};
+
+// bytes, with an optional k or m suffix
+std::size_t parse_size(const char* s)
+{
+  char* end;
+  std::size_t n = std::strtoul(s, &end, 10);
+  if(*end == 'k' || *end == 'K')
+    n *= 1024;
+  else if(*end == 'm' || *end == 'M')
+    n *= 1024 * 1024;
+  return n;
+}
+
+////////// LEXER INPUT //////////
+
+const char* const words[] = {
+  "int", "char", "struct", "return", "if", "else", "while", "sizeof",
+  "unsigned", "i", "count", "next_token", "_x1", "a_rather_long_identifier",
+  "0", "42", "0x1f", "017", "'c'", "'\\n'", "'\\''", "\"\"",
+  "\"a \\\"quoted\\\" string with /* and // in it\"", "\"\\\\\"",
+};
+const char* const operators[] = {
+  "+", "-", "*", "/", "%", "<<", ">>", "&&", "||", "==", "!=", "<=", ">=",
+  "&", "|", "^", "->", ".", "...", "+=", "-=", "*=", "/=", "%=", "<<=",
+  ">>=", "&=", "|=", "^=", "++", "--", "?", ":", ";", ",", "!", "~", "#",
+  "##", "<:", ":>", "<%", "%>", "%:", "%:%:", "(", ")", "[", "]", "{", "}",
+};
+// each costs an error, so there are only a few of them
+const char* const errors[] = {
+  "\"a string that doesn't end\n", "'x\n", "@", "\\ ", "'ab'",
+};
+
+void token_line(random& r, std::string& s)
+{
+  for(unsigned i = 0, n = 4 + r.next(12); i < n; ++i) {
+    s += r.pick(words);
+    // sometimes glued to the next token, sometimes not
+    if(r.next(3) == 0)
+      s += ' ';
+    s += r.pick(operators);
+    if(r.next(3) == 0)
+      s += ' ';
+  }
+  s += r.next(8) == 0 ? "\r\n" : "\n";
+}
+
+// a comment over some lines, opened after what must not be taken for
+// the start of a comment or of a string
+const char* const openers[] = {
+  "s = \"// no comment\"; ", "c = '\"'; ", "s = \"\\\"/*\"; ", "c = '\\''; ",
+  "s = \"'\"; ", "c = '/'; ",
+};
+
+void opened_comment(random& r, std::string& s)
+{
+  s += r.pick(openers);
+  s += "/* a comment";
+  for(unsigned i = 0, n = 1 + r.next(30); i < n; ++i)
+    s += r.next(2) == 0 ? "\n  with a \" in it" : "\n  and a ' in this one";
+  s += " */ x;\n";
+}
+
+void comment(random& r, std::string& s, std::size_t size)
+{
+  s += "/* a comment with \" and ' and // in it\n";
+  std::size_t end = s.size() + size;
+  while(s.size() < end)
+    s += r.next(2) == 0 ? "  * \"/* isn't nested\n" : "  ' // ** /\n";
+  s += "*/";
+}
+
+void long_line(random& r, std::string& s, std::size_t size)
+{
+  std::size_t end = s.size() + size;
+  while(s.size() < end) {
+    s += r.pick(words);
+    s += r.pick(operators);
+  }
+  s += '\n';
+}
+
+std::string lex(std::size_t size)
+{
+  random r;
+  std::string s;
+  s.reserve(size + 4096);
+  // with four threads the input is cut at a quarter and at half of it;
+  // there are a comment and a line as long as the pieces of eight
+  // threads, the rest are lines short enough for the cuts of any number
+  // of threads to fall between them
+  const std::size_t errors_size = sizeof(errors) / sizeof(errors[0]);
+  bool long_comment = false;
+  bool long_one = false;
+  unsigned error = 0;
+  while(s.size() < size) {
+    if(!long_comment && s.size() >= size / 4 - size / 16) {
+      comment(r, s, size / 8);
+      long_comment = true;
+    } else if(!long_one && s.size() >= size / 2 - size / 16) {
+      long_line(r, s, size / 8);
+      long_one = true;
+    }
+    switch(r.next(32)) {
+    case 0:
+      comment(r, s, 64);
+      break;
+    case 1:
+      long_line(r, s, 256);
+      break;
+    case 2:
+      s += "// a line comment with /* and \" in it\n";
+      break;
+    case 3: case 4: case 5: case 6: case 7: case 8: case 9: case 10:
+      opened_comment(r, s);
+      break;
+    default:
+      token_line(r, s);
+      break;
+    }
+    if(error < errors_size && s.size() >= size / (errors_size + 1) * (error + 1))
+      s += errors[error++];
+  }
+  s += "int last;\n";
+  return s;
+}
+
+////////// OVER-LONG TOKENS //////////
+
+// what is past the cut off of the comment and of the string looks like
+// code that opens other comments and strings
+std::string long_tokens(std::size_t size)
+{
+  random r;
+  std::string s;
+  s.reserve(2 * size + 64 * 1024);
+  while(s.size() < 16 * 1024)
+    token_line(r, s);
+  comment(r, s, size);
+  s += " x;\n";
+  for(std::size_t end = s.size() + 16 * 1024; s.size() < end; )
+    token_line(r, s);
+  s += "s = \"";
+  for(std::size_t end = s.size() + size; s.size() < end; )
+    s += r.next(2) == 0 ? "/* no comment " : "-- no more ";
+  s += "\";\n";
+  // lines with no */, for the cuts of the threads to fall on
+  for(std::size_t end = s.size() + size / 16; s.size() < end; )
+    token_line(r, s);
+  for(std::size_t end = s.size() + 16 * 1024; s.size() < end; )
+    r.next(8) == 0 ? opened_comment(r, s) : token_line(r, s);
+  s += "int last;\n";
+  return s;
+}
+
+////////// DEEP NESTING //////////
+
+const char callee[] = "int f(int x)\n{\n\treturn x;\n}\n\n";
+
+std::string blocks(std::size_t size)
+{
+  std::size_t depth = size / 2;
+  std::string s = callee;
+  s += "int main(void)\n{\n";
+  s.append(depth, '{');
+  s += "f(1);";
+  s.append(depth, '}');
+  s += "\n\treturn 0;\n}\n";
+  return s;
+}
+
+std::string calls(std::size_t size)
+{
+  std::size_t depth = size / 3;
+  std::string s = callee;
+  s += "int main(void)\n{\n\treturn ";
+  for(std::size_t i = 0; i < depth; ++i)
+    s += "f(";
+  s += '1';
+  s.append(depth, ')');
+  s += ";\n}\n";
+  return s;
+}
+
+struct kind {
+  const char* name;
+  std::string (*generate)(std::size_t);
+};
+
+const kind kinds[] = {
+  {"lex", lex},
+  {"long", long_tokens},
+  {"blocks", blocks},
+  {"calls", calls},
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  if(argc == 3) {
+    for(auto& k : kinds) {
+      if(strEq(argv[1], k.name)) {
+        auto text = k.generate(parse_size(argv[2]));
+        return fwrite(text.data(), 1, text.size(), stdout) != text.size();
+      }
+    }
+  }
+  fprintf(stderr, "usage: %s kind size\nkinds:", argv[0]);
+  for(auto& k : kinds)
+    fprintf(stderr, " %s", k.name);
+  fprintf(stderr, "\n");
+  return 1;
+}
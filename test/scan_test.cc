@@ -0,0 +1,98 @@
+// Differential test of the scanning kernels. Runs every kernel of every
+// supported instruction set from every offset of the inputs and
+// compares the result with the scalar kernel.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "input.h"
+#include "scan.h"
+
+namespace {
+
+typedef const char* (*scan_fn)(const char*, const char*);
+
+const struct {
+  const char* name;
+  scan_fn c4::scan_kernels::*fn;
+} kernels[] = {
+  {"skip_whitespace", &c4::scan_kernels::skip_whitespace},
+  {"skip_identifier", &c4::scan_kernels::skip_identifier},
+  {"skip_digits", &c4::scan_kernels::skip_digits},
+  {"find_line_end", &c4::scan_kernels::find_line_end},
+  {"find_comment_end", &c4::scan_kernels::find_comment_end},
+};
+
+const struct {
+  const char* name;
+  c4::scan_isa isa;
+} isas[] = {
+  {"sse2", c4::scan_isa::SSE2},
+  {"avx2", c4::scan_isa::AVX2},
+};
+
+std::size_t checks = 0;
+std::size_t failures = 0;
+
+// compare every kernel with the scalar one, starting at every offset
+// and ending at the end and a little after the start
+void check(const char* name, const char* begin, const char* end)
+{
+  const auto& scalar = c4::scan_kernels_for(c4::scan_isa::SCALAR);
+  for(const auto& isa : isas) {
+    if(!c4::scan_isa_supported(isa.isa))
+      continue;
+    const auto& simd = c4::scan_kernels_for(isa.isa);
+    for(const auto& k : kernels) {
+      for(const char* b = begin; b != end; ++b) {
+        for(const char* e : {end, b + (end - b) / 2, b + std::min<std::ptrdiff_t>(end - b, 33)}) {
+          ++checks;
+          auto expected = (scalar.*k.fn)(b, e);
+          auto got = (simd.*k.fn)(b, e);
+          if(got != expected) {
+            ++failures;
+            printf("%s: %s %s from %td to %td: expected %td, got %td\n",
+                   name, isa.name, k.name, b - begin, e - begin,
+                   expected - begin, got - begin);
+          }
+        }
+      }
+    }
+  }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+
+  // long runs of every class, so the vector loops run more than once
+  std::string runs;
+  for(const char* run : {" \t\v\f\n\r", "azAZ_09", "0123456789", "*/ *", "\r\n"}) {
+    for(int n = 0; n < 70; ++n)
+      runs += run[n % std::char_traits<char>::length(run)];
+    runs += "\x80#";
+  }
+  check("<runs>", runs.data(), runs.data() + runs.size());
+
+  for(int i = 1; i < argc; ++i) {
+    try {
+      c4::input in{argv[i]};
+      check(argv[i], in.begin(), in.end());
+    } catch(c4::input_error& e) {
+      fprintf(stderr, "%s: %s\n", argv[i], e.what());
+      ++failures;
+    }
+  }
+
+  printf("scan_test: %zu checks, %zu failures\n", checks, failures);
+  return failures != 0;
+}
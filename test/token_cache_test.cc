@@ -0,0 +1,198 @@
+// Token cache test. For every input the first load misses and the
+// lexed tokens are stored, the second one hits and gives the same
+// tokens and errors as lexing. Then the entry is damaged in each way
+// that must make a load miss: cut short, a byte flipped in the records
+// or in the copy of the input, another format version, and put where
+// the entry of the input with one byte changed belongs, with the hash
+// of that input. Loading an entry must not count as reading an input.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+#include "diagnostic.h"
+#include "hash.h"
+#include "input.h"
+#include "lexer.h"
+#include "token_cache.h"
+
+namespace {
+
+// where token_cache puts the entry of [begin, end)
+std::string entry_path(const std::string& dir, const char* begin, const char* end)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.tokens",
+                static_cast<unsigned long long>(c4::content_hash(begin, end)));
+  return dir + name;
+}
+
+std::string slurp(const std::string& path)
+{
+  std::ifstream in{path, std::ios::binary};
+  return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+void spill(const std::string& path, const std::string& data)
+{
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out << data;
+}
+
+// every token with its errors, and how many errors were reported
+std::string describe(c4::lexer& l)
+{
+  DiagnosticBuffer diags;
+  auto old = setDiagnosticBuffer(&diags);
+  std::string s;
+  for(auto* t = &l.get_token(); ; t = &l.advance_token()) {
+    s += std::to_string(static_cast<unsigned>(t->first.type)) + ' '
+      + std::to_string(t->first.start - l.begin()) + ' '
+      + std::to_string(t->first.length) + ' '
+      + std::to_string(t->first.name.id()) + (l.token_has_errors() ? " !\n" : "\n");
+    if(t->first.type == c4::token_type::T_EOF)
+      break;
+  }
+  setDiagnosticBuffer(old);
+  return s + std::to_string(diags.size()) + " errors\n";
+}
+
+struct tester {
+  tester(c4::token_cache& cache, std::string dir) : cache(cache), dir(dir) {}
+
+  c4::token_cache& cache;
+  std::string dir;
+  std::size_t failures = 0;
+
+  void fail(const char* name, const char* what)
+  {
+    printf("%s: %s\n", name, what);
+    ++failures;
+  }
+
+  // a load of [begin, end) that must miss and leave the lexer as it was
+  void expect_miss(const char* name, const char* begin, const char* end,
+                   const char* what)
+  {
+    c4::lexer l{begin, end, name};
+    auto stats = c4::input::stats().mapped_files + c4::input::stats().read_files;
+    if(cache.load(l) || l.buffered())
+      fail(name, what);
+    if(c4::input::stats().mapped_files + c4::input::stats().read_files != stats)
+      fail(name, "loading an entry counts as reading an input");
+  }
+
+  void run(const char* name)
+  {
+    c4::input in{name};
+    std::string path = entry_path(dir, in.begin(), in.end());
+    std::remove(path.c_str());
+
+    std::string expected;
+    {
+      c4::lexer l{in.begin(), in.end(), name};
+      if(cache.load(l))
+        fail(name, "an empty cache hits");
+      l.buffer_tokens();
+      cache.store(l);
+      expected = describe(l);
+    }
+    {
+      c4::lexer l{in.begin(), in.end(), name};
+      if(!cache.load(l))
+        fail(name, "a stored entry misses");
+      else if(describe(l) != expected)
+        fail(name, "a hit gives other tokens than lexing");
+    }
+
+    std::string good = slurp(path);
+    struct damage {
+      const char* what;
+      std::size_t at; // the byte to flip, or the size for npos
+    };
+    const std::size_t cut = std::string::npos;
+    // the header is 48 bytes and starts with the magic and the version,
+    // the input is copied to the end
+    const damage damages[] = {
+      {"a short entry hits", cut},
+      {"a damaged token record goes unnoticed", 48},
+      {"a damaged copy of the input goes unnoticed", good.size() - 1},
+      {"an entry of another version hits", 4},
+    };
+    for(auto& d : damages) {
+      if(d.at == good.size() - 1 && in.begin() == in.end())
+        continue; // there is no copy
+      std::string data = good;
+      if(d.at == cut)
+        data.pop_back();
+      else
+        data[d.at] ^= 0x01;
+      spill(path, data);
+      expect_miss(name, in.begin(), in.end(), d.what);
+    }
+
+    // an input of the same size with another byte in the middle whose
+    // hash collides with the one of the original: it finds the entry of
+    // the original, with its own hash after the version, and must not
+    // get its tokens
+    if(in.begin() != in.end()) {
+      std::string edited{in.begin(), in.end()};
+      char& c = edited[edited.size() / 2];
+      c = c == 'a' ? 'b' : 'a';
+      const char* begin = edited.data();
+      const char* end = begin + edited.size();
+      std::string edited_path = entry_path(dir, begin, end);
+      std::uint64_t hash = c4::content_hash(begin, end);
+      std::string data = good;
+      std::memcpy(&data[8], &hash, sizeof(hash));
+      spill(edited_path, data);
+      expect_miss(name, begin, end, "the entry of another input of the same size hits");
+      std::remove(edited_path.c_str());
+    }
+    std::remove(path.c_str());
+  }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+
+  // the lexer tests are full of errors, the first token reports its
+  // own while the lexer is made
+  if(!std::freopen("/dev/null", "w", stderr))
+    return 1;
+
+  const char* tmp = std::getenv("TMPDIR");
+  std::string dir = std::string{tmp && *tmp ? tmp : "/tmp"} + "/c4_token_cache_XXXXXX";
+  if(!mkdtemp(&dir[0])) {
+    printf("token_cache_test: can't make %s\n", dir.c_str());
+    return 1;
+  }
+
+  c4::token_cache cache{dir};
+  tester t{cache, dir};
+  for(int i = 1; i < argc; ++i) {
+    try {
+      t.run(argv[i]);
+    } catch(c4::input_error& e) {
+      printf("%s: %s\n", argv[i], e.what());
+      ++t.failures;
+    }
+  }
+  rmdir(dir.c_str());
+
+  printf("token_cache_test: %d inputs, %zu hits, %zu misses, %zu failures\n",
+         argc - 1, cache.hits(), cache.misses(), t.failures);
+  return t.failures != 0;
+}